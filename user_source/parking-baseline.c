@@ -0,0 +1,363 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parking-baseline.h"
+
+
+#define TEMPORARY_SUFFIX ".tmp"
+
+
+struct baseline
+{
+	uint16_t length;
+	uint16_t slots;
+	double   slot_length;
+	bool     started;
+	uint32_t first;
+	uint32_t last;
+	uint32_t current;
+	uint32_t sweeps;
+	double   *sum;
+	uint16_t *head;
+	uint16_t *count;
+	uint32_t *slot;
+	float    *value;
+};
+
+
+baseline_t *baseline_create(uint16_t length, uint16_t slots, double slot_length)
+{
+	baseline_t *baseline = calloc(1, sizeof(baseline_t));
+
+	if (baseline == NULL || length == 0 || slots == 0)
+	{
+		free(baseline);
+		return NULL;
+	}
+
+	baseline->length      = length;
+	baseline->slots       = slots;
+	baseline->slot_length = slot_length;
+	baseline->sum         = calloc(length, sizeof(*baseline->sum));
+	baseline->head        = calloc(length, sizeof(*baseline->head));
+	baseline->count       = calloc(length, sizeof(*baseline->count));
+	baseline->slot        = calloc((size_t)length * slots, sizeof(*baseline->slot));
+	baseline->value       = calloc((size_t)length * slots, sizeof(*baseline->value));
+
+	if (baseline->sum == NULL || baseline->head == NULL || baseline->count == NULL || baseline->slot == NULL ||
+	    baseline->value == NULL)
+	{
+		baseline_free(baseline);
+		return NULL;
+	}
+
+	return baseline;
+}
+
+
+void baseline_free(baseline_t *baseline)
+{
+	if (baseline == NULL)
+	{
+		return;
+	}
+
+	free(baseline->sum);
+	free(baseline->head);
+	free(baseline->count);
+	free(baseline->slot);
+	free(baseline->value);
+	free(baseline);
+}
+
+
+/**
+ * @brief Forget all slots
+ *
+ * @param[out] baseline The estimate
+ */
+static void baseline_clear(baseline_t *baseline)
+{
+	baseline->started = false;
+	baseline->first   = 0;
+	baseline->last    = 0;
+	baseline->current = 0;
+	baseline->sweeps  = 0;
+
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		baseline->sum[i]   = 0;
+		baseline->head[i]  = 0;
+		baseline->count[i] = 0;
+	}
+}
+
+
+/**
+ * @brief Append the average of a slot to the deque of one sample
+ *
+ * The deque holds increasing averages of increasing slots, so its front is the minimum of
+ * the window.
+ *
+ * @param[in,out] baseline The estimate
+ * @param[in]     sample Index of the sample
+ * @param[in]     slot Number of the slot
+ * @param[in]     value Average of the sample over the slot
+ */
+static void push_slot(baseline_t *baseline, uint16_t sample, uint32_t slot, float value)
+{
+	uint32_t *slots  = baseline->slot + (size_t)sample * baseline->slots;
+	float    *values = baseline->value + (size_t)sample * baseline->slots;
+	uint16_t head    = baseline->head[sample];
+	uint16_t count   = baseline->count[sample];
+
+	while (count > 0 && slots[head] + baseline->slots <= slot)
+	{
+		head = (head + 1) % baseline->slots;
+		count--;
+	}
+
+	while (count > 0 && values[(head + count - 1) % baseline->slots] >= value)
+	{
+		count--;
+	}
+
+	slots[(head + count) % baseline->slots]  = slot;
+	values[(head + count) % baseline->slots] = value;
+
+	baseline->head[sample]  = head;
+	baseline->count[sample] = count + 1;
+}
+
+
+/**
+ * @brief Add the averages of the current slot to the window
+ *
+ * @param[in,out] baseline The estimate
+ */
+static void close_slot(baseline_t *baseline)
+{
+	uint32_t slot = baseline->current;
+
+	//after a gap longer than the window the coverage starts again
+	if (!baseline->started || slot >= baseline->last + baseline->slots)
+	{
+		baseline->first   = slot;
+		baseline->started = true;
+	}
+
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		push_slot(baseline, i, slot, (float)(baseline->sum[i] / baseline->sweeps));
+		baseline->sum[i] = 0;
+	}
+
+	baseline->last   = slot;
+	baseline->sweeps = 0;
+}
+
+
+bool baseline_load(baseline_t *baseline, const char *file_name)
+{
+	FILE         *fin = fopen(file_name, "r");
+	unsigned int length;
+	unsigned int slots;
+	double       slot_length;
+	unsigned int started;
+	int          res;
+
+	baseline_clear(baseline);
+
+	if (fin == NULL)
+	{
+		return true;
+	}
+
+	res = fscanf(fin, "n %u slots %u slot-length %lf\n", &length, &slots, &slot_length);
+	if (res != 3)
+	{
+		fclose(fin);
+		return false;
+	}
+
+	//a state of another range or window is of no use
+	if (length != baseline->length || slots != baseline->slots || fabs(slot_length - baseline->slot_length) > 1e-3)
+	{
+		fclose(fin);
+		return true;
+	}
+
+	res = fscanf(fin, "started %u first %u last %u current %u sweeps %u\n", &started, &baseline->first, &baseline->last,
+	             &baseline->current, &baseline->sweeps);
+	baseline->started = started != 0;
+
+	res += fscanf(fin, "sum");
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		res += fscanf(fin, "%lf", &baseline->sum[i]);
+	}
+
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		unsigned int count;
+
+		if (fscanf(fin, " slots %u", &count) != 1 || count > baseline->slots)
+		{
+			break;
+		}
+
+		for (unsigned int j = 0; j < count; j++)
+		{
+			uint32_t slot;
+			float    value;
+
+			if (fscanf(fin, "%u %f", &slot, &value) != 2)
+			{
+				break;
+			}
+
+			baseline->slot[(size_t)i * baseline->slots + j]  = slot;
+			baseline->value[(size_t)i * baseline->slots + j] = value;
+			baseline->count[i]++;
+		}
+
+		if (baseline->count[i] == count)
+		{
+			res++;
+		}
+	}
+
+	fclose(fin);
+
+	if (res != 5 + 2 * baseline->length)
+	{
+		baseline_clear(baseline);
+		return false;
+	}
+
+	return true;
+}
+
+
+bool baseline_save(const baseline_t *baseline, const char *file_name)
+{
+	size_t length          = strlen(file_name) + sizeof(TEMPORARY_SUFFIX);
+	char   *temporary_name = malloc(length);
+	FILE   *fout           = NULL;
+	bool   ok;
+
+	if (temporary_name != NULL)
+	{
+		snprintf(temporary_name, length, "%s%s", file_name, TEMPORARY_SUFFIX);
+		fout = fopen(temporary_name, "w");
+	}
+
+	if (fout == NULL)
+	{
+		free(temporary_name);
+		return false;
+	}
+
+	fprintf(fout, "n %u slots %u slot-length %f\n", baseline->length, baseline->slots, baseline->slot_length);
+	fprintf(fout, "started %u first %u last %u current %u sweeps %u\n", baseline->started, baseline->first, baseline->last,
+	        baseline->current, baseline->sweeps);
+
+	fprintf(fout, "sum");
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		fprintf(fout, " %.1f", baseline->sum[i]);
+	}
+
+	fprintf(fout, "\n");
+
+	//the deques are saved from their front, so they are loaded starting at index 0
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		fprintf(fout, "slots %u", baseline->count[i]);
+		for (uint16_t j = 0; j < baseline->count[i]; j++)
+		{
+			size_t index = (size_t)i * baseline->slots + (baseline->head[i] + j) % baseline->slots;
+
+			fprintf(fout, " %u %.2f", baseline->slot[index], (double)baseline->value[index]);
+		}
+
+		fprintf(fout, "\n");
+	}
+
+	//the state is replaced by renaming the file written, so a crash cannot leave it truncated
+	ok = fflush(fout) == 0 && fsync(fileno(fout)) == 0;
+	ok = (fclose(fout) == 0) && ok;
+	ok = ok && rename(temporary_name, file_name) == 0;
+
+	if (!ok)
+	{
+		unlink(temporary_name);
+	}
+
+	free(temporary_name);
+	return ok;
+}
+
+
+bool baseline_add(baseline_t *baseline, double time, const uint16_t *sweep, uint16_t length)
+{
+	uint32_t slot   = (uint32_t)(time / baseline->slot_length);
+	bool     closed = false;
+
+	if (length != baseline->length)
+	{
+		return false;
+	}
+
+	//a clock stepping back adds to the current slot
+	if (baseline->sweeps > 0 && slot > baseline->current)
+	{
+		close_slot(baseline);
+		closed = true;
+	}
+
+	if (baseline->sweeps == 0 && (slot > baseline->current || !baseline->started))
+	{
+		baseline->current = slot;
+	}
+
+	for (uint16_t i = 0; i < length; i++)
+	{
+		baseline->sum[i] += sweep[i];
+	}
+
+	baseline->sweeps++;
+
+	return closed;
+}
+
+
+bool baseline_get(const baseline_t *baseline, uint16_t *sweep, float *coverage)
+{
+	uint32_t covered = baseline->started ? baseline->last - baseline->first + 1 : 0;
+
+	if (coverage != NULL)
+	{
+		*coverage = (covered < baseline->slots) ? (float)covered / baseline->slots : 1.0f;
+	}
+
+	if (covered < baseline->slots)
+	{
+		return false;
+	}
+
+	for (uint16_t i = 0; i < baseline->length; i++)
+	{
+		const float *values = baseline->value + (size_t)i * baseline->slots;
+
+		sweep[i] = (uint16_t)(values[baseline->head[i]] + 0.5f);
+	}
+
+	return true;
+}
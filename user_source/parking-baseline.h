@@ -0,0 +1,97 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_BASELINE_H_
+#define PARKING_BASELINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Minimum statistics estimate of the sweep of an empty parking spot.
+ *
+ * A car only adds reflections, so the amplitude of every sample of an empty spot is the lowest
+ * one seen over a period in which the spot was empty at least once. Time is divided into slots
+ * of a fixed length and the sweeps of a slot are averaged per sample, which removes the noise
+ * and bounds the memory to one value per sample and slot whatever the measurement rate. The
+ * estimate is the per sample minimum of the slot averages of the last window of slots, kept in
+ * one monotonic deque per sample: a new slot average removes the larger ones before it, and
+ * the oldest one is removed when it leaves the window, so every update is amortized O(1) per
+ * sample. The spot has to be empty for at least one whole slot per window.
+ *
+ * Slots are numbered by their start since the epoch, so a gap in the measurements or a restart
+ * with the saved state continues the window.
+ */
+typedef struct baseline baseline_t;
+
+
+/**
+ * @brief Create an empty estimate
+ *
+ * @param[in] length Number of samples of the sweeps
+ * @param[in] slots Number of slots in the window
+ * @param[in] slot_length Length of a slot [s]
+ * @return the estimate, or NULL if out of memory
+ */
+baseline_t *baseline_create(uint16_t length, uint16_t slots, double slot_length);
+
+
+/**
+ * @brief Free an estimate
+ *
+ * @param[in] baseline The estimate, may be NULL
+ */
+void baseline_free(baseline_t *baseline);
+
+
+/**
+ * @brief Load the state saved by baseline_save()
+ *
+ * The estimate is left empty if the file does not exist or was saved with another sweep
+ * length, slot count or slot length.
+ *
+ * @param[in,out] baseline The estimate
+ * @param[in]     file_name Name of the state file
+ * @return false if the file exists but could not be parsed
+ */
+bool baseline_load(baseline_t *baseline, const char *file_name);
+
+
+/**
+ * @brief Save the state, to continue the window after a restart
+ *
+ * The state is written to <file_name>.tmp, which is renamed over the state file once it is on
+ * disk, so a crash while saving keeps the previous state.
+ *
+ * @param[in] baseline The estimate
+ * @param[in] file_name Name of the state file
+ * @return false if the file could not be written
+ */
+bool baseline_save(const baseline_t *baseline, const char *file_name);
+
+
+/**
+ * @brief Add one sweep
+ *
+ * @param[in,out] baseline The estimate
+ * @param[in]     time Time of the sweep, seconds since the epoch
+ * @param[in]     sweep The sweep
+ * @param[in]     length Number of samples, sweeps of another length are ignored
+ * @return true if the sweep started a new slot, so the estimate has changed
+ */
+bool baseline_add(baseline_t *baseline, double time, const uint16_t *sweep, uint16_t length);
+
+
+/**
+ * @brief Get the estimated sweep of the empty spot
+ *
+ * @param[in]  baseline The estimate
+ * @param[out] sweep The estimated sweep, the sweep length given to baseline_create()
+ * @param[out] coverage Share of the window covered by slots so far, 0.0 - 1.0, may be NULL
+ * @return false until a whole window of slots has been added
+ */
+bool baseline_get(const baseline_t *baseline, uint16_t *sweep, float *coverage);
+
+
+#endif
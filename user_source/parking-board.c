@@ -0,0 +1,85 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <stddef.h>
+#include <string.h>
+
+#include "parking-board.h"
+
+
+/* declare the renamed HAL entry points of a board, weak so that boards can be left out of the build */
+#define DECLARE_BOARD(name) \
+	extern bool parking_board_ ## name ## _hal_init(void) __attribute__((weak)); \
+	extern acc_hal_t parking_board_ ## name ## _hal_get_implementation(void) __attribute__((weak));
+
+#define BOARD(name) {#name, parking_board_ ## name ## _hal_init, parking_board_ ## name ## _hal_get_implementation}
+
+DECLARE_BOARD(xc111)
+DECLARE_BOARD(xc112)
+/* the simulated sensors of ref-app-parking-soak, see parking-sim.h */
+DECLARE_BOARD(sim)
+
+typedef struct
+{
+	const char *name;
+	bool       (*hal_init)(void);
+	acc_hal_t  (*hal_get_implementation)(void);
+} board_t;
+
+static const board_t boards[] =
+{
+	BOARD(xc111),
+	BOARD(xc112),
+	BOARD(sim),
+};
+
+#define BOARD_COUNT (sizeof(boards) / sizeof(boards[0]))
+
+
+/**
+ * @brief Check if a board is linked into the program
+ *
+ * @param[in] board The board
+ * @return true if both HAL entry points are present
+ */
+static bool board_linked(const board_t *board)
+{
+	return board->hal_init != NULL && board->hal_get_implementation != NULL;
+}
+
+
+bool board_init(const char *name, acc_hal_t *hal)
+{
+	for (size_t i = 0; i < BOARD_COUNT; i++)
+	{
+		if (strcmp(boards[i].name, name) != 0)
+		{
+			continue;
+		}
+
+		if (!board_linked(&boards[i]) || !boards[i].hal_init())
+		{
+			return false;
+		}
+
+		*hal = boards[i].hal_get_implementation();
+		return true;
+	}
+
+	return false;
+}
+
+
+void board_print_names(FILE *stream)
+{
+	const char *separator = "";
+
+	for (size_t i = 0; i < BOARD_COUNT; i++)
+	{
+		if (board_linked(&boards[i]))
+		{
+			fprintf(stream, "%s%s", separator, boards[i].name);
+			separator = " ";
+		}
+	}
+}
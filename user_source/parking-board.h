@@ -0,0 +1,44 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_BOARD_H_
+#define PARKING_BOARD_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "acc_hal_definitions.h"
+
+
+/*
+ * Connector boards selected at startup.
+ *
+ * Every board file is linked as its own object with the HAL entry points renamed to
+ * parking_board_<name>_hal_init() and parking_board_<name>_hal_get_implementation(), see
+ * makefile_build_parking_sensor.inc. The boards left out of the build are detected at
+ * runtime, so the list of linked boards only lives in the makefile.
+ */
+
+
+#define DEFAULT_BOARD "xc111"
+
+
+/**
+ * @brief Initialize the driver HAL of a board and get its implementation
+ *
+ * @param[in]  name Board name, e.g. "xc111"
+ * @param[out] hal The HAL implementation of the board
+ * @return false if the board is unknown, not linked or fails to initialize
+ */
+bool board_init(const char *name, acc_hal_t *hal);
+
+
+/**
+ * @brief Print the names of the boards linked into the program, separated by spaces
+ *
+ * @param[in] stream Output stream
+ */
+void board_print_names(FILE *stream);
+
+
+#endif
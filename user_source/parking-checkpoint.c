@@ -0,0 +1,190 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking-checkpoint.h"
+
+
+static const uint32_t CHECKPOINT_MAGIC   = 0x5043484b;
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+/* interval between checks of the previous owner [ns] */
+static const long TAKE_OVER_POLL_NS = 10000000;
+
+/* descriptor of the region, kept open for the owner lock, see checkpoint_take_over() */
+static int checkpoint_fd = -1;
+
+
+checkpoint_t *checkpoint_open(const char *name)
+{
+	struct stat status;
+	int         fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	//a new region is empty, a region of another version may be smaller
+	if (fstat(fd, &status) != 0 || (status.st_size < (off_t)sizeof(checkpoint_t) && ftruncate(fd, sizeof(checkpoint_t)) != 0))
+	{
+		close(fd);
+		return NULL;
+	}
+
+	checkpoint_t *checkpoint = mmap(NULL, sizeof(checkpoint_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (checkpoint == MAP_FAILED)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	checkpoint_fd = fd;
+
+	if (__atomic_load_n(&checkpoint->magic, __ATOMIC_ACQUIRE) != CHECKPOINT_MAGIC)
+	{
+		memset(checkpoint, 0, sizeof(*checkpoint));
+		checkpoint->version = CHECKPOINT_VERSION;
+		__atomic_store_n(&checkpoint->magic, CHECKPOINT_MAGIC, __ATOMIC_RELEASE);
+	}
+
+	return checkpoint;
+}
+
+
+void checkpoint_close(checkpoint_t *checkpoint)
+{
+	munmap(checkpoint, sizeof(checkpoint_t));
+	close(checkpoint_fd);
+	checkpoint_fd = -1;
+}
+
+
+/**
+ * @brief Lock or unlock the whole region for its owner
+ *
+ * @param[in] type F_WRLCK or F_UNLCK
+ * @return false if another process holds the lock
+ */
+static bool set_owner_lock(short type)
+{
+	struct flock lock = {.l_type = type, .l_whence = SEEK_SET, .l_start = 0, .l_len = 0};
+
+	return fcntl(checkpoint_fd, F_SETLK, &lock) == 0;
+}
+
+
+/**
+ * @brief Get the process holding the owner lock
+ *
+ * @return the process, or 0 if the lock is free
+ */
+static pid_t get_lock_owner(void)
+{
+	struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET, .l_start = 0, .l_len = 0};
+
+	if (fcntl(checkpoint_fd, F_GETLK, &lock) != 0 || lock.l_type == F_UNLCK)
+	{
+		return 0;
+	}
+
+	return lock.l_pid;
+}
+
+
+bool checkpoint_take_over(checkpoint_t *checkpoint, double timeout, pid_t *previous)
+{
+	struct timespec poll      = {0, TAKE_OVER_POLL_NS};
+	long            polls     = (long)(timeout * 1e9 / TAKE_OVER_POLL_NS);
+	pid_t           signalled = 0;
+
+	*previous = 0;
+
+	//the lock names the running owner, a process that exited holds no lock and has no PID to reuse
+	while (!set_owner_lock(F_WRLCK))
+	{
+		if (errno != EACCES && errno != EAGAIN)
+		{
+			return false;
+		}
+
+		pid_t owner = get_lock_owner();
+
+		//a process that took over in the meantime is asked to stop in turn
+		if (owner > 0 && owner != signalled)
+		{
+			kill(owner, SIGUSR1);
+			signalled = owner;
+			*previous = owner;
+		}
+
+		if (polls-- <= 0)
+		{
+			return false;
+		}
+
+		nanosleep(&poll, NULL);
+	}
+
+	if (checkpoint->version != CHECKPOINT_VERSION)
+	{
+		memset(checkpoint->sensors, 0, sizeof(checkpoint->sensors));
+		checkpoint->version = CHECKPOINT_VERSION;
+	}
+
+	__atomic_store_n(&checkpoint->released, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&checkpoint->owner, getpid(), __ATOMIC_RELEASE);
+
+	return true;
+}
+
+
+void checkpoint_release(checkpoint_t *checkpoint)
+{
+	pid_t owner = getpid();
+
+	//a process that is not the owner has nothing to release
+	if (__atomic_compare_exchange_n(&checkpoint->owner, &owner, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		__atomic_store_n(&checkpoint->released, 1, __ATOMIC_RELEASE);
+		set_owner_lock(F_UNLCK);
+	}
+}
+
+
+checkpoint_sensor_t *checkpoint_sensor(checkpoint_t *checkpoint, int sensor)
+{
+	checkpoint_sensor_t *free_state = NULL;
+
+	for (unsigned int i = 0; i < CHECKPOINT_MAX_SENSORS; i++)
+	{
+		checkpoint_sensor_t *state = &checkpoint->sensors[i];
+
+		if (state->sensor == sensor)
+		{
+			return state;
+		}
+
+		if (state->sensor == 0 && free_state == NULL)
+		{
+			free_state = state;
+		}
+	}
+
+	if (free_state != NULL)
+	{
+		memset(free_state, 0, sizeof(*free_state));
+		free_state->sensor = sensor;
+	}
+
+	return free_state;
+}
@@ -0,0 +1,107 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_CHECKPOINT_H_
+#define PARKING_CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+#define CHECKPOINT_MAX_SENSORS (16)
+
+
+/*
+ * State handed over from a running process to its replacement.
+ *
+ * The process measuring the sensors owns the checkpoint and keeps the state of every sensor
+ * in it up to date. A new process started with the same checkpoint sends SIGUSR1 to the
+ * owner, which stops after the current measurement, releases the sensors and marks the
+ * checkpoint released. The new process then becomes the owner and continues with the state
+ * of every sensor, so a binary can be replaced without losing the results or the timing of
+ * the measurements.
+ *
+ * The owner holds a write lock on the region until it releases the checkpoint, and the lock
+ * is dropped by the kernel if it exits without doing so. The process to stop is the one
+ * holding the lock, so a PID left by an owner that crashed is never signalled, and of two
+ * processes started at the same time only one gets the lock, the other then takes over from
+ * it in turn. Only the owner writes the sensor states, and a new owner reads them only after
+ * it got the lock, so the states need no locking of their own. owner is the PID of the owner,
+ * 0 once released. Times are on the monotonic clock, which is shared by all processes.
+ */
+typedef struct
+{
+	int32_t  sensor;
+	int32_t  result;
+	float    peak_amp;
+	float    peak_dist;
+	int32_t  level;
+	uint32_t measurements;
+	double   cost;
+	double   update_time;
+} checkpoint_sensor_t;
+
+typedef struct
+{
+	uint32_t            magic;
+	uint32_t            version;
+	int32_t             owner;
+	uint32_t            released;
+	checkpoint_sensor_t sensors[CHECKPOINT_MAX_SENSORS];
+} checkpoint_t;
+
+
+/**
+ * @brief Map the checkpoint, creating it if it does not exist
+ *
+ * @param[in] name POSIX shared memory name, e.g. "/parking-checkpoint"
+ * @return the mapped checkpoint, or NULL on failure
+ */
+checkpoint_t *checkpoint_open(const char *name);
+
+
+/**
+ * @brief Unmap the checkpoint, it stays for the next process
+ *
+ * @param[in] checkpoint The mapped checkpoint
+ */
+void checkpoint_close(checkpoint_t *checkpoint);
+
+
+/**
+ * @brief Become the owner of the checkpoint, taking over from the current owner
+ *
+ * If another process holds the owner lock, it is sent SIGUSR1 and the call waits until it
+ * has released the checkpoint or exited. The sensor states of a checkpoint written by
+ * another version are cleared. A process maps only one checkpoint.
+ *
+ * @param[in,out] checkpoint The mapped checkpoint
+ * @param[in]     timeout Longest wait for the previous owner [s]
+ * @param[out]    previous The previous owner, 0 if no process had to be stopped
+ * @return false if the previous owner did not release the checkpoint in time
+ */
+bool checkpoint_take_over(checkpoint_t *checkpoint, double timeout, pid_t *previous);
+
+
+/**
+ * @brief Release the checkpoint, to be called after the sensors are released
+ *
+ * Nothing is done if the process does not own the checkpoint.
+ *
+ * @param[in,out] checkpoint The mapped checkpoint
+ */
+void checkpoint_release(checkpoint_t *checkpoint);
+
+
+/**
+ * @brief Find the state of a sensor, adding it if it is not in the checkpoint
+ *
+ * @param[in,out] checkpoint The mapped checkpoint
+ * @param[in]     sensor Sensor id
+ * @return the state, with update_time 0 if the sensor was added, or NULL if the checkpoint is full
+ */
+checkpoint_sensor_t *checkpoint_sensor(checkpoint_t *checkpoint, int sensor);
+
+
+#endif
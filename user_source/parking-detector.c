@@ -0,0 +1,628 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "parking-detector.h"
+
+
+static const float SPIKE_NOISE_FACTOR     = 8;
+static const float SPIKE_NEIGHBOUR_FACTOR = 3;
+static const int   SPIKE_MIN_LENGTH       = 32;
+static const float DROPOUT_FACTOR         = 0.25;
+static const int   SATURATED_SHARE        = 4;
+static const float GAIN_REFERENCE_DISTANCE = 0.3;
+
+const char *SWEEP_QUALITY_NAMES[] = {"ok", "spikes", "dropout", "saturated"};
+
+
+/* sums over a sweep for the interference classification */
+typedef struct
+{
+	float energy;
+	float noise;
+	int   spikes;
+	int   saturated;
+} interference_stats_t;
+
+
+/**
+ * @brief Classify a sweep from its interference statistics
+ *
+ * @param[in] stats Statistics of the sweep
+ * @param[in] length Number of samples in the sweep
+ * @return the sweep quality
+ */
+static inline sweep_quality_t classify_interference(const interference_stats_t *stats, int length)
+{
+	if (stats->saturated * SATURATED_SHARE > length)
+	{
+		return SWEEP_SATURATED;
+	}
+	else if (stats->energy < DROPOUT_FACTOR * stats->noise)
+	{
+		return SWEEP_DROPOUT;
+	}
+	else if (stats->spikes > 0)
+	{
+		return SWEEP_SPIKES;
+	}
+
+	return SWEEP_OK;
+}
+
+
+int car_present(float avg_peak_amp, float avg_calib_amp, float avg_amp_factor)
+{
+	return avg_peak_amp > get_detection_threshold(avg_calib_amp, avg_amp_factor);
+}
+
+
+float get_detection_threshold(float avg_calib_amp, float avg_amp_factor)
+{
+	return avg_calib_amp * avg_amp_factor * 4;
+}
+
+
+/* the datapoint format_data() would give for sample index, or -1, -1 if there is none */
+#define sample_datapoint(amp, index, length, start, end) \
+	((index) < 0 ? (Datapoint){.dist = -1, .amp = -1} : \
+	 (Datapoint){.dist = (start) + ((end) - (start)) / (length) * (index), .amp = (amp)[index]})
+
+#define DEFINE_FORMAT_DATA(suffix, type) \
+	void format_data_##suffix(Datapoint *data, const type *amp, int length, float start, float end) \
+	{ \
+		float range = end - start; \
+		float step  = range/length; \
+		\
+		for (int i = 0; i < length; i++) \
+		{ \
+			data[i].dist = start + step*i; \
+			data[i].amp  = amp[i]; \
+		} \
+	}
+
+#define DEFINE_AVERAGE_AMPLITUDE(suffix, type) \
+	float get_average_amplitude_##suffix(const type *amp, int length) \
+	{ \
+		float sum = 0; \
+		\
+		for (int i = 0; i < length; i++) \
+		{ \
+			sum += amp[i]; \
+		} \
+		\
+		return sum / length; \
+	}
+
+#define DEFINE_MAX_PEAK(suffix, type) \
+	Datapoint get_max_peak_##suffix(const type *amp, int length, float start, float end) \
+	{ \
+		int index = -1; \
+		\
+		for (int i = 0; i < length; i++) \
+		{ \
+			if (index < 0 || amp[i] > amp[index]) \
+			{ \
+				index = i; \
+			} \
+		} \
+		\
+		return sample_datapoint(amp, index, length, start, end); \
+	}
+
+
+#if defined(__ARM_NEON)
+
+float get_average_amplitude_u8(const uint8_t *amp, int length)
+{
+	uint32x4_t acc = vdupq_n_u32(0);
+	int        i   = 0;
+
+	for (; i + 16 <= length; i += 16)
+	{
+		acc = vpadalq_u16(acc, vpaddlq_u8(vld1q_u8(amp + i)));
+	}
+
+	uint64x2_t sum64 = vpaddlq_u32(acc);
+	uint64_t   sum   = vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1);
+
+	for (; i < length; i++)
+	{
+		sum += amp[i];
+	}
+
+	return (float)sum / length;
+}
+
+
+float get_average_amplitude_u16(const uint16_t *amp, int length)
+{
+	uint32x4_t acc = vdupq_n_u32(0);
+	int        i   = 0;
+
+	for (; i + 8 <= length; i += 8)
+	{
+		acc = vpadalq_u16(acc, vld1q_u16(amp + i));
+	}
+
+	uint64x2_t sum64 = vpaddlq_u32(acc);
+	uint64_t   sum   = vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1);
+
+	for (; i < length; i++)
+	{
+		sum += amp[i];
+	}
+
+	return (float)sum / length;
+}
+
+
+/* the max value is found with SIMD, then a scalar scan finds its first index */
+Datapoint get_max_peak_u8(const uint8_t *amp, int length, float start, float end)
+{
+	uint8x16_t max_vector = vdupq_n_u8(0);
+	uint8_t    max        = 0;
+	int        i          = 0;
+
+	for (; i + 16 <= length; i += 16)
+	{
+		max_vector = vmaxq_u8(max_vector, vld1q_u8(amp + i));
+	}
+
+	uint8x8_t pair = vpmax_u8(vget_low_u8(max_vector), vget_high_u8(max_vector));
+	pair = vpmax_u8(pair, pair);
+	pair = vpmax_u8(pair, pair);
+	pair = vpmax_u8(pair, pair);
+	max  = vget_lane_u8(pair, 0);
+
+	for (; i < length; i++)
+	{
+		max = (amp[i] > max) ? amp[i] : max;
+	}
+
+	int index = (length > 0) ? 0 : -1;
+	while (index >= 0 && amp[index] != max)
+	{
+		index++;
+	}
+
+	return sample_datapoint(amp, index, length, start, end);
+}
+
+
+Datapoint get_max_peak_u16(const uint16_t *amp, int length, float start, float end)
+{
+	uint16x8_t max_vector = vdupq_n_u16(0);
+	uint16_t   max        = 0;
+	int        i          = 0;
+
+	for (; i + 8 <= length; i += 8)
+	{
+		max_vector = vmaxq_u16(max_vector, vld1q_u16(amp + i));
+	}
+
+	uint16x4_t pair = vpmax_u16(vget_low_u16(max_vector), vget_high_u16(max_vector));
+	pair = vpmax_u16(pair, pair);
+	pair = vpmax_u16(pair, pair);
+	max  = vget_lane_u16(pair, 0);
+
+	for (; i < length; i++)
+	{
+		max = (amp[i] > max) ? amp[i] : max;
+	}
+
+	int index = (length > 0) ? 0 : -1;
+	while (index >= 0 && amp[index] != max)
+	{
+		index++;
+	}
+
+	return sample_datapoint(amp, index, length, start, end);
+}
+
+#else
+
+DEFINE_AVERAGE_AMPLITUDE(u8, uint8_t)
+DEFINE_AVERAGE_AMPLITUDE(u16, uint16_t)
+DEFINE_MAX_PEAK(u8, uint8_t)
+DEFINE_MAX_PEAK(u16, uint16_t)
+
+#endif
+
+DEFINE_FORMAT_DATA(u8, uint8_t)
+DEFINE_FORMAT_DATA(u16, uint16_t)
+DEFINE_FORMAT_DATA(f32, float)
+DEFINE_AVERAGE_AMPLITUDE(f32, float)
+DEFINE_MAX_PEAK(f32, float)
+
+
+void format_data(Datapoint *data, const uint16_t *amp, int length, float start, float end)
+{
+	format_data_u16(data, amp, length, start, end);
+}
+
+
+float get_average_amplitude(Datapoint *data, int length)
+{
+	float sum = 0;
+
+	for (int i = 0; i < length; i++)
+	{
+		sum += data[i].amp;
+	}
+
+	return sum / length;
+}
+
+
+Datapoint get_max_peak(Datapoint *data, int length)
+{
+	Datapoint max;
+
+	max.amp  = -1;
+	max.dist = -1;
+
+	for (int i = 0; i < length; i++)
+	{
+		if (data[i].amp > max.amp)
+		{
+			max = data[i];
+		}
+	}
+
+	return max;
+}
+
+
+void compute_gain_table(float *gain, int length, float start, float end, float exponent)
+{
+	float step = (end - start) / length;
+
+	for (int i = 0; i < length; i++)
+	{
+		gain[i] = (exponent != 0) ? powf((start + step * i) / GAIN_REFERENCE_DISTANCE, exponent) : 1;
+	}
+}
+
+
+/* pipeline stages, see select_pipeline() */
+
+static inline float filter_raw(const uint16_t *sweep, int i, int length)
+{
+	(void)length;
+	return sweep[i];
+}
+
+
+static inline float filter_smooth(const uint16_t *sweep, int i, int length)
+{
+	int left  = (i > 0) ? i - 1 : i;
+	int right = (i < length - 1) ? i + 1 : i;
+
+	return (sweep[left] + 2.0f * sweep[i] + sweep[right]) / 4;
+}
+
+
+static inline float gain_unit(const pipeline_context_t *context, int i)
+{
+	(void)context;
+	(void)i;
+	return 1;
+}
+
+
+static inline float gain_table(const pipeline_context_t *context, int i)
+{
+	return context->gain[i];
+}
+
+
+static inline void check_none(interference_stats_t *stats, const pipeline_context_t *context, const uint16_t *sweep, int i,
+                              int length)
+{
+	(void)stats;
+	(void)context;
+	(void)sweep;
+	(void)i;
+	(void)length;
+}
+
+
+static inline sweep_quality_t check_none_result(const interference_stats_t *stats, int length)
+{
+	(void)stats;
+	(void)length;
+	return SWEEP_OK;
+}
+
+
+static inline void check_interference(interference_stats_t *stats, const pipeline_context_t *context, const uint16_t *sweep,
+                                      int i, int length)
+{
+	float amp   = sweep[i];
+	float noise = context->noise_profile[i];
+
+	stats->energy    += amp;
+	stats->noise     += noise;
+	stats->saturated += amp >= UINT16_MAX;
+
+	if (length >= SPIKE_MIN_LENGTH && amp > SPIKE_NOISE_FACTOR * noise)
+	{
+		float left  = sweep[(i > 0) ? i - 1 : i + 1];
+		float right = sweep[(i < length - 1) ? i + 1 : i - 1];
+
+		stats->spikes += amp > SPIKE_NEIGHBOUR_FACTOR * ((left > right) ? left : right);
+	}
+}
+
+
+static inline sweep_quality_t check_interference_result(const interference_stats_t *stats, int length)
+{
+	return classify_interference(stats, length);
+}
+
+
+/* one fused loop over the sweep with the given stages inlined */
+#define DEFINE_PIPELINE(name, filter, gain, check) \
+	static Datapoint pipeline_##name(const pipeline_context_t *context, const uint16_t *sweep, int length, int *present, \
+	                                 sweep_quality_t *quality) \
+	{ \
+		interference_stats_t stats     = {0}; \
+		float                threshold = context->threshold; \
+		float                max       = -1; \
+		int                  index     = -1; \
+		int                  above     = 0; \
+		\
+		for (int i = 0; i < length; i++) \
+		{ \
+			float amp = filter(sweep, i, length) * gain(context, i); \
+			\
+			above |= amp > threshold; \
+			if (amp > max) \
+			{ \
+				max   = amp; \
+				index = i; \
+			} \
+			\
+			check(&stats, context, sweep, i, length); \
+		} \
+		\
+		*quality = check##_result(&stats, length); \
+		*present = above; \
+		\
+		return (Datapoint){.dist = (index < 0) ? -1 : context->start + (context->end - context->start) / length * index, \
+		                   .amp  = max}; \
+	}
+
+DEFINE_PIPELINE(gained, filter_raw, gain_table, check_none)
+DEFINE_PIPELINE(checked, filter_raw, gain_unit, check_interference)
+DEFINE_PIPELINE(gained_checked, filter_raw, gain_table, check_interference)
+DEFINE_PIPELINE(smoothed, filter_smooth, gain_unit, check_none)
+DEFINE_PIPELINE(smoothed_gained, filter_smooth, gain_table, check_none)
+DEFINE_PIPELINE(smoothed_checked, filter_smooth, gain_unit, check_interference)
+DEFINE_PIPELINE(smoothed_gained_checked, filter_smooth, gain_table, check_interference)
+
+
+static Datapoint pipeline_peak(const pipeline_context_t *context, const uint16_t *sweep, int length, int *present,
+                               sweep_quality_t *quality)
+{
+	Datapoint peak = get_max_peak_u16(sweep, length, context->start, context->end);
+
+	*quality = SWEEP_OK;
+	*present = peak.amp > context->threshold;
+	return peak;
+}
+
+
+/* indexed by smooth, gain and interference check */
+static const detection_pipeline_t PIPELINES[2][2][2] =
+{
+	{{pipeline_peak, pipeline_checked}, {pipeline_gained, pipeline_gained_checked}},
+	{{pipeline_smoothed, pipeline_smoothed_checked}, {pipeline_smoothed_gained, pipeline_smoothed_gained_checked}}
+};
+
+
+detection_pipeline_t select_pipeline(bool smooth, bool gain, bool interference_check)
+{
+	return PIPELINES[smooth][gain][interference_check];
+}
+
+
+void sweep_batch_clear(sweep_batch_t *batch)
+{
+	batch->sensors = 0;
+	for (int group = 0; group < SWEEP_BATCH_GROUPS; group++)
+	{
+		batch->group_length[group] = 0;
+	}
+}
+
+
+int sweep_batch_add(sweep_batch_t *batch, const uint16_t *sweep, int length, float start, float end, float threshold)
+{
+	if (batch->sensors >= SWEEP_BATCH_MAX_SENSORS || length < 0 || length > SWEEP_BATCH_MAX_LENGTH)
+	{
+		return -1;
+	}
+
+	int index        = batch->sensors++;
+	int group        = index / SWEEP_BATCH_LANES;
+	int lane         = index % SWEEP_BATCH_LANES;
+	int group_length = batch->group_length[group];
+
+	uint16_t (*rows)[SWEEP_BATCH_LANES] = batch->samples[group];
+
+	for (int i = 0; i < length; i++)
+	{
+		rows[i][lane] = sweep[i];
+	}
+
+	//shorter sweeps are padded with zeros, which never beat a peak
+	for (int i = length; i < group_length; i++)
+	{
+		rows[i][lane] = 0;
+	}
+
+	for (int i = group_length; i < length; i++)
+	{
+		for (int other = 0; other < lane; other++)
+		{
+			rows[i][other] = 0;
+		}
+	}
+
+	if (length > group_length)
+	{
+		batch->group_length[group] = length;
+	}
+
+	batch->length[index]    = length;
+	batch->start[index]     = start;
+	batch->end[index]       = end;
+	batch->threshold[index] = threshold;
+
+	return index;
+}
+
+
+#if defined(__ARM_NEON)
+
+/* max and first index of the max of every lane of a group */
+static void get_group_peaks(const uint16_t (*rows)[SWEEP_BATCH_LANES], int length, const float *threshold, uint16_t *max,
+                            uint16_t *index, int *present)
+{
+	uint16x8_t max_vector   = vld1q_u16(rows[0]);
+	uint16x8_t index_vector = vdupq_n_u16(0);
+	uint16x8_t row_vector   = vdupq_n_u16(0);
+	uint16x8_t one          = vdupq_n_u16(1);
+
+	for (int i = 1; i < length; i++)
+	{
+		uint16x8_t samples = vld1q_u16(rows[i]);
+		uint16x8_t greater = vcgtq_u16(samples, max_vector);
+
+		row_vector   = vaddq_u16(row_vector, one);
+		max_vector   = vmaxq_u16(max_vector, samples);
+		index_vector = vbslq_u16(greater, row_vector, index_vector);
+	}
+
+	uint32x4_t above_low  = vcgtq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(max_vector))), vld1q_f32(threshold));
+	uint32x4_t above_high = vcgtq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(max_vector))), vld1q_f32(threshold + 4));
+	uint32_t   above[SWEEP_BATCH_LANES];
+
+	vst1q_u16(max, max_vector);
+	vst1q_u16(index, index_vector);
+	vst1q_u32(above, above_low);
+	vst1q_u32(above + 4, above_high);
+
+	for (int lane = 0; lane < SWEEP_BATCH_LANES; lane++)
+	{
+		present[lane] = above[lane] != 0;
+	}
+}
+
+#else
+
+/* max and first index of the max of every lane of a group, written so the lanes vectorise */
+static void get_group_peaks(const uint16_t (*rows)[SWEEP_BATCH_LANES], int length, const float *threshold, uint16_t *max,
+                            uint16_t *index, int *present)
+{
+	for (int lane = 0; lane < SWEEP_BATCH_LANES; lane++)
+	{
+		max[lane]   = rows[0][lane];
+		index[lane] = 0;
+	}
+
+	for (int i = 1; i < length; i++)
+	{
+		for (int lane = 0; lane < SWEEP_BATCH_LANES; lane++)
+		{
+			bool greater = rows[i][lane] > max[lane];
+
+			max[lane]   = greater ? rows[i][lane] : max[lane];
+			index[lane] = greater ? i : index[lane];
+		}
+	}
+
+	for (int lane = 0; lane < SWEEP_BATCH_LANES; lane++)
+	{
+		present[lane] = max[lane] > threshold[lane];
+	}
+}
+
+#endif
+
+
+void get_max_peaks_batch(const sweep_batch_t *batch, Datapoint *peaks, int *present)
+{
+	for (unsigned int first = 0; first < batch->sensors; first += SWEEP_BATCH_LANES)
+	{
+		int      group = first / SWEEP_BATCH_LANES;
+		uint16_t max[SWEEP_BATCH_LANES];
+		uint16_t index[SWEEP_BATCH_LANES];
+		int      above[SWEEP_BATCH_LANES];
+
+		get_group_peaks(batch->samples[group], batch->group_length[group], &batch->threshold[first], max, index, above);
+
+		//lanes past the last sensor hold stale samples, their results are dropped
+		for (unsigned int lane = 0; lane < SWEEP_BATCH_LANES && first + lane < batch->sensors; lane++)
+		{
+			unsigned int sensor = first + lane;
+			int          length = batch->length[sensor];
+
+			if (length == 0)
+			{
+				peaks[sensor]   = (Datapoint){.dist = -1, .amp = -1};
+				present[sensor] = 0;
+				continue;
+			}
+
+			peaks[sensor].dist = batch->start[sensor] + (batch->end[sensor] - batch->start[sensor]) / length * index[lane];
+			peaks[sensor].amp  = max[lane];
+			present[sensor]    = above[lane];
+		}
+	}
+}
+
+
+void resample_profile(const uint16_t *profile, unsigned profile_length, float profile_start, float profile_end,
+                      float *resampled, int length, float start, float end)
+{
+	float step         = (end - start) / length;
+	float profile_step = (profile_end - profile_start) / profile_length;
+
+	for (int i = 0; i < length; i++)
+	{
+		int index = (start + step * i - profile_start) / profile_step + 0.5f;
+
+		index        = (index < 0) ? 0 : ((unsigned)index >= profile_length) ? (int)profile_length - 1 : index;
+		resampled[i] = profile[index];
+	}
+}
+
+
+void calculate_threshold(const uint16_t *threshold_data, unsigned n, float start, float end, const float *gain,
+                         float *avg_calib_amp, Datapoint *peak_amp, float *avg_amp_factor)
+{
+	Datapoint th_data[n];
+	format_data(th_data, threshold_data, n, start, end);
+
+	if (gain != NULL)
+	{
+		for (unsigned int i = 0; i < n; i++)
+		{
+			th_data[i].amp *= gain[i];
+		}
+	}
+
+	*avg_calib_amp  = get_average_amplitude(th_data, n);
+	*peak_amp       = get_max_peak(th_data, n);
+	*avg_amp_factor = peak_amp->amp / *avg_calib_amp;
+}
@@ -0,0 +1,276 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_DETECTOR_H_
+#define PARKING_DETECTOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef struct datapoint
+{
+	float dist;
+	float amp;
+} Datapoint;
+
+typedef enum
+{
+	SWEEP_OK,
+	SWEEP_SPIKES,
+	SWEEP_DROPOUT,
+	SWEEP_SATURATED
+} sweep_quality_t;
+
+extern const char *SWEEP_QUALITY_NAMES[];
+
+
+/**
+ * @brief Decides if car is present based on average amplitude, peak amplitudes, and calibration data.
+ * This algorithm needs calibration.
+ *
+ * @param[in] avg_peak_amp The max peak amplitude from the collected envelope data
+ * @param[in] avg_calib_amp The threshold from calibration which decides whether the algorithm should output 1 or 0
+ * @param[in] avg_amp_factor Amplitude factor
+ * @return 0 if no car, and 1 if car is present.
+ **/
+int car_present(float avg_peak_amp, float avg_calib_amp, float avg_amp_factor);
+
+
+/**
+ * @brief The amplitude car_present() compares the peak amplitude with
+ *
+ * @param[in] avg_calib_amp The threshold from calibration which decides whether the algorithm should output 1 or 0
+ * @param[in] avg_amp_factor Amplitude factor
+ * @return the detection threshold
+ **/
+float get_detection_threshold(float avg_calib_amp, float avg_amp_factor);
+
+
+/**
+ * @brief Organizes collected amplitude data 'amp' with its distance 'dist'. Calculates the
+ * start-to-end range and adds each amplitude 'amp' to a distance 'dist' with
+ * 'step' interval, within the range.
+ *
+ * @param[out] data Array of the collected envelope data organized as datapoints with amplitude and distance
+ * @param[in]  amp Array of collected amplitude data
+ * @param[in]  length Length of datapoint array
+ * @param[in]  start Corresponds to start range in the application configuration
+ * @param[in]  end The end range for the distance the sensor is measuring
+ **/
+void format_data(Datapoint *data, const uint16_t *amp, int length, float start, float end);
+
+
+/**
+ * @brief Calculates the average amplitude for given data.
+ *
+ * @param[in] data Array of envelope data
+ * @param[in] length The length of the envelope data array
+ * @return a float number corresponding to the average amplitude for all sweeps
+ **/
+float get_average_amplitude(Datapoint *data, int length);
+
+
+/**
+ * @brief Calculates the max peak for given data. Assumes there is only one
+ * sweep in data.
+ *
+ * @param[in] data Array of envelope data
+ * @param[in] length The length of the envelope data array
+ * @return a datapoint with average max peak amplitude and distance from all sweeps.
+ **/
+Datapoint get_max_peak(Datapoint *data, int length);
+
+
+/*
+ * Kernels generic over the sample type.
+ *
+ * The same kernels are available for 8 bit quantised samples (u8), raw envelope and power
+ * bins samples (u16) and calibrated or compensated samples (f32). They work on the samples
+ * directly, so no Datapoint array or wider copy of the data has to be built first.
+ *
+ * format_data_<type>()           same as format_data()
+ * get_average_amplitude_<type>() average of length samples
+ * get_max_peak_<type>()          strongest sample, with the distance given by start, end and
+ *                                the sample index in the same way as format_data()
+ *
+ * All are generated from one implementation in parking-detector.c. When the compiler targets
+ * NEON (__ARM_NEON, on 32 bit ARM only with -mfpu=neon) the u8 and u16 average and max peak
+ * are specialised, otherwise the generic kernels are used. ref-app-parking-pipeline-bench
+ * checks every kernel against format_data(), get_average_amplitude() and get_max_peak().
+ */
+#define DECLARE_SAMPLE_KERNELS(suffix, type) \
+	void format_data_##suffix(Datapoint *data, const type *amp, int length, float start, float end); \
+	float get_average_amplitude_##suffix(const type *amp, int length); \
+	Datapoint get_max_peak_##suffix(const type *amp, int length, float start, float end);
+
+DECLARE_SAMPLE_KERNELS(u8, uint8_t)
+DECLARE_SAMPLE_KERNELS(u16, uint16_t)
+DECLARE_SAMPLE_KERNELS(f32, float)
+
+
+/**
+ * @brief Fill a range gain table for the distances of a sweep
+ *
+ * The gain normalizes amplitudes to what the same reflector would give at
+ * GAIN_REFERENCE_DISTANCE, gain = (dist / GAIN_REFERENCE_DISTANCE)^exponent. It is computed once
+ * per range so that no transcendental math is needed per sweep.
+ *
+ * @param[out] gain Gain for every sample
+ * @param[in]  length Number of samples
+ * @param[in]  start Start of the measured range
+ * @param[in]  end End of the measured range
+ * @param[in]  exponent Range exponent, 0 gives unit gain
+ */
+void compute_gain_table(float *gain, int length, float start, float end, float exponent);
+
+
+/*
+ * Detection pipelines.
+ *
+ * A pipeline turns a raw sweep into its strongest sample, whether any sample is above the
+ * detection threshold, and a sweep quality. It is composed from one stage of each kind:
+ *
+ * filter   raw samples, or a [1 2 1] / 4 smoothing filter that suppresses single sample noise
+ * gain     unit gain, or a range gain table, see compute_gain_table()
+ * check    none, or an interference classification against the calibration noise profile
+ *          of the context, see resample_profile(), which looks at the raw samples so that
+ *          smoothing does not hide spikes
+ *
+ * Every combination is generated as its own function with the stages inlined, so each runs
+ * as a single loop over the raw u16 samples, with the gain multiply and the threshold
+ * compare of every sample in the same loop, without per sample calls or branches on the
+ * configuration. The configuration is only looked at once, by select_pipeline(). The
+ * pipeline with no stages is get_max_peak_u16(), using SIMD where available.
+ *
+ * A sweep is rejected as interference if it has isolated spikes far above the noise profile
+ * (real reflections are as wide as the radar pulse, so they rise gradually over many samples),
+ * if its total energy is far below the noise profile (dropout) or if a large part of it is
+ * saturated. Spikes are only checked for sweeps with enough samples to resolve the pulse
+ * shape, not for power bins.
+ *
+ * present is the same as car_present() on the peak when the threshold of the context is
+ * get_detection_threshold().
+ */
+typedef struct
+{
+	float       start;
+	float       end;
+	const float *gain;
+	const float *noise_profile;
+	float       threshold;
+} pipeline_context_t;
+
+typedef Datapoint (*detection_pipeline_t)(const pipeline_context_t *context, const uint16_t *sweep, int length, int *present,
+                                          sweep_quality_t *quality);
+
+
+/**
+ * @brief Select the pipeline for a configuration
+ *
+ * @param[in] smooth Smooth the sweep before the peak search
+ * @param[in] gain Apply the gain table of the context
+ * @param[in] interference_check Classify the sweep with the noise profile of the context,
+ *            otherwise the quality is always SWEEP_OK
+ * @return the pipeline
+ */
+detection_pipeline_t select_pipeline(bool smooth, bool gain, bool interference_check);
+
+
+/*
+ * Peak search across sensors.
+ *
+ * With many sensors and short sweeps, such as power bins, searching every sweep on its own
+ * spends more time on calls and on vector tails than on samples. A sweep batch holds the latest
+ * sweep of up to SWEEP_BATCH_MAX_SENSORS sensors sample-major in groups of SWEEP_BATCH_LANES
+ * sensors: sample i of the sensors of a group is stored next to each other, so one vector
+ * instruction handles sample i of a whole group. get_max_peaks_batch() finds the peak of every
+ * sensor and tests it against the threshold of that sensor in one pass over the block. The
+ * peaks are the ones get_max_peak_u16() gives for each sweep, and present is car_present().
+ * ref-app-parking searches the sweeps of a sensor list this way with --batch-search.
+ */
+#define SWEEP_BATCH_LANES       (8)
+#define SWEEP_BATCH_MAX_SENSORS (64)
+#define SWEEP_BATCH_MAX_LENGTH  (4096)
+#define SWEEP_BATCH_GROUPS      (SWEEP_BATCH_MAX_SENSORS / SWEEP_BATCH_LANES)
+
+typedef struct
+{
+	unsigned int sensors;
+	uint16_t     group_length[SWEEP_BATCH_GROUPS];
+	uint16_t     length[SWEEP_BATCH_MAX_SENSORS];
+	float        start[SWEEP_BATCH_MAX_SENSORS];
+	float        end[SWEEP_BATCH_MAX_SENSORS];
+	float        threshold[SWEEP_BATCH_MAX_SENSORS];
+	uint16_t     samples[SWEEP_BATCH_GROUPS][SWEEP_BATCH_MAX_LENGTH][SWEEP_BATCH_LANES];
+} sweep_batch_t;
+
+
+/**
+ * @brief Remove all sweeps from a batch
+ *
+ * @param[out] batch The batch
+ */
+void sweep_batch_clear(sweep_batch_t *batch);
+
+
+/**
+ * @brief Add the sweep of a sensor to a batch
+ *
+ * @param[in,out] batch The batch
+ * @param[in]     sweep The raw sweep
+ * @param[in]     length Number of samples in the sweep
+ * @param[in]     start Start of the measured range
+ * @param[in]     end End of the measured range
+ * @param[in]     threshold Detection threshold of the sensor, see get_detection_threshold()
+ * @return index of the sensor in the batch, or -1 if the batch is full or the sweep too long
+ */
+int sweep_batch_add(sweep_batch_t *batch, const uint16_t *sweep, int length, float start, float end, float threshold);
+
+
+/**
+ * @brief Find the peak of every sweep in a batch and test it against the threshold of its sensor
+ *
+ * @param[in]  batch The batch
+ * @param[out] peaks Peak of every sensor in the batch, in the order they were added
+ * @param[out] present 1 if the peak of the sensor is above its threshold, otherwise 0
+ */
+void get_max_peaks_batch(const sweep_batch_t *batch, Datapoint *peaks, int *present);
+
+
+/**
+ * @brief Resample calibration data to the distances of a sweep
+ *
+ * Calibration and measurement may cover different ranges, for example when a region of
+ * interest is applied. Each sweep sample gets the calibration sample closest in distance.
+ *
+ * @param[in]  profile Calibration data
+ * @param[in]  profile_length Number of samples in profile
+ * @param[in]  profile_start Start of the calibrated range
+ * @param[in]  profile_end End of the calibrated range
+ * @param[out] resampled Calibration amplitude for every sweep sample
+ * @param[in]  length Number of sweep samples
+ * @param[in]  start Start of the measured range
+ * @param[in]  end End of the measured range
+ */
+void resample_profile(const uint16_t *profile, unsigned profile_length, float profile_start, float profile_end,
+                      float *resampled, int length, float start, float end);
+
+
+/**
+ * @brief Calculate the detection threshold from one calibration sweep
+ *
+ * @param[in]  threshold_data Envelope or power bins data recorded on an empty parking spot
+ * @param[in]  n Number of samples in threshold_data
+ * @param[in]  start Start of the calibrated range
+ * @param[in]  end End of the calibrated range
+ * @param[in]  gain Range gain for every calibration sample, NULL for none
+ * @param[out] avg_calib_amp The average amplitude value from the threshold data
+ * @param[out] peak_amp The datapoint with highest amplitude and its corresponding distance
+ * @param[out] avg_amp_factor = peak_amp/avg_calib_amp
+ */
+void calculate_threshold(const uint16_t *threshold_data, unsigned n, float start, float end, const float *gain,
+                         float *avg_calib_amp, Datapoint *peak_amp, float *avg_amp_factor);
+
+
+#endif
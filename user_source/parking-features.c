@@ -0,0 +1,780 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking-detector.h"
+#include "parking-model.h"
+#include "parking-record.h"
+
+/*
+ * Feature extraction from recordings made with ref-app-parking --export, for building training
+ * data sets.
+ *
+ * Every measurement of the recordings is decoded and reduced to a feature vector with the
+ * detection pipeline and model_features() used online. The peak distance is computed from the
+ * range stored for the sensor in the recording, or from the range given on the command line
+ * for recordings made before ranges were stored. The features are defined on envelope sweeps,
+ * so recordings of sensors in power bins mode are refused.
+ *
+ * The work is split into tasks of a few chunks of one recording each, which a pool of
+ * threads takes one at a time, so a single long recording uses all threads as well as many
+ * short ones.
+ *
+ * Every recording gets a feature file <recording>.feat, written next to the recording or to
+ * the output directory. All values are little endian:
+ *
+ *   "PARKFEA1"             magic
+ *   u32                    row size, FEATURE_ROW_SIZE
+ *   u32                    number of features per row, MODEL_FEATURE_COUNT
+ *   u64                    number of rows
+ *
+ * followed by one row per measurement in sequence order, so the row of a sequence number is at
+ * a fixed offset:
+ *
+ *   u64 time_ms            time of the measurement [ms since the epoch]
+ *   u16 sensor             sensor of the measurement
+ *   i8  result             recorded detection result, the label
+ *   u8                     reserved, 0
+ *   f32 peak_amp           peak amplitude
+ *   f32 peak_dist          distance of the peak [m]
+ *   f32 energy             mean square amplitude of the sweep
+ *   f32 noise_floor        mean amplitude of the samples below the average amplitude
+ *   f32 temporal_variance  mean square difference to the previous sweep of the same sensor,
+ *                          0 if there is none in this or the previous chunk
+ *
+ * The temporal variance only looks back one chunk, so the feature files are the same whatever
+ * the number of threads and the task size.
+ */
+
+#define FEATURE_HEADER_SIZE (24)
+#define FEATURE_ROW_SIZE    (32)
+#define FEATURE_SUFFIX      ".feat"
+#define MAX_TRACKED_SENSORS (32)
+
+static const char FEATURE_MAGIC[8] = {'P', 'A', 'R', 'K', 'F', 'E', 'A', '1'};
+
+/* default settings */
+
+static const float DEFAULT_START_RANGE  = 0.12;
+static const float DEFAULT_LENGTH_RANGE = 0.48;
+static const int   DEFAULT_TASK_CHUNKS  = 16;
+
+typedef struct
+{
+	char       **file_names;
+	int        file_count;
+	const char *output_dir;
+	float      start;
+	float      length;
+	bool       smooth;
+	int        threads;
+	int        task_chunks;
+	bool       verbose;
+} features_configuration_t;
+
+/* some chunks of one recording */
+typedef struct
+{
+	int      file;
+	uint64_t first_chunk;
+	uint64_t chunk_count;
+} task_t;
+
+/* the previous sweep of a sensor */
+typedef struct
+{
+	int      sensor;
+	uint64_t chunk;
+	uint16_t length;
+	uint16_t *samples;
+} tracked_sweep_t;
+
+typedef struct
+{
+	const features_configuration_t *config;
+	const task_t                   *tasks;
+	size_t                         task_count;
+	const int                      *outputs;
+	detection_pipeline_t           pipeline;
+	pthread_mutex_t                lock;
+	size_t                         next_task;
+	bool                           failed;
+} work_t;
+
+typedef struct
+{
+	work_t          *work;
+	pthread_t       thread;
+	record_reader_t *reader;
+	int             reader_file;
+	tracked_sweep_t tracked[MAX_TRACKED_SENSORS];
+	uint8_t         rows[RECORD_CHUNK_ROWS * FEATURE_ROW_SIZE];
+	uint64_t        records;
+} worker_t;
+
+
+/**
+ * @brief Print usage information to stdout
+ *
+ * @param[in] program_name
+ */
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] <recording>...\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-o, --output                  directory for the feature files, default next to the recordings\n");
+	fprintf(stderr, "-a, --range-start             start of the recorded sweeps [m] for recordings without stored ranges,\n");
+	fprintf(stderr, "                              default %.3f\n", (double)DEFAULT_START_RANGE);
+	fprintf(stderr, "-d, --range-length            length of the recorded sweeps [m] for recordings without stored ranges,\n");
+	fprintf(stderr, "                              default %.3f\n", (double)DEFAULT_LENGTH_RANGE);
+	fprintf(stderr, "-S, --smooth                  smooth the sweeps before the peak search, as ref-app-parking --smooth\n");
+	fprintf(stderr, "-j, --jobs                    number of threads, default the number of CPUs\n");
+	fprintf(stderr, "-c, --task-chunks             chunks per task, default %d\n", DEFAULT_TASK_CHUNKS);
+	fprintf(stderr, "-v, --verbose                 print every finished task\n");
+}
+
+
+/**
+ * @brief Parse command line options and update configuration struct
+ *
+ * @param[in]  argc Number of arguments passed to the main function
+ * @param[in]  argv Array with arguments passed to the main function
+ * @param[out] config configuration data to be updated
+ */
+static void parse_options(int argc, char *argv[], features_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"output",                  required_argument,    0,    'o'},
+		{"range-start",             required_argument,    0,    'a'},
+		{"range-length",            required_argument,    0,    'd'},
+		{"smooth",                  no_argument,          0,    'S'},
+		{"jobs",                    required_argument,    0,    'j'},
+		{"task-chunks",             required_argument,    0,    'c'},
+		{"verbose",                 no_argument,          0,    'v'},
+		{NULL,                      0,                    NULL, 0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	memset(config, 0, sizeof(*config));
+	config->start       = DEFAULT_START_RANGE;
+	config->length      = DEFAULT_LENGTH_RANGE;
+	config->threads     = sysconf(_SC_NPROCESSORS_ONLN);
+	config->task_chunks = DEFAULT_TASK_CHUNKS;
+
+	while ((character_code = getopt_long(argc, argv, "o:a:d:Sj:c:vh?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'o':
+			{
+				config->output_dir = optarg;
+				break;
+			}
+
+			case 'a':
+			{
+				config->start = strtof(optarg, NULL);
+				break;
+			}
+
+			case 'd':
+			{
+				config->length = strtof(optarg, NULL);
+				break;
+			}
+
+			case 'S':
+			{
+				config->smooth = true;
+				break;
+			}
+
+			case 'j':
+			{
+				config->threads = atoi(optarg);
+				break;
+			}
+
+			case 'c':
+			{
+				config->task_chunks = atoi(optarg);
+				break;
+			}
+
+			case 'v':
+			{
+				config->verbose = true;
+				break;
+			}
+
+			case 'h':
+			case '?':
+			default:
+			{
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	config->file_names = argv + optind;
+	config->file_count = argc - optind;
+
+	if (config->threads < 1)
+	{
+		config->threads = 1;
+	}
+
+	if (config->file_count < 1 || config->task_chunks < 1 || config->length <= 0)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Print an error message and exit
+ *
+ * @param[in] message Error message
+ */
+static void handle_fatal_error(const char *message)
+{
+	fprintf(stderr, "Fatal error: %s\n", message);
+	exit(EXIT_FAILURE);
+}
+
+
+/**
+ * @brief Store an unsigned little endian integer
+ *
+ * @param[out] out Output bytes
+ * @param[in]  value The value
+ * @param[in]  size Number of bytes
+ */
+static void put_le(uint8_t *out, uint64_t value, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+
+/**
+ * @brief Store a float as little endian IEEE 754 bits
+ *
+ * @param[out] out Output bytes
+ * @param[in]  value The value
+ */
+static void put_f32(uint8_t *out, float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	put_le(out, bits, sizeof(bits));
+}
+
+
+/**
+ * @brief Name of the feature file of a recording
+ *
+ * @param[in] config The configuration
+ * @param[in] file_name Name of the recording
+ * @return allocated name, to be freed by the caller
+ */
+static char *feature_name(const features_configuration_t *config, const char *file_name)
+{
+	const char *base = file_name;
+	char       *name;
+	size_t     size;
+
+	if (config->output_dir != NULL)
+	{
+		const char *slash = strrchr(file_name, '/');
+
+		base = (slash != NULL) ? slash + 1 : file_name;
+		size = strlen(config->output_dir) + 1 + strlen(base) + sizeof(FEATURE_SUFFIX);
+		name = malloc(size);
+		if (name != NULL)
+		{
+			snprintf(name, size, "%s/%s" FEATURE_SUFFIX, config->output_dir, base);
+		}
+
+		return name;
+	}
+
+	size = strlen(base) + sizeof(FEATURE_SUFFIX);
+	name = malloc(size);
+	if (name != NULL)
+	{
+		snprintf(name, size, "%s" FEATURE_SUFFIX, base);
+	}
+
+	return name;
+}
+
+
+/**
+ * @brief Create a feature file with room for all rows
+ *
+ * @param[in] file_name Name of the feature file
+ * @param[in] rows Number of measurements in the recording
+ * @return file descriptor, or -1 on failure
+ */
+static int create_feature_file(const char *file_name, uint64_t rows)
+{
+	uint8_t header[FEATURE_HEADER_SIZE];
+	int     fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	memcpy(header, FEATURE_MAGIC, sizeof(FEATURE_MAGIC));
+	put_le(header + 8, FEATURE_ROW_SIZE, 4);
+	put_le(header + 12, MODEL_FEATURE_COUNT, 4);
+	put_le(header + 16, rows, 8);
+
+	if (write(fd, header, sizeof(header)) != (ssize_t)sizeof(header) ||
+	    ftruncate(fd, FEATURE_HEADER_SIZE + rows * FEATURE_ROW_SIZE) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+/**
+ * @brief Find the previous sweep of a sensor, or a free slot for it
+ *
+ * @param[in,out] worker The worker
+ * @param[in]     sensor The sensor
+ * @return the slot, or NULL if all slots are taken by other sensors
+ */
+static tracked_sweep_t *track_sensor(worker_t *worker, int sensor)
+{
+	for (int i = 0; i < MAX_TRACKED_SENSORS; i++)
+	{
+		tracked_sweep_t *tracked = &worker->tracked[i];
+
+		if (tracked->sensor == sensor)
+		{
+			return tracked;
+		}
+
+		if (tracked->sensor < 0)
+		{
+			if (tracked->samples == NULL)
+			{
+				tracked->samples = malloc(UINT16_MAX * sizeof(uint16_t));
+				if (tracked->samples == NULL)
+				{
+					return NULL;
+				}
+			}
+
+			tracked->sensor = sensor;
+			tracked->length = 0;
+			return tracked;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @brief Remember a sweep as the previous sweep of its sensor
+ *
+ * @param[in,out] worker The worker
+ * @param[in]     record The measurement
+ * @param[in]     chunk Chunk of the measurement
+ */
+static void remember_sweep(worker_t *worker, const record_t *record, uint64_t chunk)
+{
+	tracked_sweep_t *tracked = track_sensor(worker, record->sensor);
+
+	if (tracked != NULL)
+	{
+		tracked->chunk  = chunk;
+		tracked->length = record->sweep_length;
+		memcpy(tracked->samples, record->sweep, record->sweep_length * sizeof(uint16_t));
+	}
+}
+
+
+/**
+ * @brief Compute the features of one measurement and store them as a row
+ *
+ * @param[in,out] worker The worker
+ * @param[in]     record The measurement
+ * @param[in]     chunk Chunk of the measurement
+ * @param[out]    row Output row, FEATURE_ROW_SIZE bytes
+ * @return false if the recording does not describe the sensor of the measurement
+ */
+static bool extract_features(worker_t *worker, const record_t *record, uint64_t chunk, uint8_t *row)
+{
+	const features_configuration_t *config   = worker->work->config;
+	const tracked_sweep_t          *tracked  = track_sensor(worker, record->sensor);
+	const uint16_t                 *previous = NULL;
+	const record_sensor_t          *sensors;
+	record_sensor_t                description;
+	Datapoint                      peak      = {0, 0};
+	float                          features[MODEL_FEATURE_COUNT];
+
+	//recordings made before ranges were stored describe none of their sensors
+	if (!record_reader_sensor(worker->reader, record->sensor, &description))
+	{
+		if (record_reader_sensors(worker->reader, &sensors) > 0)
+		{
+			return false;
+		}
+
+		description.start  = config->start;
+		description.length = config->length;
+	}
+
+	pipeline_context_t context = {description.start, description.start + description.length, NULL, NULL, 0};
+
+	if (record->sweep_length > 0)
+	{
+		sweep_quality_t quality;
+		int             present;
+
+		peak = worker->work->pipeline(&context, record->sweep, record->sweep_length, &present, &quality);
+	}
+
+	if (tracked != NULL && tracked->length == record->sweep_length && tracked->chunk + 1 >= chunk)
+	{
+		previous = tracked->samples;
+	}
+
+	model_features(features, peak, record->sweep, previous, record->sweep_length);
+	remember_sweep(worker, record, chunk);
+
+	memset(row, 0, FEATURE_ROW_SIZE);
+	put_le(row, record->time_ms, 8);
+	put_le(row + 8, record->sensor, 2);
+	row[10] = (uint8_t)record->result;
+
+	for (int i = 0; i < MODEL_FEATURE_COUNT; i++)
+	{
+		put_f32(row + 12 + 4 * i, features[i]);
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Extract the features of the chunks of one task
+ *
+ * @param[in,out] worker The worker
+ * @param[in]     task The task
+ * @return false if the recording could not be read or the feature file not written
+ */
+static bool run_task(worker_t *worker, const task_t *task)
+{
+	const features_configuration_t *config = worker->work->config;
+	record_t                       record;
+	uint64_t                       sequence;
+
+	if (worker->reader_file != task->file)
+	{
+		if (worker->reader != NULL)
+		{
+			record_reader_close(worker->reader);
+		}
+
+		worker->reader      = record_reader_open(config->file_names[task->file]);
+		worker->reader_file = task->file;
+		if (worker->reader == NULL)
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < MAX_TRACKED_SENSORS; i++)
+	{
+		worker->tracked[i].sensor = -1;
+	}
+
+	//the previous chunk only provides the previous sweeps for the temporal variance
+	if (task->first_chunk > 0)
+	{
+		uint64_t chunk = task->first_chunk - 1;
+		uint32_t rows;
+
+		if (!record_reader_seek_chunk(worker->reader, chunk, &rows))
+		{
+			return false;
+		}
+
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			if (!record_reader_next(worker->reader, &record, &sequence))
+			{
+				return false;
+			}
+
+			remember_sweep(worker, &record, chunk);
+		}
+	}
+
+	for (uint64_t chunk = task->first_chunk; chunk < task->first_chunk + task->chunk_count; chunk++)
+	{
+		uint64_t first_sequence = 0;
+		uint32_t rows;
+
+		if (!record_reader_seek_chunk(worker->reader, chunk, &rows))
+		{
+			return false;
+		}
+
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			if (!record_reader_next(worker->reader, &record, &sequence))
+			{
+				return false;
+			}
+
+			if (row == 0)
+			{
+				first_sequence = sequence;
+			}
+
+			if (!extract_features(worker, &record, chunk, worker->rows + row * FEATURE_ROW_SIZE))
+			{
+				return false;
+			}
+		}
+
+		size_t size   = (size_t)rows * FEATURE_ROW_SIZE;
+		off_t  offset = FEATURE_HEADER_SIZE + first_sequence * FEATURE_ROW_SIZE;
+
+		if (pwrite(worker->work->outputs[task->file], worker->rows, size, offset) != (ssize_t)size)
+		{
+			return false;
+		}
+
+		worker->records += rows;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Thread taking tasks until all are done
+ *
+ * @param[in,out] arg The worker
+ * @return NULL
+ */
+static void *run_worker(void *arg)
+{
+	worker_t *worker = arg;
+	work_t   *work   = worker->work;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&work->lock);
+		size_t index = work->next_task++;
+		pthread_mutex_unlock(&work->lock);
+
+		if (index >= work->task_count)
+		{
+			break;
+		}
+
+		const task_t *task = &work->tasks[index];
+
+		if (!run_task(worker, task))
+		{
+			fprintf(stderr, "Could not extract the features of chunk %" PRIu64 " of %s\n", task->first_chunk,
+			        work->config->file_names[task->file]);
+
+			pthread_mutex_lock(&work->lock);
+			work->failed = true;
+			pthread_mutex_unlock(&work->lock);
+		}
+		else if (work->config->verbose)
+		{
+			fprintf(stderr, "%s: chunks %" PRIu64 " - %" PRIu64 " done\n", work->config->file_names[task->file],
+			        task->first_chunk, task->first_chunk + task->chunk_count - 1);
+		}
+	}
+
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	features_configuration_t config;
+	work_t                   work;
+	task_t                   *tasks;
+	int                      *outputs;
+	size_t                   task_count = 0;
+	uint64_t                 records    = 0;
+	struct timespec          start;
+	struct timespec          end;
+
+	parse_options(argc, argv, &config);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	tasks   = NULL;
+	outputs = calloc(config.file_count, sizeof(*outputs));
+	if (outputs == NULL)
+	{
+		handle_fatal_error("Could not allocate memory");
+	}
+
+	for (int file = 0; file < config.file_count; file++)
+	{
+		record_reader_t *reader = record_reader_open(config.file_names[file]);
+		uint64_t        chunks;
+		uint64_t        rows;
+
+		if (reader == NULL)
+		{
+			fprintf(stderr, "Could not open the recording %s\n", config.file_names[file]);
+			exit(EXIT_FAILURE);
+		}
+
+		const record_sensor_t *sensors;
+		uint32_t              sensor_count = record_reader_sensors(reader, &sensors);
+
+		for (uint32_t i = 0; i < sensor_count; i++)
+		{
+			if (sensors[i].mode != RECORD_MODE_ENVELOPE)
+			{
+				fprintf(stderr, "Sensor %u of %s is recorded in %s mode, features need envelope sweeps\n",
+				        (unsigned int)sensors[i].sensor, config.file_names[file], RECORD_MODE_NAMES[sensors[i].mode]);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		record_reader_size(reader, &chunks, &rows);
+		record_reader_close(reader);
+
+		char *name = feature_name(&config, config.file_names[file]);
+
+		outputs[file] = (name != NULL) ? create_feature_file(name, rows) : -1;
+		if (outputs[file] < 0)
+		{
+			fprintf(stderr, "Could not create the feature file of %s\n", config.file_names[file]);
+			exit(EXIT_FAILURE);
+		}
+
+		free(name);
+
+		size_t file_tasks = (chunks + config.task_chunks - 1) / config.task_chunks;
+
+		if (file_tasks > 0)
+		{
+			tasks = realloc(tasks, (task_count + file_tasks) * sizeof(*tasks));
+			if (tasks == NULL)
+			{
+				handle_fatal_error("Could not allocate memory");
+			}
+		}
+
+		for (uint64_t chunk = 0; chunk < chunks; chunk += config.task_chunks)
+		{
+			task_t *task = &tasks[task_count++];
+
+			task->file        = file;
+			task->first_chunk = chunk;
+			task->chunk_count = (chunks - chunk < (uint64_t)config.task_chunks) ? chunks - chunk : (uint64_t)config.task_chunks;
+		}
+
+		records += rows;
+	}
+
+	work.config     = &config;
+	work.tasks      = tasks;
+	work.task_count = task_count;
+	work.outputs    = outputs;
+	work.pipeline   = select_pipeline(config.smooth, false, false);
+	work.next_task  = 0;
+	work.failed     = false;
+	pthread_mutex_init(&work.lock, NULL);
+
+	worker_t *workers = calloc(config.threads, sizeof(*workers));
+
+	if (workers == NULL)
+	{
+		handle_fatal_error("Could not allocate memory");
+	}
+
+	for (int i = 0; i < config.threads; i++)
+	{
+		workers[i].work        = &work;
+		workers[i].reader_file = -1;
+
+		if (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) != 0)
+		{
+			handle_fatal_error("Could not start a thread");
+		}
+	}
+
+	uint64_t extracted = 0;
+
+	for (int i = 0; i < config.threads; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		extracted += workers[i].records;
+
+		if (workers[i].reader != NULL)
+		{
+			record_reader_close(workers[i].reader);
+		}
+
+		for (int j = 0; j < MAX_TRACKED_SENSORS; j++)
+		{
+			free(workers[i].tracked[j].samples);
+		}
+	}
+
+	for (int file = 0; file < config.file_count; file++)
+	{
+		if (close(outputs[file]) != 0)
+		{
+			work.failed = true;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	printf("%d recordings, %" PRIu64 " of %" PRIu64 " measurements in %.2f s, %.0f measurements/s with %d threads\n",
+	       config.file_count, extracted, records, seconds, (seconds > 0) ? extracted / seconds : 0, config.threads);
+
+	pthread_mutex_destroy(&work.lock);
+	free(workers);
+	free(tasks);
+	free(outputs);
+
+	return (work.failed || extracted != records) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <stdio.h>
+
+#include "parking-governor.h"
+
+
+/* seconds between load measurements */
+static const double SAMPLE_INTERVAL = 2.0;
+
+/* seconds to keep a new level before the next change, so the learned costs can follow */
+static const double HOLD_TIME = 6.0;
+
+/* restore only below this share of the budgets */
+static const double RESTORE_SHARE = 0.7;
+
+/* number of times the freshness is doubled after the averaging depth is used up */
+static const int STRETCH_LEVELS = 3;
+
+const char *GOVERNOR_POLICY_NAMES[] = {"freshness", "order"};
+
+
+/**
+ * @brief Number of times the averaging depth can be halved
+ *
+ * @param[in] sweeps Configured averaging depth
+ * @return number of levels
+ */
+static int sweep_levels(int sweeps)
+{
+	int levels = 0;
+
+	while (sweeps > 1)
+	{
+		sweeps /= 2;
+		levels++;
+	}
+
+	return levels;
+}
+
+
+/**
+ * @brief Read the busy and total CPU time of the gateway
+ *
+ * @param[out] busy Busy time of all CPUs [clock ticks]
+ * @param[out] total Total time of all CPUs [clock ticks]
+ * @return false if /proc/stat could not be read
+ */
+static bool read_cpu_time(unsigned long long *busy, unsigned long long *total)
+{
+	FILE               *fin     = fopen("/proc/stat", "r");
+	unsigned long long times[8] = {0};
+	int                res;
+
+	if (fin == NULL)
+	{
+		return false;
+	}
+
+	res = fscanf(fin, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &times[0], &times[1], &times[2], &times[3], &times[4],
+	             &times[5], &times[6], &times[7]);
+	fclose(fin);
+
+	if (res < 4)
+	{
+		return false;
+	}
+
+	//idle and iowait are the 4th and 5th field
+	*total = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		*total += times[i];
+	}
+
+	*busy = *total - times[3] - times[4];
+	return true;
+}
+
+
+/**
+ * @brief Check if sensor a is less critical than sensor b
+ *
+ * @param[in] governor The governor
+ * @param[in] sensors The sensors
+ * @param[in] a Index of sensor a
+ * @param[in] b Index of sensor b
+ * @return true if a is less critical
+ */
+static bool less_critical(const governor_t *governor, const governor_sensor_t *sensors, unsigned int a, unsigned int b)
+{
+	if (governor->policy == GOVERNOR_POLICY_FRESHNESS && sensors[a].freshness != sensors[b].freshness)
+	{
+		return sensors[a].freshness > sensors[b].freshness;
+	}
+
+	return a > b;
+}
+
+
+void governor_init(governor_t *governor, governor_sensor_t *sensors, const int *sweeps, const double *freshness,
+                   unsigned int count, governor_policy_t policy, double cpu_budget, double bus_budget, double now)
+{
+	governor->policy       = policy;
+	governor->cpu_budget   = cpu_budget;
+	governor->bus_budget   = bus_budget;
+	governor->cpu          = -1;
+	governor->bus          = 0;
+	governor->sample_time  = now;
+	governor->change_time  = now;
+	governor->degradations = 0;
+	governor->restorations = 0;
+
+	if (!read_cpu_time(&governor->cpu_busy, &governor->cpu_total))
+	{
+		governor->cpu_busy  = 0;
+		governor->cpu_total = 0;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		sensors[i].sweeps    = sweeps[i];
+		sensors[i].freshness = freshness[i];
+		sensors[i].level     = 0;
+		sensors[i].max_level = sweep_levels(sweeps[i]) + STRETCH_LEVELS;
+	}
+}
+
+
+int governor_update(governor_t *governor, governor_sensor_t *sensors, const double *utilization, unsigned int count, double now)
+{
+	unsigned long long busy;
+	unsigned long long total;
+
+	if (now - governor->sample_time < SAMPLE_INTERVAL)
+	{
+		return -1;
+	}
+
+	//the CPU budget is ignored where /proc/stat is not available
+	governor->cpu = -1;
+	if (read_cpu_time(&busy, &total))
+	{
+		if (governor->cpu_total > 0 && total > governor->cpu_total)
+		{
+			governor->cpu = (double)(busy - governor->cpu_busy) / (total - governor->cpu_total);
+		}
+
+		governor->cpu_busy  = busy;
+		governor->cpu_total = total;
+	}
+
+	governor->bus = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		governor->bus += utilization[i];
+	}
+
+	governor->sample_time = now;
+
+	if (now - governor->change_time < HOLD_TIME)
+	{
+		return -1;
+	}
+
+	int  candidate = -1;
+	bool over      = governor->cpu > governor->cpu_budget || governor->bus > governor->bus_budget;
+	bool under     = governor->cpu < RESTORE_SHARE * governor->cpu_budget && governor->bus < RESTORE_SHARE * governor->bus_budget;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (over && sensors[i].level < sensors[i].max_level &&
+		    (candidate < 0 || less_critical(governor, sensors, i, candidate)))
+		{
+			candidate = i;
+		}
+		else if (!over && under && sensors[i].level > 0 &&
+		         (candidate < 0 || less_critical(governor, sensors, candidate, i)))
+		{
+			candidate = i;
+		}
+	}
+
+	if (candidate < 0)
+	{
+		return -1;
+	}
+
+	if (over)
+	{
+		sensors[candidate].level++;
+		governor->degradations++;
+	}
+	else
+	{
+		//one level back at most doubles the bus time of the sensor
+		if (governor->bus + utilization[candidate] > governor->bus_budget)
+		{
+			return -1;
+		}
+
+		sensors[candidate].level--;
+		governor->restorations++;
+	}
+
+	governor->change_time = now;
+	return candidate;
+}
+
+
+void governor_settings(const governor_sensor_t *sensor, int *sweeps, double *freshness)
+{
+	int halvings = sweep_levels(sensor->sweeps);
+	int level    = (sensor->level < halvings) ? sensor->level : halvings;
+
+	*sweeps    = sensor->sweeps >> level;
+	*freshness = sensor->freshness * (1 << (sensor->level - level));
+
+	if (*sweeps < 1)
+	{
+		*sweeps = 1;
+	}
+}
@@ -0,0 +1,97 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_GOVERNOR_H_
+#define PARKING_GOVERNOR_H_
+
+#include <stdbool.h>
+
+
+/*
+ * Load shedding for sensors measured by the scheduler.
+ *
+ * Every few seconds the governor compares the CPU utilization of the whole gateway, read from
+ * /proc/stat, and the bus utilization of the scheduled measurements with their budgets. While
+ * either is over budget, the least critical sensor is degraded one level at a time: first its
+ * averaging depth is halved down to a single sweep, then its freshness is doubled up to
+ * eight times the configured freshness. When both are well below budget again, the most
+ * critical degraded sensor is restored one level at a time, as long as that is not expected
+ * to exceed the bus budget.
+ *
+ * GOVERNOR_POLICY_FRESHNESS treats sensors with a longer configured freshness as less
+ * critical, GOVERNOR_POLICY_ORDER treats sensors later in the sensor list as less critical.
+ */
+typedef enum
+{
+	GOVERNOR_POLICY_FRESHNESS,
+	GOVERNOR_POLICY_ORDER,
+	GOVERNOR_POLICY_COUNT
+} governor_policy_t;
+
+extern const char *GOVERNOR_POLICY_NAMES[];
+
+typedef struct
+{
+	int    sweeps;
+	double freshness;
+	int    level;
+	int    max_level;
+} governor_sensor_t;
+
+typedef struct
+{
+	governor_policy_t  policy;
+	double             cpu_budget;
+	double             bus_budget;
+	double             cpu;
+	double             bus;
+	double             sample_time;
+	double             change_time;
+	unsigned long long cpu_busy;
+	unsigned long long cpu_total;
+	unsigned int       degradations;
+	unsigned int       restorations;
+} governor_t;
+
+
+/**
+ * @brief Initialize the governor and the sensors with their configured settings
+ *
+ * @param[out] governor The governor
+ * @param[out] sensors The sensors
+ * @param[in]  sweeps Configured averaging depth of every sensor
+ * @param[in]  freshness Configured freshness of every sensor [s]
+ * @param[in]  count Number of sensors
+ * @param[in]  policy Which sensors to degrade first
+ * @param[in]  cpu_budget Maximum CPU utilization of the gateway, 0.0 - 1.0
+ * @param[in]  bus_budget Maximum bus utilization, 0.0 - 1.0
+ * @param[in]  now Current time [s]
+ */
+void governor_init(governor_t *governor, governor_sensor_t *sensors, const int *sweeps, const double *freshness,
+                   unsigned int count, governor_policy_t policy, double cpu_budget, double bus_budget, double now);
+
+
+/**
+ * @brief Measure the load and degrade or restore one sensor if needed
+ *
+ * @param[in,out] governor The governor
+ * @param[in,out] sensors The sensors
+ * @param[in]     utilization Bus utilization of every sensor with its current settings
+ * @param[in]     count Number of sensors
+ * @param[in]     now Current time [s]
+ * @return index of the sensor whose level changed, or -1
+ */
+int governor_update(governor_t *governor, governor_sensor_t *sensors, const double *utilization, unsigned int count, double now);
+
+
+/**
+ * @brief Current settings of a sensor at its level
+ *
+ * @param[in]  sensor The sensor
+ * @param[out] sweeps Averaging depth
+ * @param[out] freshness Freshness [s]
+ */
+void governor_settings(const governor_sensor_t *sensor, int *sweeps, double *freshness);
+
+
+#endif
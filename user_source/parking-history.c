@@ -0,0 +1,434 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parking-history.h"
+
+
+#define MAGIC_SIZE        (8)
+#define ENTRY_SIZE        (16)
+#define INDEX_HEADER_SIZE (16)
+#define INDEX_ENTRY_SIZE  (8)
+#define NO_PAGE           (UINT64_MAX)
+
+static const char HISTORY_MAGIC[MAGIC_SIZE] = {'P', 'A', 'R', 'K', 'H', 'S', 'T', '1'};
+static const char INDEX_MAGIC[MAGIC_SIZE]   = {'P', 'A', 'R', 'K', 'H', 'I', 'X', '1'};
+
+struct history
+{
+	int      fd;
+	int      index_fd;
+	uint64_t entries;
+	uint64_t first_hour;
+	uint64_t hours;
+	uint64_t last_time;
+	uint64_t position;
+	uint64_t page;
+	uint64_t pages_read;
+	uint8_t  buffer[HISTORY_PAGE_ENTRIES * ENTRY_SIZE];
+};
+
+
+/**
+ * @brief Store an unsigned little endian integer
+ *
+ * @param[out] out Output bytes
+ * @param[in]  value The value
+ * @param[in]  size Number of bytes
+ */
+static void put_le(uint8_t *out, uint64_t value, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		out[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+
+/**
+ * @brief Load an unsigned little endian integer
+ *
+ * @param[in] bytes Input bytes
+ * @param[in] size Number of bytes
+ * @return the value
+ */
+static uint64_t get_le(const uint8_t *bytes, size_t size)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		value |= (uint64_t)bytes[i] << (8 * i);
+	}
+
+	return value;
+}
+
+
+/**
+ * @brief Read an entry, through the page buffer
+ *
+ * @param[in,out] history The history
+ * @param[in]     index Index of the entry
+ * @param[out]    entry The entry
+ * @return false if reading failed
+ */
+static bool read_entry(history_t *history, uint64_t index, history_entry_t *entry)
+{
+	uint64_t page = index / HISTORY_PAGE_ENTRIES;
+
+	if (page != history->page)
+	{
+		uint64_t first  = page * HISTORY_PAGE_ENTRIES;
+		uint64_t count  = history->entries - first;
+		size_t   size   = ((count < HISTORY_PAGE_ENTRIES) ? count : HISTORY_PAGE_ENTRIES) * ENTRY_SIZE;
+		off_t    offset = MAGIC_SIZE + first * ENTRY_SIZE;
+
+		if (pread(history->fd, history->buffer, size, offset) != (ssize_t)size)
+		{
+			history->page = NO_PAGE;
+			return false;
+		}
+
+		history->page = page;
+		history->pages_read++;
+	}
+
+	const uint8_t *bytes = history->buffer + (index % HISTORY_PAGE_ENTRIES) * ENTRY_SIZE;
+	uint32_t      bits   = (uint32_t)get_le(bytes + 8, 4);
+
+	entry->time_ms = get_le(bytes, 8);
+	memcpy(&entry->peak_amp, &bits, sizeof(entry->peak_amp));
+	entry->result  = (int8_t)bytes[12];
+
+	return true;
+}
+
+
+/**
+ * @brief Read the index entry of an hour
+ *
+ * @param[in]  history The history
+ * @param[in]  hour Hour since the first hour
+ * @param[out] first Number of entries before the start of the hour
+ * @return false if reading failed
+ */
+static bool read_index(const history_t *history, uint64_t hour, uint64_t *first)
+{
+	uint8_t bytes[INDEX_ENTRY_SIZE];
+
+	if (pread(history->index_fd, bytes, sizeof(bytes), INDEX_HEADER_SIZE + hour * INDEX_ENTRY_SIZE) != sizeof(bytes))
+	{
+		return false;
+	}
+
+	*first = get_le(bytes, sizeof(bytes));
+	return true;
+}
+
+
+/**
+ * @brief Extend the index to the hour of an entry
+ *
+ * @param[in,out] history The history
+ * @param[in]     index Index of the entry
+ * @param[in]     time_ms Time of the entry
+ * @return false if writing failed
+ */
+static bool index_entry(history_t *history, uint64_t index, uint64_t time_ms)
+{
+	uint8_t bytes[INDEX_HEADER_SIZE];
+
+	if (history->hours == 0)
+	{
+		history->first_hour = time_ms - time_ms % HISTORY_BUCKET_MS;
+
+		memcpy(bytes, INDEX_MAGIC, MAGIC_SIZE);
+		put_le(bytes + MAGIC_SIZE, history->first_hour, 8);
+		if (pwrite(history->index_fd, bytes, INDEX_HEADER_SIZE, 0) != INDEX_HEADER_SIZE)
+		{
+			return false;
+		}
+	}
+
+	uint64_t hour = (time_ms - history->first_hour) / HISTORY_BUCKET_MS;
+
+	put_le(bytes, index, INDEX_ENTRY_SIZE);
+
+	//hours without transitions point at the same entry as the next hour with one
+	while (history->hours <= hour)
+	{
+		if (pwrite(history->index_fd, bytes, INDEX_ENTRY_SIZE, INDEX_HEADER_SIZE + history->hours * INDEX_ENTRY_SIZE) != INDEX_ENTRY_SIZE)
+		{
+			return false;
+		}
+
+		history->hours++;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Load the index, or complete or rebuild it from the entries when writing
+ *
+ * @param[in,out] history The history
+ * @param[in]     write true if the history is opened for writing
+ * @return false if the index is needed but cannot be rebuilt
+ */
+static bool load_index(history_t *history, bool write)
+{
+	struct stat     status;
+	uint8_t         header[INDEX_HEADER_SIZE];
+	uint64_t        last  = 0;
+	history_entry_t entry;
+
+	history->hours = 0;
+
+	bool valid = fstat(history->index_fd, &status) == 0 && status.st_size >= INDEX_HEADER_SIZE &&
+	             pread(history->index_fd, header, INDEX_HEADER_SIZE, 0) == INDEX_HEADER_SIZE &&
+	             memcmp(header, INDEX_MAGIC, MAGIC_SIZE) == 0;
+
+	if (valid)
+	{
+		history->first_hour = get_le(header + MAGIC_SIZE, 8);
+		history->hours      = (status.st_size - INDEX_HEADER_SIZE) / INDEX_ENTRY_SIZE;
+
+		valid = history->hours == 0 || read_index(history, history->hours - 1, &last);
+	}
+
+	if (!write)
+	{
+		if (!valid)
+		{
+			history->hours = 0;
+		}
+
+		return true;
+	}
+
+	//the index must start at the first entry and may not point past the last one
+	if (valid && history->entries == 0)
+	{
+		valid = history->hours == 0;
+	}
+	else if (valid)
+	{
+		valid = history->hours > 0 && last <= history->entries && read_entry(history, 0, &entry) &&
+		        history->first_hour == entry.time_ms - entry.time_ms % HISTORY_BUCKET_MS;
+	}
+
+	//an index cut short by a crash is completed, any other mismatch is rebuilt
+	if (!valid)
+	{
+		history->hours = 0;
+		last           = 0;
+	}
+
+	off_t size = (history->hours > 0) ? INDEX_HEADER_SIZE + history->hours * INDEX_ENTRY_SIZE : 0;
+
+	if (ftruncate(history->index_fd, size) != 0)
+	{
+		return false;
+	}
+
+	for (uint64_t i = last; i < history->entries; i++)
+	{
+		if (!read_entry(history, i, &entry) || !index_entry(history, i, entry.time_ms))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+history_t *history_open(const char *file_name, bool write)
+{
+	history_t   *history = calloc(1, sizeof(history_t));
+	char        index_name[strlen(file_name) + 5];
+	char        magic[MAGIC_SIZE];
+	struct stat status;
+
+	if (history == NULL)
+	{
+		return NULL;
+	}
+
+	history->page     = NO_PAGE;
+	history->index_fd = -1;
+	history->fd       = open(file_name, write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+
+	bool ok = history->fd >= 0 && fstat(history->fd, &status) == 0;
+
+	if (ok && status.st_size == 0 && write)
+	{
+		ok = pwrite(history->fd, HISTORY_MAGIC, MAGIC_SIZE, 0) == MAGIC_SIZE;
+	}
+	else if (ok)
+	{
+		ok = status.st_size >= MAGIC_SIZE && pread(history->fd, magic, MAGIC_SIZE, 0) == MAGIC_SIZE &&
+		     memcmp(magic, HISTORY_MAGIC, MAGIC_SIZE) == 0;
+
+		history->entries = ok ? (status.st_size - MAGIC_SIZE) / ENTRY_SIZE : 0;
+	}
+
+	//an entry cut short by a crash is dropped
+	if (ok && write)
+	{
+		ok = ftruncate(history->fd, MAGIC_SIZE + history->entries * ENTRY_SIZE) == 0;
+	}
+
+	snprintf(index_name, sizeof(index_name), "%s.idx", file_name);
+	if (ok)
+	{
+		history->index_fd = open(index_name, write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+		ok                = (history->index_fd >= 0 || !write) && load_index(history, write);
+	}
+
+	history_entry_t last;
+
+	if (ok && history->entries > 0)
+	{
+		ok                 = read_entry(history, history->entries - 1, &last);
+		history->last_time = last.time_ms;
+	}
+
+	if (!ok)
+	{
+		history_close(history);
+		return NULL;
+	}
+
+	return history;
+}
+
+
+bool history_append(history_t *history, const history_entry_t *entry)
+{
+	uint8_t  bytes[ENTRY_SIZE] = {0};
+	uint64_t time_ms           = (entry->time_ms > history->last_time) ? entry->time_ms : history->last_time;
+	uint32_t bits;
+
+	memcpy(&bits, &entry->peak_amp, sizeof(bits));
+	put_le(bytes, time_ms, 8);
+	put_le(bytes + 8, bits, 4);
+	bytes[12] = (uint8_t)(int8_t)entry->result;
+
+	if (pwrite(history->fd, bytes, ENTRY_SIZE, MAGIC_SIZE + history->entries * ENTRY_SIZE) != ENTRY_SIZE ||
+	    !index_entry(history, history->entries, time_ms))
+	{
+		return false;
+	}
+
+	//the buffered page may hold the end of the history
+	if (history->page == history->entries / HISTORY_PAGE_ENTRIES)
+	{
+		history->page = NO_PAGE;
+	}
+
+	history->entries++;
+	history->last_time = time_ms;
+
+	return true;
+}
+
+
+bool history_last(history_t *history, history_entry_t *entry)
+{
+	return history->entries > 0 && read_entry(history, history->entries - 1, entry);
+}
+
+
+bool history_seek(history_t *history, uint64_t time_ms, history_entry_t *state)
+{
+	history_entry_t entry;
+	uint64_t        first = 0;
+
+	if (history->hours > 0 && time_ms >= history->first_hour)
+	{
+		uint64_t hour = (time_ms - history->first_hour) / HISTORY_BUCKET_MS;
+
+		if (!read_index(history, (hour < history->hours) ? hour : history->hours - 1, &first))
+		{
+			return false;
+		}
+
+		//the index may have been extended after the history was opened
+		if (first > history->entries)
+		{
+			first = history->entries;
+		}
+	}
+
+	while (first < history->entries)
+	{
+		if (!read_entry(history, first, &entry))
+		{
+			return false;
+		}
+
+		if (entry.time_ms >= time_ms)
+		{
+			break;
+		}
+
+		first++;
+	}
+
+	history->position = first;
+
+	if (first == 0)
+	{
+		state->time_ms  = 0;
+		state->peak_amp = 0;
+		state->result   = -1;
+		return true;
+	}
+
+	return read_entry(history, first - 1, state);
+}
+
+
+bool history_next(history_t *history, history_entry_t *entry)
+{
+	if (history->position >= history->entries || !read_entry(history, history->position, entry))
+	{
+		return false;
+	}
+
+	history->position++;
+	return true;
+}
+
+
+void history_size(const history_t *history, uint64_t *entries, uint64_t *hours, uint64_t *pages)
+{
+	*entries = history->entries;
+	*hours   = history->hours;
+	*pages   = history->pages_read;
+}
+
+
+void history_close(history_t *history)
+{
+	if (history->fd >= 0)
+	{
+		close(history->fd);
+	}
+
+	if (history->index_fd >= 0)
+	{
+		close(history->index_fd);
+	}
+
+	free(history);
+}
@@ -0,0 +1,118 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_HISTORY_H_
+#define PARKING_HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define HISTORY_BUCKET_MS    (3600 * 1000)
+#define HISTORY_PAGE_ENTRIES (256)
+
+
+/*
+ * Occupancy history of one parking spot.
+ *
+ * Only the transitions of the spot are stored, so a month of history is a few hundred kB at
+ * most. Entries are appended in time order to the history file, and an index with one entry
+ * per hour of the history gives the first entry of every hour, so the state of the spot at
+ * a time is found by reading one index entry and the page holding the entries of that hour.
+ *
+ * All integers are little endian. The history file is
+ *   magic          8 bytes "PARKHST1"
+ *   per entry      u64 time in milliseconds since the epoch, f32 peak amplitude, i8 result,
+ *                  3 bytes reserved
+ * and the index, in <history>.idx,
+ *   magic          8 bytes "PARKHIX1"
+ *   first hour     u64 start of the hour of the first entry, milliseconds since the epoch
+ *   per hour       u64 number of entries before the start of the hour
+ * The index is written after the entries it describes, so it may lag behind the history but
+ * never points past it. An index that is missing or does not match the history is rebuilt
+ * when the history is opened for writing.
+ */
+typedef struct
+{
+	uint64_t time_ms;
+	float    peak_amp;
+	int      result;
+} history_entry_t;
+
+typedef struct history history_t;
+
+
+/**
+ * @brief Open a history, new entries are appended to an existing one
+ *
+ * @param[in] file_name Name of the history
+ * @param[in] write true to append entries, false to read
+ * @return the history, or NULL if the file cannot be opened or is not a history
+ */
+history_t *history_open(const char *file_name, bool write);
+
+
+/**
+ * @brief Append an entry and update the index
+ *
+ * Entries older than the last one are stored with the time of the last one, so a clock
+ * stepping back cannot break the time order.
+ *
+ * @param[in,out] history The history
+ * @param[in]     entry The entry, result 1 for a car, 0 for an empty spot and -1 for unknown
+ * @return false if writing failed
+ */
+bool history_append(history_t *history, const history_entry_t *entry);
+
+
+/**
+ * @brief Get the last entry
+ *
+ * @param[in,out] history The history
+ * @param[out]    entry The last entry
+ * @return false if the history is empty or reading failed
+ */
+bool history_last(history_t *history, history_entry_t *entry);
+
+
+/**
+ * @brief Position the history at the first entry at or after a time
+ *
+ * @param[in,out] history The history
+ * @param[in]     time_ms Time in milliseconds since the epoch
+ * @param[out]    state The last entry before the time, result -1 and time 0 if there is none
+ * @return false if reading failed
+ */
+bool history_seek(history_t *history, uint64_t time_ms, history_entry_t *state);
+
+
+/**
+ * @brief Read the entry at the position of the history and advance to the next one
+ *
+ * @param[in,out] history The history
+ * @param[out]    entry The entry
+ * @return false at the end of the history, or if reading failed
+ */
+bool history_next(history_t *history, history_entry_t *entry);
+
+
+/**
+ * @brief Size of the history and the pages read so far
+ *
+ * @param[in]  history The history
+ * @param[out] entries Number of entries
+ * @param[out] hours Number of hours in the index
+ * @param[out] pages Number of pages of HISTORY_PAGE_ENTRIES entries read
+ */
+void history_size(const history_t *history, uint64_t *entries, uint64_t *hours, uint64_t *pages);
+
+
+/**
+ * @brief Close the history
+ *
+ * @param[in] history The history
+ */
+void history_close(history_t *history);
+
+
+#endif
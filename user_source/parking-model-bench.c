@@ -0,0 +1,408 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking-model.h"
+
+/*
+ * Benchmark of the model runtime.
+ *
+ * Times the inference of a tree ensemble and a quantised linear model on synthetic feature
+ * vectors, and the computation of the features of a synthetic sweep. The models are either
+ * generated with the given size or loaded from a model file. Every model is saved and loaded
+ * again, and the benchmark fails if the loaded model does not give the same scores.
+ */
+
+/* default settings */
+
+static const int   DEFAULT_TREES       = 32;
+static const int   DEFAULT_DEPTH       = 6;
+static const int   DEFAULT_INFERENCES  = 1000000;
+static const int   DEFAULT_LENGTH      = 1000;
+static const float START_RANGE         = 0.12;
+static const float END_RANGE           = 0.60;
+static const int   NOISE_AMPLITUDE     = 200;
+
+#define VECTOR_COUNT (1024)
+#define MAX_LENGTH   (4096)
+
+typedef struct
+{
+	const char *model_file_name;
+	const char *output_file_name;
+	int        trees;
+	int        depth;
+	int        inferences;
+	int        length;
+} bench_configuration_t;
+
+static volatile float sink;
+
+
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-m, --model                   benchmark this model file instead of generated models\n");
+	fprintf(stderr, "-t, --trees                   trees of the generated ensemble, at most %d, default %d\n", MODEL_MAX_TREES, DEFAULT_TREES);
+	fprintf(stderr, "-d, --depth                   depth of the generated trees, at most %d, default %d\n", MODEL_MAX_DEPTH, DEFAULT_DEPTH);
+	fprintf(stderr, "-o, --output                  save the generated ensemble to this file\n");
+	fprintf(stderr, "-n, --inferences              inferences per model, default %d\n", DEFAULT_INFERENCES);
+	fprintf(stderr, "-l, --length                  samples per sweep for the features, at most %d, default %d\n", MAX_LENGTH, DEFAULT_LENGTH);
+}
+
+
+static void parse_options(int argc, char *argv[], bench_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"model",                   required_argument,    0,    'm'},
+		{"trees",                   required_argument,    0,    't'},
+		{"depth",                   required_argument,    0,    'd'},
+		{"output",                  required_argument,    0,    'o'},
+		{"inferences",              required_argument,    0,    'n'},
+		{"length",                  required_argument,    0,    'l'},
+		{NULL,                      0,                    NULL, 0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	memset(config, 0, sizeof(*config));
+	config->trees      = DEFAULT_TREES;
+	config->depth      = DEFAULT_DEPTH;
+	config->inferences = DEFAULT_INFERENCES;
+	config->length     = DEFAULT_LENGTH;
+
+	while ((character_code = getopt_long(argc, argv, "m:t:d:o:n:l:h?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'm':
+			{
+				config->model_file_name = optarg;
+				break;
+			}
+
+			case 't':
+			{
+				config->trees = atoi(optarg);
+				break;
+			}
+
+			case 'd':
+			{
+				config->depth = atoi(optarg);
+				break;
+			}
+
+			case 'o':
+			{
+				config->output_file_name = optarg;
+				break;
+			}
+
+			case 'n':
+			{
+				config->inferences = atoi(optarg);
+				break;
+			}
+
+			case 'l':
+			{
+				config->length = atoi(optarg);
+				break;
+			}
+
+			case 'h':
+			case '?':
+			default:
+			{
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (config->trees < 1 || config->trees > MODEL_MAX_TREES || config->depth < 1 || config->depth > MODEL_MAX_DEPTH ||
+	    config->inferences <= 0 || config->length <= 0 || config->length > MAX_LENGTH)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Next pseudo random number
+ *
+ * @param[in,out] state Generator state
+ * @return a number in 0.0 - 1.0
+ */
+static float next_random(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return (float)((*state >> 8) & 0xffff) / 0xffff;
+}
+
+
+/**
+ * @brief Fill the feature vectors with values in the ranges of real sweeps
+ *
+ * @param[out] vectors VECTOR_COUNT feature vectors
+ */
+static void generate_vectors(float vectors[][MODEL_FEATURE_COUNT])
+{
+	static const float MAXIMA[MODEL_FEATURE_COUNT] = {4000, 0.6, 2e6, 400, 2e4};
+
+	uint32_t random = 1;
+
+	for (int i = 0; i < VECTOR_COUNT; i++)
+	{
+		for (int feature = 0; feature < MODEL_FEATURE_COUNT; feature++)
+		{
+			vectors[i][feature] = next_random(&random) * MAXIMA[feature];
+		}
+	}
+}
+
+
+/**
+ * @brief Generate a tree ensemble with random splits in the ranges of the feature vectors
+ *
+ * @param[in] config The configuration
+ * @param[in] vectors VECTOR_COUNT feature vectors
+ * @return the model
+ */
+static model_t *generate_trees(const bench_configuration_t *config, float vectors[][MODEL_FEATURE_COUNT])
+{
+	model_t  *model = model_create_trees(MODEL_FEATURE_COUNT, config->trees, config->depth, -0.5, 0);
+	uint32_t random = 2;
+	int      leaves = 1 << config->depth;
+
+	if (model == NULL)
+	{
+		return NULL;
+	}
+
+	for (int tree = 0; tree < config->trees; tree++)
+	{
+		for (int node = 0; node < leaves - 1; node++)
+		{
+			int feature = (int)(next_random(&random) * MODEL_FEATURE_COUNT) % MODEL_FEATURE_COUNT;
+			int vector  = (int)(next_random(&random) * VECTOR_COUNT) % VECTOR_COUNT;
+
+			model_set_node(model, tree, node, feature, vectors[vector][feature]);
+		}
+
+		for (int leaf = 0; leaf < leaves; leaf++)
+		{
+			model_set_leaf(model, tree, leaf, next_random(&random) - 0.5f);
+		}
+	}
+
+	return model;
+}
+
+
+/**
+ * @brief Generate a linear model with random weights
+ *
+ * @return the model
+ */
+static model_t *generate_linear(void)
+{
+	static const float OFFSETS[MODEL_FEATURE_COUNT] = {2000, 0.3, 1e6, 200, 1e4};
+	static const float SCALES[MODEL_FEATURE_COUNT]  = {5e-4, 3, 1e-6, 5e-3, 1e-4};
+
+	int8_t   weights[MODEL_FEATURE_COUNT];
+	uint32_t random = 3;
+
+	for (int i = 0; i < MODEL_FEATURE_COUNT; i++)
+	{
+		weights[i] = (int8_t)(next_random(&random) * 254 - 127);
+	}
+
+	return model_create_linear(MODEL_FEATURE_COUNT, OFFSETS, SCALES, weights, 1.0f / 127, 0, 0);
+}
+
+
+/**
+ * @brief Time on the monotonic clock
+ *
+ * @return seconds
+ */
+static double get_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+/**
+ * @brief Check that a saved and loaded model gives the same scores, and time the inference
+ *
+ * @param[in] config The configuration
+ * @param[in] model The model
+ * @param[in] name Name printed for the model
+ * @param[in] vectors VECTOR_COUNT feature vectors
+ * @return false if the loaded model gives other scores
+ */
+static bool bench_model(const bench_configuration_t *config, const model_t *model, const char *name,
+                        float vectors[][MODEL_FEATURE_COUNT])
+{
+	char    file_name[] = "/tmp/parking-model-XXXXXX";
+	int     fd          = mkstemp(file_name);
+	model_t *loaded     = NULL;
+	int     cars        = 0;
+
+	if (fd >= 0)
+	{
+		close(fd);
+		loaded = model_save(model, file_name) ? model_load(file_name) : NULL;
+		remove(file_name);
+	}
+
+	bool ok = loaded != NULL;
+
+	if (!ok)
+	{
+		fprintf(stderr, "Could not save and load %s\n", name);
+	}
+
+	for (int i = 0; i < VECTOR_COUNT && ok; i++)
+	{
+		float score = model_score(model, vectors[i]);
+
+		if (model_score(loaded, vectors[i]) != score)
+		{
+			fprintf(stderr, "Mismatch: %s vector %d: %f before saving, %f after loading\n", name, i, (double)score,
+			        (double)model_score(loaded, vectors[i]));
+			ok = false;
+		}
+	}
+
+	model_free(loaded);
+
+	double start = get_time();
+
+	for (int i = 0; i < config->inferences; i++)
+	{
+		cars += model_decide(model, vectors[i % VECTOR_COUNT]);
+	}
+
+	double elapsed = get_time() - start;
+
+	sink = cars;
+	printf("%-32s %10.1f %9.1f%%\n", name, elapsed * 1e9 / config->inferences, 100.0 * cars / config->inferences);
+
+	return ok;
+}
+
+
+/**
+ * @brief Time the computation of the features of a sweep
+ *
+ * @param[in] config The configuration
+ */
+static void bench_features(const bench_configuration_t *config)
+{
+	static uint16_t sweeps[2][MAX_LENGTH];
+
+	float    features[MODEL_FEATURE_COUNT];
+	uint32_t random = 4;
+	int      count  = config->inferences / 100 + 1;
+
+	for (int i = 0; i < config->length; i++)
+	{
+		sweeps[0][i] = NOISE_AMPLITUDE / 2 + next_random(&random) * NOISE_AMPLITUDE;
+		sweeps[1][i] = NOISE_AMPLITUDE / 2 + next_random(&random) * NOISE_AMPLITUDE;
+	}
+
+	double start = get_time();
+
+	for (int i = 0; i < count; i++)
+	{
+		const uint16_t *sweep = sweeps[i & 1];
+		Datapoint      peak   = get_max_peak_u16(sweep, config->length, START_RANGE, END_RANGE);
+
+		model_features(features, peak, sweep, sweeps[(i + 1) & 1], config->length);
+		sink = features[MODEL_FEATURE_TEMPORAL_VARIANCE];
+	}
+
+	double elapsed = get_time() - start;
+	char   name[64];
+
+	snprintf(name, sizeof(name), "features of %d samples", config->length);
+	printf("%-32s %10.1f\n", name, elapsed * 1e9 / count);
+}
+
+
+int main(int argc, char *argv[])
+{
+	static float vectors[VECTOR_COUNT][MODEL_FEATURE_COUNT];
+
+	bench_configuration_t config;
+	bool                  ok = true;
+	char                  name[64];
+
+	parse_options(argc, argv, &config);
+	generate_vectors(vectors);
+
+	printf("%d inferences per model\n", config.inferences);
+	printf("%-32s %10s %10s\n", "model", "ns", "cars");
+
+	if (config.model_file_name != NULL)
+	{
+		model_t *model = model_load(config.model_file_name);
+
+		if (model == NULL)
+		{
+			fprintf(stderr, "Could not load the model %s\n", config.model_file_name);
+			return EXIT_FAILURE;
+		}
+
+		snprintf(name, sizeof(name), "%s %s", MODEL_KIND_NAMES[model_kind(model)], config.model_file_name);
+		ok = bench_model(&config, model, name, vectors);
+		model_free(model);
+	}
+	else
+	{
+		model_t *trees  = generate_trees(&config, vectors);
+		model_t *linear = generate_linear();
+
+		if (trees == NULL || linear == NULL)
+		{
+			fprintf(stderr, "Could not create the models\n");
+			return EXIT_FAILURE;
+		}
+
+		snprintf(name, sizeof(name), "trees %d x depth %d", config.trees, config.depth);
+		ok = bench_model(&config, trees, name, vectors);
+		ok = bench_model(&config, linear, "linear", vectors) && ok;
+
+		if (config.output_file_name != NULL && !model_save(trees, config.output_file_name))
+		{
+			fprintf(stderr, "Could not save the model to %s\n", config.output_file_name);
+			ok = false;
+		}
+
+		model_free(trees);
+		model_free(linear);
+	}
+
+	bench_features(&config);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
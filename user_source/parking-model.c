@@ -0,0 +1,530 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parking-model.h"
+
+
+#define HEADER_SIZE      (24)
+#define TREES_SIZE       (8)
+#define NODE_SIZE        (5)
+#define LINEAR_SIZE      (4)
+#define COEFFICIENT_SIZE (9)
+#define MAX_FILE_SIZE    (HEADER_SIZE + TREES_SIZE + MODEL_MAX_TREES * ((1 << MODEL_MAX_DEPTH) * (NODE_SIZE + 4)))
+
+static const char MODEL_MAGIC[8] = {'P', 'A', 'R', 'K', 'M', 'D', 'L', '1'};
+
+const char *MODEL_FEATURE_NAMES[] = {"peak_amp", "peak_dist", "energy", "noise_floor", "temporal_variance"};
+
+const char *MODEL_KIND_NAMES[] = {"trees", "linear"};
+
+/* split node, 8 bytes so a cache line holds 8 nodes of the top of a tree */
+typedef struct
+{
+	float    split;
+	uint32_t feature;
+} model_node_t;
+
+struct model
+{
+	model_kind_t  kind;
+	unsigned int  feature_count;
+	float         bias;
+	float         threshold;
+	unsigned int  tree_count;
+	unsigned int  depth;
+	model_node_t  *nodes;
+	float         *leaves;
+	float         weight_scale;
+	float         offsets[MODEL_FEATURE_COUNT];
+	float         scales[MODEL_FEATURE_COUNT];
+	int8_t        weights[MODEL_FEATURE_COUNT];
+	float         coefficients[MODEL_FEATURE_COUNT];
+	float         intercept;
+};
+
+
+/**
+ * @brief Read an unsigned little endian integer
+ *
+ * @param[in] bytes Input bytes
+ * @param[in] size Number of bytes
+ * @return the value
+ */
+static uint32_t get_le(const uint8_t *bytes, size_t size)
+{
+	uint32_t value = 0;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		value |= (uint32_t)bytes[i] << (8 * i);
+	}
+
+	return value;
+}
+
+
+/**
+ * @brief Read a little endian float
+ *
+ * @param[in] bytes Input bytes
+ * @return the value
+ */
+static float get_f32(const uint8_t *bytes)
+{
+	uint32_t bits = get_le(bytes, 4);
+	float    value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+/**
+ * @brief Write an unsigned little endian integer
+ *
+ * @param[in] file Output file
+ * @param[in] value The value
+ * @param[in] size Number of bytes
+ * @return false if writing failed
+ */
+static bool write_le(FILE *file, uint32_t value, size_t size)
+{
+	uint8_t bytes[4];
+
+	for (size_t i = 0; i < size; i++)
+	{
+		bytes[i] = (uint8_t)(value >> (8 * i));
+	}
+
+	return fwrite(bytes, 1, size, file) == size;
+}
+
+
+/**
+ * @brief Write a little endian float
+ *
+ * @param[in] file Output file
+ * @param[in] value The value
+ * @return false if writing failed
+ */
+static bool write_f32(FILE *file, float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return write_le(file, bits, 4);
+}
+
+
+/**
+ * @brief Fold the quantised weights, offsets and scales of a linear model into one float
+ * coefficient per feature and a constant
+ *
+ * @param[in,out] model The model
+ */
+static void fold_linear(model_t *model)
+{
+	model->intercept = model->bias;
+
+	for (unsigned int i = 0; i < model->feature_count; i++)
+	{
+		model->coefficients[i] = model->weight_scale * model->weights[i] * model->scales[i];
+		model->intercept      -= model->coefficients[i] * model->offsets[i];
+	}
+}
+
+
+void model_features(float *features, Datapoint peak, const uint16_t *sweep, const uint16_t *previous, int length)
+{
+	float  average  = (length > 0) ? get_average_amplitude_u16(sweep, length) : 0;
+	double square   = 0;
+	double below    = 0;
+	double variance = 0;
+	int    count    = 0;
+
+	for (int i = 0; i < length; i++)
+	{
+		square += (double)sweep[i] * sweep[i];
+		if (sweep[i] < average)
+		{
+			below += sweep[i];
+			count++;
+		}
+	}
+
+	if (previous != NULL)
+	{
+		for (int i = 0; i < length; i++)
+		{
+			double step = (double)sweep[i] - previous[i];
+
+			variance += step * step;
+		}
+	}
+
+	features[MODEL_FEATURE_PEAK_AMP]          = peak.amp;
+	features[MODEL_FEATURE_PEAK_DIST]         = peak.dist;
+	features[MODEL_FEATURE_ENERGY]            = (length > 0) ? square / length : 0;
+	features[MODEL_FEATURE_NOISE_FLOOR]       = (count > 0) ? below / count : average;
+	features[MODEL_FEATURE_TEMPORAL_VARIANCE] = (length > 0) ? variance / length : 0;
+}
+
+
+model_t *model_create_trees(unsigned int feature_count, unsigned int tree_count, unsigned int depth, float bias, float threshold)
+{
+	if (feature_count < 1 || feature_count > MODEL_FEATURE_COUNT || tree_count < 1 || tree_count > MODEL_MAX_TREES ||
+	    depth < 1 || depth > MODEL_MAX_DEPTH)
+	{
+		return NULL;
+	}
+
+	model_t      *model = calloc(1, sizeof(*model));
+	unsigned int leaves = 1u << depth;
+
+	if (model == NULL)
+	{
+		return NULL;
+	}
+
+	model->kind          = MODEL_TREES;
+	model->feature_count = feature_count;
+	model->bias          = bias;
+	model->threshold     = threshold;
+	model->tree_count    = tree_count;
+	model->depth         = depth;
+	model->nodes         = malloc(tree_count * (leaves - 1) * sizeof(*model->nodes));
+	model->leaves        = calloc(tree_count * leaves, sizeof(*model->leaves));
+
+	if (model->nodes == NULL || model->leaves == NULL)
+	{
+		model_free(model);
+		return NULL;
+	}
+
+	for (unsigned int i = 0; i < tree_count * (leaves - 1); i++)
+	{
+		model->nodes[i].split   = INFINITY;
+		model->nodes[i].feature = 0;
+	}
+
+	return model;
+}
+
+
+void model_set_node(model_t *model, unsigned int tree, unsigned int node, unsigned int feature, float split)
+{
+	model_node_t *target = &model->nodes[tree * ((1u << model->depth) - 1) + node];
+
+	target->feature = feature;
+	target->split   = split;
+}
+
+
+void model_set_leaf(model_t *model, unsigned int tree, unsigned int leaf, float value)
+{
+	model->leaves[tree * (1u << model->depth) + leaf] = value;
+}
+
+
+model_t *model_create_linear(unsigned int feature_count, const float *offsets, const float *scales, const int8_t *weights,
+                             float weight_scale, float bias, float threshold)
+{
+	if (feature_count < 1 || feature_count > MODEL_FEATURE_COUNT)
+	{
+		return NULL;
+	}
+
+	model_t *model = calloc(1, sizeof(*model));
+
+	if (model == NULL)
+	{
+		return NULL;
+	}
+
+	model->kind          = MODEL_LINEAR;
+	model->feature_count = feature_count;
+	model->bias          = bias;
+	model->threshold     = threshold;
+	model->weight_scale  = weight_scale;
+
+	memcpy(model->offsets, offsets, feature_count * sizeof(*offsets));
+	memcpy(model->scales, scales, feature_count * sizeof(*scales));
+	memcpy(model->weights, weights, feature_count * sizeof(*weights));
+	fold_linear(model);
+
+	return model;
+}
+
+
+/**
+ * @brief Parse the trees of a model file
+ *
+ * @param[in] data Contents of the file after the header
+ * @param[in] size Size of the data
+ * @param[in] feature_count Number of features used
+ * @param[in] bias Added to the score
+ * @param[in] threshold Car if the score is above it
+ * @return the model, or NULL if the data is not valid
+ */
+static model_t *parse_trees(const uint8_t *data, size_t size, unsigned int feature_count, float bias, float threshold)
+{
+	if (size < TREES_SIZE)
+	{
+		return NULL;
+	}
+
+	unsigned int tree_count = get_le(data, 4);
+	unsigned int depth      = get_le(data + 4, 4);
+	model_t      *model     = model_create_trees(feature_count, tree_count, depth, bias, threshold);
+
+	if (model == NULL)
+	{
+		return NULL;
+	}
+
+	unsigned int leaves = 1u << depth;
+
+	if (size != TREES_SIZE + (size_t)tree_count * ((leaves - 1) * NODE_SIZE + leaves * 4))
+	{
+		model_free(model);
+		return NULL;
+	}
+
+	data += TREES_SIZE;
+	for (unsigned int tree = 0; tree < tree_count; tree++)
+	{
+		for (unsigned int node = 0; node < leaves - 1; node++, data += NODE_SIZE)
+		{
+			if (data[0] >= feature_count)
+			{
+				model_free(model);
+				return NULL;
+			}
+
+			model_set_node(model, tree, node, data[0], get_f32(data + 1));
+		}
+
+		for (unsigned int leaf = 0; leaf < leaves; leaf++, data += 4)
+		{
+			model_set_leaf(model, tree, leaf, get_f32(data));
+		}
+	}
+
+	return model;
+}
+
+
+/**
+ * @brief Parse the coefficients of a linear model file
+ *
+ * @param[in] data Contents of the file after the header
+ * @param[in] size Size of the data
+ * @param[in] feature_count Number of features used
+ * @param[in] bias Added to the score
+ * @param[in] threshold Car if the score is above it
+ * @return the model, or NULL if the data is not valid
+ */
+static model_t *parse_linear(const uint8_t *data, size_t size, unsigned int feature_count, float bias, float threshold)
+{
+	float  offsets[MODEL_FEATURE_COUNT];
+	float  scales[MODEL_FEATURE_COUNT];
+	int8_t weights[MODEL_FEATURE_COUNT];
+
+	if (feature_count < 1 || feature_count > MODEL_FEATURE_COUNT || size != LINEAR_SIZE + feature_count * COEFFICIENT_SIZE)
+	{
+		return NULL;
+	}
+
+	for (unsigned int i = 0; i < feature_count; i++)
+	{
+		const uint8_t *coefficient = data + LINEAR_SIZE + i * COEFFICIENT_SIZE;
+
+		offsets[i] = get_f32(coefficient);
+		scales[i]  = get_f32(coefficient + 4);
+		weights[i] = (int8_t)coefficient[8];
+	}
+
+	return model_create_linear(feature_count, offsets, scales, weights, get_f32(data), bias, threshold);
+}
+
+
+model_t *model_load(const char *file_name)
+{
+	FILE    *fin = fopen(file_name, "rb");
+	uint8_t *data;
+	size_t  size;
+	model_t *model = NULL;
+
+	if (fin == NULL)
+	{
+		return NULL;
+	}
+
+	data = malloc(MAX_FILE_SIZE + 1);
+	if (data == NULL)
+	{
+		fclose(fin);
+		return NULL;
+	}
+
+	size = fread(data, 1, MAX_FILE_SIZE + 1, fin);
+	fclose(fin);
+
+	if (size >= HEADER_SIZE && size <= MAX_FILE_SIZE && memcmp(data, MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0)
+	{
+		unsigned int kind          = get_le(data + 8, 4);
+		unsigned int feature_count = get_le(data + 12, 4);
+		float        bias          = get_f32(data + 16);
+		float        threshold     = get_f32(data + 20);
+
+		if (kind == MODEL_TREES)
+		{
+			model = parse_trees(data + HEADER_SIZE, size - HEADER_SIZE, feature_count, bias, threshold);
+		}
+		else if (kind == MODEL_LINEAR)
+		{
+			model = parse_linear(data + HEADER_SIZE, size - HEADER_SIZE, feature_count, bias, threshold);
+		}
+	}
+
+	free(data);
+	return model;
+}
+
+
+bool model_save(const model_t *model, const char *file_name)
+{
+	FILE *fout = fopen(file_name, "wb");
+	bool ok;
+
+	if (fout == NULL)
+	{
+		return false;
+	}
+
+	ok = fwrite(MODEL_MAGIC, 1, sizeof(MODEL_MAGIC), fout) == sizeof(MODEL_MAGIC) && write_le(fout, model->kind, 4) &&
+	     write_le(fout, model->feature_count, 4) && write_f32(fout, model->bias) && write_f32(fout, model->threshold);
+
+	if (model->kind == MODEL_TREES)
+	{
+		unsigned int leaves = 1u << model->depth;
+
+		ok = ok && write_le(fout, model->tree_count, 4) && write_le(fout, model->depth, 4);
+		for (unsigned int tree = 0; tree < model->tree_count && ok; tree++)
+		{
+			const model_node_t *nodes = &model->nodes[tree * (leaves - 1)];
+
+			for (unsigned int node = 0; node < leaves - 1 && ok; node++)
+			{
+				ok = write_le(fout, nodes[node].feature, 1) && write_f32(fout, nodes[node].split);
+			}
+
+			for (unsigned int leaf = 0; leaf < leaves && ok; leaf++)
+			{
+				ok = write_f32(fout, model->leaves[tree * leaves + leaf]);
+			}
+		}
+	}
+	else
+	{
+		ok = ok && write_f32(fout, model->weight_scale);
+		for (unsigned int i = 0; i < model->feature_count && ok; i++)
+		{
+			ok = write_f32(fout, model->offsets[i]) && write_f32(fout, model->scales[i]) &&
+			     write_le(fout, (uint8_t)model->weights[i], 1);
+		}
+	}
+
+	return (fclose(fout) == 0) && ok;
+}
+
+
+void model_free(model_t *model)
+{
+	if (model != NULL)
+	{
+		free(model->nodes);
+		free(model->leaves);
+		free(model);
+	}
+}
+
+
+model_kind_t model_kind(const model_t *model)
+{
+	return model->kind;
+}
+
+
+float model_score(const model_t *model, const float *features)
+{
+	if (model->kind == MODEL_LINEAR)
+	{
+		float score = model->intercept;
+
+		for (unsigned int i = 0; i < model->feature_count; i++)
+		{
+			score += model->coefficients[i] * features[i];
+		}
+
+		return score;
+	}
+
+	const model_node_t *nodes  = model->nodes;
+	const float        *leaves = model->leaves;
+	unsigned int       inner   = (1u << model->depth) - 1;
+	unsigned int       tree    = 0;
+	float              score   = model->bias;
+
+	//every tree is complete, so a path is depth comparisons without data dependent branches,
+	//and four trees are walked at once so their node loads overlap
+	for (; tree + 4 <= model->tree_count; tree += 4)
+	{
+		unsigned int node[4] = {0, 0, 0, 0};
+
+		for (unsigned int level = 0; level < model->depth; level++)
+		{
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				const model_node_t *split = &nodes[i * inner + node[i]];
+
+				node[i] = 2 * node[i] + 1 + (features[split->feature] > split->split);
+			}
+		}
+
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			score += leaves[i * (inner + 1) + node[i] - inner];
+		}
+
+		nodes  += 4 * inner;
+		leaves += 4 * (inner + 1);
+	}
+
+	for (; tree < model->tree_count; tree++)
+	{
+		unsigned int node = 0;
+
+		for (unsigned int level = 0; level < model->depth; level++)
+		{
+			node = 2 * node + 1 + (features[nodes[node].feature] > nodes[node].split);
+		}
+
+		score  += leaves[node - inner];
+		nodes  += inner;
+		leaves += inner + 1;
+	}
+
+	return score;
+}
+
+
+int model_decide(const model_t *model, const float *features)
+{
+	return model_score(model, features) > model->threshold;
+}
@@ -0,0 +1,196 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_MODEL_H_
+#define PARKING_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parking-detector.h"
+
+
+#define MODEL_MAX_TREES (256)
+#define MODEL_MAX_DEPTH (10)
+
+
+/*
+ * Learned detectors replacing the fixed rule of car_present().
+ *
+ * A model computes a score from the feature vector of a sweep and decides there is a car if
+ * the score is above the threshold of the model. The features are the ones written by
+ * ref-app-parking-features, so models trained on its feature files can be deployed as they
+ * are.
+ *
+ * Model files are little endian:
+ *
+ *   "PARKMDL1"       magic
+ *   u32              kind, MODEL_TREES or MODEL_LINEAR
+ *   u32              number of features used, the first ones of model_feature_t
+ *   f32              bias, added to the score
+ *   f32              threshold, car if the score is above it
+ *
+ * followed for MODEL_TREES by
+ *
+ *   u32              number of trees, at most MODEL_MAX_TREES
+ *   u32              depth of every tree, at most MODEL_MAX_DEPTH
+ *
+ * and for every tree its 2^depth - 1 split nodes in breadth first order, each a u8 feature and
+ * an f32 split value, then its 2^depth f32 leaf values. A feature above the split value goes to
+ * the right child, anything else including NaN to the left one. Shallower branches are padded
+ * by the model compiler with splits at +inf and repeated leaves. The score is the bias plus the
+ * sum of the leaves reached in all trees.
+ *
+ * For MODEL_LINEAR the header is followed by
+ *
+ *   f32              weight scale
+ *
+ * and for every feature an f32 offset, an f32 scale and an i8 weight. The score is the bias
+ * plus the weight scale times the sum of weight * (feature - offset) * scale.
+ */
+typedef enum
+{
+	MODEL_FEATURE_PEAK_AMP,
+	MODEL_FEATURE_PEAK_DIST,
+	MODEL_FEATURE_ENERGY,
+	MODEL_FEATURE_NOISE_FLOOR,
+	MODEL_FEATURE_TEMPORAL_VARIANCE,
+	MODEL_FEATURE_COUNT
+} model_feature_t;
+
+extern const char *MODEL_FEATURE_NAMES[];
+
+typedef enum
+{
+	MODEL_TREES,
+	MODEL_LINEAR,
+	MODEL_KIND_COUNT
+} model_kind_t;
+
+extern const char *MODEL_KIND_NAMES[];
+
+typedef struct model model_t;
+
+
+/**
+ * @brief Compute the feature vector of a sweep
+ *
+ * @param[out] features MODEL_FEATURE_COUNT features
+ * @param[in]  peak Peak of the sweep found by the detection pipeline
+ * @param[in]  sweep The raw sweep
+ * @param[in]  previous The previous sweep of the same sensor with the same length, or NULL
+ * @param[in]  length Length of the sweep
+ */
+void model_features(float *features, Datapoint peak, const uint16_t *sweep, const uint16_t *previous, int length);
+
+
+/**
+ * @brief Load a model
+ *
+ * @param[in] file_name Name of the model file
+ * @return the model, or NULL if the file could not be read or is not a valid model
+ */
+model_t *model_load(const char *file_name);
+
+
+/**
+ * @brief Save a model
+ *
+ * @param[in] model The model
+ * @param[in] file_name Name of the model file
+ * @return false if the file could not be written
+ */
+bool model_save(const model_t *model, const char *file_name);
+
+
+/**
+ * @brief Create a tree ensemble with all splits at +inf and all leaves 0, to be filled in with
+ * model_set_node() and model_set_leaf()
+ *
+ * @param[in] feature_count Number of features used
+ * @param[in] tree_count Number of trees
+ * @param[in] depth Depth of every tree
+ * @param[in] bias Added to the score
+ * @param[in] threshold Car if the score is above it
+ * @return the model, or NULL if the size is not supported
+ */
+model_t *model_create_trees(unsigned int feature_count, unsigned int tree_count, unsigned int depth, float bias, float threshold);
+
+
+/**
+ * @brief Set a split node of a tree ensemble
+ *
+ * @param[in,out] model The model
+ * @param[in]     tree Index of the tree
+ * @param[in]     node Index of the node in breadth first order
+ * @param[in]     feature Feature compared at the node
+ * @param[in]     split Split value
+ */
+void model_set_node(model_t *model, unsigned int tree, unsigned int node, unsigned int feature, float split);
+
+
+/**
+ * @brief Set a leaf of a tree ensemble
+ *
+ * @param[in,out] model The model
+ * @param[in]     tree Index of the tree
+ * @param[in]     leaf Index of the leaf, left to right
+ * @param[in]     value Leaf value
+ */
+void model_set_leaf(model_t *model, unsigned int tree, unsigned int leaf, float value);
+
+
+/**
+ * @brief Create a quantised linear model
+ *
+ * @param[in] feature_count Number of features used
+ * @param[in] offsets Offset of every feature
+ * @param[in] scales Scale of every feature
+ * @param[in] weights Weight of every feature
+ * @param[in] weight_scale Scale of the weights
+ * @param[in] bias Added to the score
+ * @param[in] threshold Car if the score is above it
+ * @return the model, or NULL if the size is not supported
+ */
+model_t *model_create_linear(unsigned int feature_count, const float *offsets, const float *scales, const int8_t *weights,
+                             float weight_scale, float bias, float threshold);
+
+
+/**
+ * @brief Free a model
+ *
+ * @param[in] model The model, may be NULL
+ */
+void model_free(model_t *model);
+
+
+/**
+ * @brief Kind of a model
+ *
+ * @param[in] model The model
+ * @return the kind
+ */
+model_kind_t model_kind(const model_t *model);
+
+
+/**
+ * @brief Score of a feature vector
+ *
+ * @param[in] model The model
+ * @param[in] features MODEL_FEATURE_COUNT features, see model_features()
+ * @return the score
+ */
+float model_score(const model_t *model, const float *features);
+
+
+/**
+ * @brief Decide if there is a car
+ *
+ * @param[in] model The model
+ * @param[in] features MODEL_FEATURE_COUNT features, see model_features()
+ * @return 1 if there is a car, 0 otherwise
+ */
+int model_decide(const model_t *model, const float *features);
+
+
+#endif
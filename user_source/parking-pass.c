@@ -0,0 +1,56 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include "parking-pass.h"
+
+
+void pass_init(pass_counter_t *counter, float threshold, float hysteresis, uint32_t enter_sweeps, double gap)
+{
+	counter->enter_amp    = threshold;
+	counter->exit_amp     = threshold * hysteresis;
+	counter->enter_sweeps = (enter_sweeps > 0) ? enter_sweeps : 1;
+	counter->gap          = gap;
+	counter->present      = false;
+	counter->run          = 0;
+	counter->edge_time    = 0;
+	counter->enter_time   = 0;
+	counter->passes       = 0;
+}
+
+
+pass_event_t pass_update(pass_counter_t *counter, float amp, double time)
+{
+	//a sweep on the same side of the threshold as the current state breaks the run
+	bool crossed = counter->present ? amp < counter->exit_amp : amp >= counter->enter_amp;
+
+	if (!crossed)
+	{
+		counter->run = 0;
+		return PASS_NONE;
+	}
+
+	if (counter->run == 0)
+	{
+		counter->edge_time = time;
+	}
+
+	counter->run++;
+
+	if (!counter->present && counter->run >= counter->enter_sweeps)
+	{
+		counter->present    = true;
+		counter->run        = 0;
+		counter->enter_time = counter->edge_time;
+		counter->passes++;
+		return PASS_ENTER;
+	}
+
+	if (counter->present && time - counter->edge_time >= counter->gap)
+	{
+		counter->present = false;
+		counter->run     = 0;
+		return PASS_EXIT;
+	}
+
+	return PASS_NONE;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_PASS_H_
+#define PARKING_PASS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Counting of vehicles passing under a sensor in an entrance or exit lane.
+ *
+ * The peak amplitude of every streamed sweep is compared with the detection threshold. A pass
+ * starts when enter_sweeps sweeps in a row are at or above the threshold, so a single noisy
+ * sweep is not counted, and it is counted at once to keep the latency at a few sweeps. It ends
+ * when the sweeps have been below the exit threshold, which is lower than the detection
+ * threshold, for the minimum gap, so the dips between the axles or under a high trailer do
+ * not split one vehicle into several passes. The gap is measured in time rather than sweeps,
+ * so dropped sweeps do not shorten it.
+ */
+typedef enum
+{
+	PASS_NONE,
+	PASS_ENTER,
+	PASS_EXIT
+} pass_event_t;
+
+typedef struct
+{
+	float    enter_amp;
+	float    exit_amp;
+	uint32_t enter_sweeps;
+	double   gap;
+	bool     present;
+	uint32_t run;
+	double   edge_time;
+	double   enter_time;
+	uint64_t passes;
+} pass_counter_t;
+
+
+/**
+ * @brief Initialize the counter with no vehicle under the sensor
+ *
+ * @param[out] counter The counter
+ * @param[in]  threshold Peak amplitude a vehicle reaches
+ * @param[in]  hysteresis Exit threshold as share of the threshold, 0.0 - 1.0
+ * @param[in]  enter_sweeps Sweeps in a row at or above the threshold starting a pass
+ * @param[in]  gap Time below the exit threshold ending a pass [s]
+ */
+void pass_init(pass_counter_t *counter, float threshold, float hysteresis, uint32_t enter_sweeps, double gap);
+
+
+/**
+ * @brief Add the peak amplitude of the next sweep
+ *
+ * On PASS_ENTER and PASS_EXIT, edge_time is the time of the first sweep of the run of sweeps
+ * that caused the event, so the latency of the event is the current time minus edge_time.
+ *
+ * @param[in,out] counter The counter
+ * @param[in]     amp Peak amplitude of the sweep
+ * @param[in]     time Time the sweep was read [s]
+ * @return PASS_ENTER if a vehicle was counted, PASS_EXIT if it has left, otherwise PASS_NONE
+ */
+pass_event_t pass_update(pass_counter_t *counter, float amp, double time);
+
+
+#endif
@@ -0,0 +1,573 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "parking-detector.h"
+
+/*
+ * Benchmark of the detection pipelines.
+ *
+ * Every pipeline configuration is run on the same synthetic sweeps twice: staged, as one
+ * pass per stage over a Datapoint copy of the sweep, and fused, as the pipeline returned by
+ * select_pipeline(). The time per sweep of both is printed, and the benchmark fails if they
+ * do not give the same peak, threshold decision and sweep quality.
+ *
+ * The sample kernels of every sample type are checked first on the same sweeps, quantised to
+ * 8 bits for u8 and range compensated for f32, against format_data_<type>() followed by
+ * get_average_amplitude() and get_max_peak().
+ *
+ * Then the peak search and threshold test of many sensors with short sweeps is run once per
+ * sensor with get_max_peak_u16() and car_present(), once per sensor with the pipeline
+ * ref-app-parking uses without --batch-search, and across sensors with a sweep batch as with
+ * --batch-search, both including and excluding the time to gather the sweeps into the batch.
+ */
+
+/* default settings */
+
+static const int   DEFAULT_LENGTH      = 1000;
+static const int   DEFAULT_SWEEPS      = 20000;
+static const int   DEFAULT_SENSORS     = 32;
+static const int   DEFAULT_BINS        = 8;
+static const float START_RANGE         = 0.12;
+static const float END_RANGE           = 0.60;
+static const float RANGE_GAIN          = 2.0;
+static const int   NOISE_AMPLITUDE     = 200;
+static const int   PEAK_AMPLITUDE      = 3000;
+static const int   PEAK_WIDTH          = 40;
+static const float THRESHOLD           = 1700;
+
+#define MAX_LENGTH    (4096)
+#define SWEEP_COUNT   (64)
+
+typedef struct
+{
+	int length;
+	int sweeps;
+	int sensors;
+	int bins;
+} bench_configuration_t;
+
+/* sweeps and per sample tables shared by all runs */
+typedef struct
+{
+	uint16_t  sweeps[SWEEP_COUNT][MAX_LENGTH];
+	uint16_t  calibration[MAX_LENGTH];
+	float     noise_profile[MAX_LENGTH];
+	float     gain[MAX_LENGTH];
+	float     unit_gain[MAX_LENGTH];
+	Datapoint data[MAX_LENGTH];
+	Datapoint smoothed[MAX_LENGTH];
+	uint8_t   quantised[MAX_LENGTH];
+	float     compensated[MAX_LENGTH];
+} bench_data_t;
+
+static volatile float sink;
+
+
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-l, --length                  samples per sweep, at most %d, default %d\n", MAX_LENGTH, DEFAULT_LENGTH);
+	fprintf(stderr, "-n, --sweeps                  sweeps per configuration, default %d\n", DEFAULT_SWEEPS);
+	fprintf(stderr, "-s, --sensors                 sensors searched across, at most %d, default %d\n", SWEEP_BATCH_MAX_SENSORS,
+	        DEFAULT_SENSORS);
+	fprintf(stderr, "-b, --bins                    samples per sweep searched across sensors, at most %d, default %d\n",
+	        MAX_LENGTH, DEFAULT_BINS);
+}
+
+
+static void parse_options(int argc, char *argv[], bench_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"length",                  required_argument,    0,    'l'},
+		{"sweeps",                  required_argument,    0,    'n'},
+		{"sensors",                 required_argument,    0,    's'},
+		{"bins",                    required_argument,    0,    'b'},
+		{NULL,                      0,                    NULL, 0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	config->length = DEFAULT_LENGTH;
+	config->sweeps  = DEFAULT_SWEEPS;
+	config->sensors = DEFAULT_SENSORS;
+	config->bins    = DEFAULT_BINS;
+
+	while ((character_code = getopt_long(argc, argv, "l:n:s:b:h?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'l':
+			{
+				config->length = atoi(optarg);
+				break;
+			}
+
+			case 'n':
+			{
+				config->sweeps = atoi(optarg);
+				break;
+			}
+
+			case 's':
+			{
+				config->sensors = atoi(optarg);
+				break;
+			}
+
+			case 'b':
+			{
+				config->bins = atoi(optarg);
+				break;
+			}
+
+			case 'h':
+			case '?':
+			default:
+			{
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (config->length <= 0 || config->length > MAX_LENGTH || config->sweeps <= 0 || config->sensors <= 0 ||
+	    config->sensors > SWEEP_BATCH_MAX_SENSORS || config->bins <= 0 || config->bins > MAX_LENGTH)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Fill the sweeps with noise, a reflection and now and then a spike
+ *
+ * @param[out] data Benchmark data
+ * @param[in]  length Samples per sweep
+ */
+static void generate_sweeps(bench_data_t *data, int length)
+{
+	uint32_t random = 1;
+
+	for (int i = 0; i < length; i++)
+	{
+		data->calibration[i] = NOISE_AMPLITUDE;
+	}
+
+	for (int sweep = 0; sweep < SWEEP_COUNT; sweep++)
+	{
+		int peak = (sweep * 7919) % length;
+
+		for (int i = 0; i < length; i++)
+		{
+			int distance = abs(i - peak);
+
+			random                    = random * 1103515245 + 12345;
+			data->sweeps[sweep][i]    = NOISE_AMPLITUDE / 2 + (random >> 16) % NOISE_AMPLITUDE;
+			data->sweeps[sweep][i]   += (distance < PEAK_WIDTH) ? PEAK_AMPLITUDE * (PEAK_WIDTH - distance) / PEAK_WIDTH : 0;
+		}
+
+		if (sweep % 8 == 0)
+		{
+			data->sweeps[sweep][(peak + length / 2) % length] = UINT16_MAX;
+		}
+	}
+
+	resample_profile(data->calibration, length, START_RANGE, END_RANGE, data->noise_profile, length, START_RANGE, END_RANGE);
+	compute_gain_table(data->gain, length, START_RANGE, END_RANGE, RANGE_GAIN);
+	compute_gain_table(data->unit_gain, length, START_RANGE, END_RANGE, 0);
+}
+
+
+/**
+ * @brief Calculates the max peak after range gain and tests it against the threshold, as a
+ * pass of its own over a Datapoint copy of the sweep
+ *
+ * @param[in]  data Array of envelope data
+ * @param[in]  gain Range gain for every sample of data
+ * @param[in]  length The length of the envelope data array
+ * @param[in]  threshold Detection threshold, compared with the compensated amplitudes
+ * @param[out] present 1 if any compensated amplitude is above the threshold, otherwise 0
+ * @return a datapoint with max peak amplitude, after range gain, and distance.
+ */
+static Datapoint get_max_peak_gained(const Datapoint *data, const float *gain, int length, float threshold, int *present)
+{
+	Datapoint max;
+	int       above = 0;
+
+	max.amp  = -1;
+	max.dist = -1;
+
+	for (int i = 0; i < length; i++)
+	{
+		float amp = data[i].amp * gain[i];
+
+		above |= amp > threshold;
+		if (amp > max.amp)
+		{
+			max.amp  = amp;
+			max.dist = data[i].dist;
+		}
+	}
+
+	*present = above;
+	return max;
+}
+
+
+/**
+ * @brief Run one configuration as one pass per stage
+ *
+ * @param[in,out] data Benchmark data
+ * @param[in]     sweep Index of the sweep
+ * @param[in]     length Samples per sweep
+ * @param[in]     smooth Smoothing stage
+ * @param[in]     gain Gain stage
+ * @param[in]     check Interference check stage
+ * @param[out]    present Threshold decision
+ * @param[out]    quality Sweep quality
+ * @return the peak
+ */
+static Datapoint run_staged(bench_data_t *data, int sweep, int length, bool smooth, bool gain, bool check, int *present,
+                            sweep_quality_t *quality)
+{
+	const float *gain_table = gain ? data->gain : data->unit_gain;
+	Datapoint   *peak_data  = data->data;
+
+	format_data(data->data, data->sweeps[sweep], length, START_RANGE, END_RANGE);
+
+	if (smooth)
+	{
+		for (int i = 0; i < length; i++)
+		{
+			int left  = (i > 0) ? i - 1 : i;
+			int right = (i < length - 1) ? i + 1 : i;
+
+			data->smoothed[i].dist = data->data[i].dist;
+			data->smoothed[i].amp  = (data->data[left].amp + 2.0f * data->data[i].amp + data->data[right].amp) / 4;
+		}
+
+		peak_data = data->smoothed;
+	}
+
+	*quality = SWEEP_OK;
+	if (check)
+	{
+		//the check stage on its own, as the pipeline with no other stage
+		pipeline_context_t context = {START_RANGE, END_RANGE, data->unit_gain, data->noise_profile, THRESHOLD};
+		int                unused;
+
+		select_pipeline(false, false, true)(&context, data->sweeps[sweep], length, &unused, quality);
+	}
+
+	return get_max_peak_gained(peak_data, gain_table, length, THRESHOLD, present);
+}
+
+
+/**
+ * @brief Compare the average and peak of a sample kernel with the ones of its Datapoint copy
+ *
+ * The SIMD kernels sum in integers, so the averages may differ in the last bits.
+ *
+ * @param[in] name Sample type
+ * @param[in] data The Datapoint copy, from format_data_<type>()
+ * @param[in] length Samples per sweep
+ * @param[in] average Average from get_average_amplitude_<type>()
+ * @param[in] peak Peak from get_max_peak_<type>()
+ * @param[in] sweep Index of the sweep
+ * @return true if the kernel gives the same result
+ */
+static bool check_kernel(const char *name, Datapoint *data, int length, float average, Datapoint peak, int sweep)
+{
+	float     expected_average = get_average_amplitude(data, length);
+	Datapoint expected_peak    = get_max_peak(data, length);
+
+	if (fabsf(average - expected_average) > 1e-5f * expected_average || peak.amp != expected_peak.amp ||
+	    peak.dist != expected_peak.dist)
+	{
+		fprintf(stderr, "Mismatch: %s kernels sweep %d: average %f peak %f %f, expected %f %f %f\n", name, sweep,
+		        (double)average, (double)peak.amp, (double)peak.dist, (double)expected_average, (double)expected_peak.amp,
+		        (double)expected_peak.dist);
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Check the sample kernels of every sample type on the sweeps
+ *
+ * @param[in,out] data Benchmark data
+ * @param[in]     length Samples per sweep
+ * @return true if every kernel gives the same result as its Datapoint copy
+ */
+static bool check_sample_kernels(bench_data_t *data, int length)
+{
+	bool ok = true;
+
+	for (int sweep = 0; sweep < SWEEP_COUNT; sweep++)
+	{
+		const uint16_t *samples = data->sweeps[sweep];
+
+		for (int i = 0; i < length; i++)
+		{
+			data->quantised[i]   = (samples[i] >> 4 > UINT8_MAX) ? UINT8_MAX : samples[i] >> 4;
+			data->compensated[i] = samples[i] * data->gain[i];
+		}
+
+		format_data_u8(data->data, data->quantised, length, START_RANGE, END_RANGE);
+		ok &= check_kernel("u8", data->data, length, get_average_amplitude_u8(data->quantised, length),
+		                   get_max_peak_u8(data->quantised, length, START_RANGE, END_RANGE), sweep);
+
+		format_data_u16(data->data, samples, length, START_RANGE, END_RANGE);
+		ok &= check_kernel("u16", data->data, length, get_average_amplitude_u16(samples, length),
+		                   get_max_peak_u16(samples, length, START_RANGE, END_RANGE), sweep);
+
+		format_data_f32(data->data, data->compensated, length, START_RANGE, END_RANGE);
+		ok &= check_kernel("f32", data->data, length, get_average_amplitude_f32(data->compensated, length),
+		                   get_max_peak_f32(data->compensated, length, START_RANGE, END_RANGE), sweep);
+	}
+
+	return ok;
+}
+
+
+/**
+ * @brief Time on the monotonic clock
+ *
+ * @return seconds
+ */
+static double get_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+/**
+ * @brief Check that a peak and decision searched across sensors match the ones of a single sweep
+ *
+ * @param[in] name Name of the single sweep search
+ * @param[in] sensor The sensor
+ * @param[in] single_peak Peak of the single sweep search
+ * @param[in] single_present Decision of the single sweep search
+ * @param[in] batch_peak Peak searched across sensors
+ * @param[in] batch_present Decision searched across sensors
+ * @return false if they differ
+ */
+static bool check_batch_peak(const char *name, int sensor, Datapoint single_peak, int single_present, Datapoint batch_peak,
+                             int batch_present)
+{
+	if (single_peak.amp == batch_peak.amp && single_peak.dist == batch_peak.dist && single_present == batch_present)
+	{
+		return true;
+	}
+
+	fprintf(stderr, "Mismatch: sensor %d: %s %f %f %d, batch %f %f %d\n", sensor, name, (double)single_peak.amp,
+	        (double)single_peak.dist, single_present, (double)batch_peak.amp, (double)batch_peak.dist, batch_present);
+	return false;
+}
+
+
+/**
+ * @brief Compare the peak search per sensor with the peak search across sensors
+ *
+ * Sensor n uses the first bins samples of sweep n, with a threshold that about half of the
+ * sensors exceed. The search across sensors must give the peaks and decisions of both
+ * get_max_peak_u16() with car_present() and the pipeline without smoothing, range gain and
+ * interference check, which ref-app-parking uses for every sweep without --batch-search.
+ *
+ * @param[in] data Benchmark data
+ * @param[in] config The configuration
+ * @return false if they give different peaks or decisions
+ */
+static bool bench_batch(const bench_data_t *data, const bench_configuration_t *config)
+{
+	static sweep_batch_t batch;
+
+	Datapoint            single_peaks[SWEEP_BATCH_MAX_SENSORS];
+	Datapoint            pipeline_peaks[SWEEP_BATCH_MAX_SENSORS];
+	Datapoint            batch_peaks[SWEEP_BATCH_MAX_SENSORS];
+	int                  single_present[SWEEP_BATCH_MAX_SENSORS];
+	int                  pipeline_present[SWEEP_BATCH_MAX_SENSORS];
+	int                  batch_present[SWEEP_BATCH_MAX_SENSORS];
+	sweep_quality_t      quality;
+	float                threshold = NOISE_AMPLITUDE + PEAK_AMPLITUDE / 2;
+	detection_pipeline_t pipeline  = select_pipeline(false, false, false);
+	pipeline_context_t   context   = {START_RANGE, END_RANGE, NULL, NULL, get_detection_threshold(threshold / 4, 1)};
+	int                  rounds    = config->sweeps / config->sensors + 1;
+	bool                 ok        = true;
+	double               start;
+	double               single_time;
+	double               pipeline_time;
+	double               gather_time;
+	double               batch_time;
+
+	sweep_batch_clear(&batch);
+	for (int sensor = 0; sensor < config->sensors; sensor++)
+	{
+		const uint16_t *sweep = data->sweeps[sensor % SWEEP_COUNT];
+
+		single_peaks[sensor]   = get_max_peak_u16(sweep, config->bins, START_RANGE, END_RANGE);
+		single_present[sensor] = car_present(single_peaks[sensor].amp, threshold / 4, 1);
+		pipeline_peaks[sensor] = pipeline(&context, sweep, config->bins, &pipeline_present[sensor], &quality);
+		sweep_batch_add(&batch, sweep, config->bins, START_RANGE, END_RANGE, get_detection_threshold(threshold / 4, 1));
+	}
+
+	get_max_peaks_batch(&batch, batch_peaks, batch_present);
+
+	for (int sensor = 0; sensor < config->sensors; sensor++)
+	{
+		ok = check_batch_peak("single", sensor, single_peaks[sensor], single_present[sensor], batch_peaks[sensor],
+		                      batch_present[sensor]) && ok;
+		ok = check_batch_peak("pipeline", sensor, pipeline_peaks[sensor], pipeline_present[sensor], batch_peaks[sensor],
+		                      batch_present[sensor]) && ok;
+	}
+
+	start = get_time();
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int sensor = 0; sensor < config->sensors; sensor++)
+		{
+			Datapoint peak = get_max_peak_u16(data->sweeps[(sensor + round) % SWEEP_COUNT], config->bins, START_RANGE, END_RANGE);
+
+			single_present[sensor] = car_present(peak.amp, threshold / 4, 1);
+		}
+	}
+
+	single_time = get_time() - start;
+
+	start = get_time();
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int sensor = 0; sensor < config->sensors; sensor++)
+		{
+			pipeline(&context, data->sweeps[(sensor + round) % SWEEP_COUNT], config->bins, &pipeline_present[sensor], &quality);
+		}
+	}
+
+	pipeline_time = get_time() - start;
+
+	start = get_time();
+	for (int round = 0; round < rounds; round++)
+	{
+		sweep_batch_clear(&batch);
+		for (int sensor = 0; sensor < config->sensors; sensor++)
+		{
+			sweep_batch_add(&batch, data->sweeps[(sensor + round) % SWEEP_COUNT], config->bins, START_RANGE, END_RANGE,
+			                get_detection_threshold(threshold / 4, 1));
+		}
+
+		get_max_peaks_batch(&batch, batch_peaks, batch_present);
+	}
+
+	gather_time = get_time() - start;
+
+	start = get_time();
+	for (int round = 0; round < rounds; round++)
+	{
+		get_max_peaks_batch(&batch, batch_peaks, batch_present);
+	}
+
+	batch_time = get_time() - start;
+	sink       = single_present[0] + pipeline_present[0] + batch_present[0];
+
+	printf("\n%d sensors with %d samples per sweep\n", config->sensors, config->bins);
+	printf("%-24s %14s %8s\n", "", "per sweep [ns]", "speedup");
+	printf("%-24s %14.1f %8.2f\n", "per sensor", single_time * 1e9 / (rounds * config->sensors), 1.0);
+	printf("%-24s %14.1f %8.2f\n", "pipeline per sensor", pipeline_time * 1e9 / (rounds * config->sensors),
+	       single_time / pipeline_time);
+	printf("%-24s %14.1f %8.2f\n", "across sensors", batch_time * 1e9 / (rounds * config->sensors), single_time / batch_time);
+	printf("%-24s %14.1f %8.2f\n", "gather and search", gather_time * 1e9 / (rounds * config->sensors),
+	       single_time / gather_time);
+
+	return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+	static bench_data_t data;
+
+	bench_configuration_t config;
+	bool                  ok = true;
+
+	parse_options(argc, argv, &config);
+	generate_sweeps(&data, config.length);
+
+	ok = check_sample_kernels(&data, config.length);
+	printf("Sample kernels u8, u16 and f32: %s\n", ok ? "ok" : "mismatch");
+
+	printf("%d sweeps of %d samples per configuration\n", config.sweeps, config.length);
+	printf("%-8s %-6s %-8s %14s %14s %8s\n", "smooth", "gain", "check", "staged [ns]", "fused [ns]", "speedup");
+
+	for (int configuration = 0; configuration < 8; configuration++)
+	{
+		bool                 smooth   = configuration & 4;
+		bool                 gain     = configuration & 2;
+		bool                 check    = configuration & 1;
+		detection_pipeline_t pipeline = select_pipeline(smooth, gain, check);
+		pipeline_context_t   context  = {START_RANGE, END_RANGE, data.gain, data.noise_profile, THRESHOLD};
+		sweep_quality_t      staged_quality;
+		sweep_quality_t      fused_quality;
+		int                  staged_present;
+		int                  fused_present;
+		double               start;
+		double               staged_time;
+		double               fused_time;
+
+		for (int sweep = 0; sweep < SWEEP_COUNT; sweep++)
+		{
+			Datapoint staged = run_staged(&data, sweep, config.length, smooth, gain, check, &staged_present, &staged_quality);
+			Datapoint fused  = pipeline(&context, data.sweeps[sweep], config.length, &fused_present, &fused_quality);
+
+			if (staged.amp != fused.amp || staged.dist != fused.dist || staged_present != fused_present ||
+			    staged_quality != fused_quality)
+			{
+				fprintf(stderr, "Mismatch: smooth %d gain %d check %d sweep %d: staged %f %f %d %s, fused %f %f %d %s\n",
+				        smooth, gain, check, sweep, (double)staged.amp, (double)staged.dist, staged_present,
+				        SWEEP_QUALITY_NAMES[staged_quality], (double)fused.amp, (double)fused.dist, fused_present,
+				        SWEEP_QUALITY_NAMES[fused_quality]);
+				ok = false;
+			}
+		}
+
+		start = get_time();
+		for (int i = 0; i < config.sweeps; i++)
+		{
+			sink = run_staged(&data, i % SWEEP_COUNT, config.length, smooth, gain, check, &staged_present, &staged_quality).amp;
+		}
+
+		staged_time = get_time() - start;
+
+		start = get_time();
+		for (int i = 0; i < config.sweeps; i++)
+		{
+			sink = pipeline(&context, data.sweeps[i % SWEEP_COUNT], config.length, &fused_present, &fused_quality).amp;
+		}
+
+		fused_time = get_time() - start;
+
+		printf("%-8s %-6s %-8s %14.0f %14.0f %8.2f\n", smooth ? "yes" : "no", gain ? "yes" : "no", check ? "yes" : "no",
+		       staged_time * 1e9 / config.sweeps, fused_time * 1e9 / config.sweeps, staged_time / fused_time);
+	}
+
+	ok = bench_batch(&data, &config) && ok;
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,290 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parking-history.h"
+
+/*
+ * Query of an occupancy history written with ref-app-parking --history.
+ *
+ * Prints the state of the parking spot at the start of a time range, every change of the
+ * state in the range, one per line, and the share of the range the spot was occupied, empty
+ * or unknown. The start of the range is found through the index of the history, so only the
+ * pages holding the range are read however long the history is.
+ */
+
+/* default settings */
+
+static const uint64_t DEFAULT_TIME_FROM = 0;
+static const uint64_t DEFAULT_TIME_TO   = UINT64_MAX;
+
+static const char *STATE_NAMES[] = {"unknown", "empty", "occupied"};
+
+typedef struct
+{
+	const char *file_name;
+	uint64_t   time_from;
+	uint64_t   time_to;
+	bool       summary;
+	bool       verbose;
+} query_configuration_t;
+
+
+/**
+ * @brief Print usage information to stdout
+ *
+ * @param[in] program_name
+ */
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] -f <history>\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-f, --file                    occupancy history of one sensor\n");
+	fprintf(stderr, "-F, --from                    first time, milliseconds since the epoch or \"YYYY-MM-DD HH:MM:SS\" local time\n");
+	fprintf(stderr, "-T, --to                      last time, same format as --from, default now\n");
+	fprintf(stderr, "-S, --summary                 print only the share of the range the spot was occupied, empty and unknown\n");
+	fprintf(stderr, "-v, --verbose                 print the size of the history and the pages read by the query\n");
+}
+
+
+/**
+ * @brief Parse a time given in milliseconds since the epoch or as local date and time
+ *
+ * @param[in]  text The time
+ * @param[out] time_ms Milliseconds since the epoch
+ * @return false if the time cannot be parsed
+ */
+static bool parse_time(const char *text, uint64_t *time_ms)
+{
+	struct tm date = {0};
+	char      *end;
+	int       length = 0;
+
+	if (sscanf(text, "%d-%d-%d %d:%d:%d%n", &date.tm_year, &date.tm_mon, &date.tm_mday,
+	           &date.tm_hour, &date.tm_min, &date.tm_sec, &length) == 6 && text[length] == '\0')
+	{
+		date.tm_year -= 1900;
+		date.tm_mon  -= 1;
+		date.tm_isdst = -1;
+
+		time_t seconds = mktime(&date);
+
+		*time_ms = (uint64_t)seconds * 1000;
+		return seconds >= 0;
+	}
+
+	*time_ms = strtoull(text, &end, 10);
+	return end != text && *end == '\0';
+}
+
+
+/**
+ * @brief Parse command line options and update configuration struct
+ *
+ * @param[in]  argc Number of arguments passed to the main function
+ * @param[in]  argv Array with arguments passed to the main function
+ * @param[out] config configuration data to be updated
+ */
+static void parse_options(int argc, char *argv[], query_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"file",                    required_argument,    0,    'f'},
+		{"from",                    required_argument,    0,    'F'},
+		{"to",                      required_argument,    0,    'T'},
+		{"summary",                 no_argument,          0,    'S'},
+		{"verbose",                 no_argument,          0,    'v'},
+		{NULL,                      0,                    NULL,   0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	config->file_name = NULL;
+	config->time_from = DEFAULT_TIME_FROM;
+	config->time_to   = DEFAULT_TIME_TO;
+	config->summary   = false;
+	config->verbose   = false;
+
+	while ((character_code = getopt_long(argc, argv, "f:F:T:Svh?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'f':
+			{
+				config->file_name = optarg;
+				break;
+			}
+
+			case 'F':
+			case 'T':
+			{
+				uint64_t *time_ms = character_code == 'F' ? &config->time_from : &config->time_to;
+
+				if (!parse_time(optarg, time_ms))
+				{
+					fprintf(stderr, "Invalid time: %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+
+				break;
+			}
+
+			case 'S':
+			{
+				config->summary = true;
+				break;
+			}
+
+			case 'v':
+			{
+				config->verbose = true;
+				break;
+			}
+
+			case 'h':
+			case '?':
+			default:
+			{
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (config->file_name == NULL)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Print an error message and exit
+ *
+ * @param[in] message Error message
+ */
+static void handle_fatal_error(const char *message)
+{
+	fprintf(stderr, "Fatal error: %s\n", message);
+	exit(EXIT_FAILURE);
+}
+
+
+/**
+ * @brief Get the current time in milliseconds since the epoch
+ *
+ * @return the time
+ */
+static uint64_t get_time_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+
+/**
+ * @brief Print one state of the spot
+ *
+ * @param[in] entry The entry starting the state
+ */
+static void print_entry(const history_entry_t *entry)
+{
+	printf("%" PRIu64 " %d %s %.0f\n", entry->time_ms, entry->result, STATE_NAMES[entry->result + 1], (double)entry->peak_amp);
+}
+
+
+int main(int argc, char *argv[])
+{
+	query_configuration_t config;
+	history_t             *history;
+	history_entry_t       state;
+	history_entry_t       entry;
+	uint64_t              duration[3] = {0};
+	uint64_t              transitions = 0;
+	struct timespec       start;
+	struct timespec       end;
+
+	parse_options(argc, argv, &config);
+
+	history = history_open(config.file_name, false);
+	if (history == NULL)
+	{
+		handle_fatal_error("Could not open the occupancy history");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	uint64_t time_to   = (config.time_to == DEFAULT_TIME_TO) ? get_time_ms() : config.time_to;
+	uint64_t time      = config.time_from;
+	int      result;
+
+	if (!history_seek(history, config.time_from, &state))
+	{
+		handle_fatal_error("Could not read the occupancy history");
+	}
+
+	if (!config.summary)
+	{
+		print_entry(&state);
+	}
+
+	result = state.result;
+
+	//every state lasts until the next change or the end of the range
+	while (history_next(history, &entry) && entry.time_ms <= time_to)
+	{
+		duration[result + 1] += entry.time_ms - time;
+		time                  = entry.time_ms;
+		result                = entry.result;
+		transitions++;
+
+		if (!config.summary)
+		{
+			print_entry(&entry);
+		}
+	}
+
+	if (time_to > time)
+	{
+		duration[result + 1] += time_to - time;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	uint64_t total = duration[0] + duration[1] + duration[2];
+
+	if (total > 0)
+	{
+		printf("%.2f h, %" PRIu64 " changes: occupied %.1f %%, empty %.1f %%, unknown %.1f %%\n", total / 3600000.0, transitions,
+		       duration[2] * 100.0 / total, duration[1] * 100.0 / total, duration[0] * 100.0 / total);
+	}
+
+	if (config.verbose)
+	{
+		uint64_t entries;
+		uint64_t hours;
+		uint64_t pages;
+
+		history_size(history, &entries, &hours, &pages);
+		fprintf(stderr, "%" PRIu64 " entries in %" PRIu64 " hours, %" PRIu64 " pages read, %.3f ms\n", entries, hours, pages,
+		        (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+	}
+
+	history_close(history);
+
+	return EXIT_SUCCESS;
+}
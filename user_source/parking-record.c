@@ -0,0 +1,1284 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parking-record.h"
+
+
+#define RECORD_NAME_LENGTH   (14)
+#define RECORD_BUFFER_SIZE   (RECORD_CHUNK_SAMPLES * 3)
+#define FILE_HEADER_SIZE_V2  (12 + RECORD_COLUMN_COUNT * (2 + RECORD_NAME_LENGTH))
+#define SENSOR_HEADER_SIZE   (13)
+#define CHUNK_HEADER_SIZE    (36)
+#define CHUNK_HEADER_SIZE_V1 (12)
+#define COLUMN_HEADER_SIZE   (22)
+#define INDEX_HEADER_SIZE    (16)
+#define INDEX_ENTRY_SIZE     (36)
+#define INDEX_SUFFIX         ".idx"
+
+static const char FILE_MAGIC[8]  = {'P', 'A', 'R', 'K', 'C', 'O', 'L', '3'};
+static const char FILE_MAGIC_V2[8] = {'P', 'A', 'R', 'K', 'C', 'O', 'L', '2'};
+static const char FILE_MAGIC_V1[8] = {'P', 'A', 'R', 'K', 'C', 'O', 'L', '1'};
+static const char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+static const char INDEX_MAGIC[8] = {'P', 'A', 'R', 'K', 'I', 'D', 'X', '1'};
+
+const char *RECORD_COLUMN_NAMES[] = {"time", "sensor", "result", "peak_amp", "peak_dist", "sweep_length", "sweep"};
+
+const char *RECORD_MODE_NAMES[] = {"envelope", "power-bins"};
+
+static const record_encoding_t COLUMN_ENCODINGS[RECORD_COLUMN_COUNT] =
+{
+	RECORD_ENCODING_DELTA,
+	RECORD_ENCODING_VARINT,
+	RECORD_ENCODING_VARINT,
+	RECORD_ENCODING_XOR,
+	RECORD_ENCODING_XOR,
+	RECORD_ENCODING_VARINT,
+	RECORD_ENCODING_SWEEP
+};
+
+/* index entry of one chunk */
+typedef struct
+{
+	uint64_t offset;
+	uint64_t first_sequence;
+	uint32_t rows;
+	uint64_t time_min_ms;
+	uint64_t time_max_ms;
+} index_entry_t;
+
+/* the rows of one chunk, column by column */
+typedef struct
+{
+	uint32_t rows;
+	uint32_t samples;
+	uint64_t time_ms[RECORD_CHUNK_ROWS];
+	uint16_t sensor[RECORD_CHUNK_ROWS];
+	int8_t   result[RECORD_CHUNK_ROWS];
+	float    peak_amp[RECORD_CHUNK_ROWS];
+	float    peak_dist[RECORD_CHUNK_ROWS];
+	uint16_t sweep_length[RECORD_CHUNK_ROWS];
+	uint32_t sweep_start[RECORD_CHUNK_ROWS];
+	uint16_t sweep[RECORD_CHUNK_SAMPLES];
+} chunk_t;
+
+struct record_writer
+{
+	FILE     *file;
+	FILE     *index;
+	int      version;
+	uint64_t next_sequence;
+	chunk_t  chunk;
+	uint8_t  buffer[RECORD_BUFFER_SIZE];
+};
+
+struct record_reader
+{
+	FILE            *file;
+	int             version;
+	record_sensor_t sensors[RECORD_MAX_SENSORS];
+	uint32_t        sensor_count;
+	index_entry_t   *entries;
+	size_t          entry_count;
+	size_t          entry;
+	uint32_t        row;
+	bool            loaded;
+	chunk_t         chunk;
+	uint8_t         buffer[RECORD_BUFFER_SIZE];
+};
+
+
+/**
+ * @brief Encode an unsigned value as LEB128 varint
+ *
+ * @param[out] out Output buffer, at least 10 bytes
+ * @param[in]  value The value
+ * @return number of bytes written
+ */
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+	size_t length = 0;
+
+	while (value >= 0x80)
+	{
+		out[length++] = (uint8_t)(value | 0x80);
+		value       >>= 7;
+	}
+
+	out[length++] = (uint8_t)value;
+	return length;
+}
+
+
+/**
+ * @brief Decode a LEB128 varint
+ *
+ * @param[in,out] in Input position, advanced past the varint
+ * @param[in]     end End of the input
+ * @param[out]    value The value
+ * @return false if the varint runs past the end of the input
+ */
+static bool get_varint(const uint8_t **in, const uint8_t *end, uint64_t *value)
+{
+	*value = 0;
+
+	for (unsigned int shift = 0; *in < end && shift < 64; shift += 7)
+	{
+		uint8_t byte = *(*in)++;
+
+		*value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ * @brief Map a signed value to an unsigned one with small magnitudes giving small values
+ *
+ * @param[in] value The value
+ * @return zigzag encoded value
+ */
+static uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+
+/**
+ * @brief Inverse of zigzag
+ *
+ * @param[in] value Zigzag encoded value
+ * @return the signed value
+ */
+static int64_t unzigzag(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+/**
+ * @brief Bit pattern of a float
+ *
+ * @param[in] value The value
+ * @return IEEE 754 bits
+ */
+static uint32_t float_bits(float value)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+
+/**
+ * @brief Float with a bit pattern
+ *
+ * @param[in] bits IEEE 754 bits
+ * @return the value
+ */
+static float bits_float(uint32_t bits)
+{
+	float value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+/**
+ * @brief Write an unsigned little endian integer
+ *
+ * @param[in] file Output file
+ * @param[in] value The value
+ * @param[in] size Number of bytes
+ * @return false if writing failed
+ */
+static bool write_le(FILE *file, uint64_t value, size_t size)
+{
+	uint8_t bytes[8];
+
+	for (size_t i = 0; i < size; i++)
+	{
+		bytes[i] = (uint8_t)(value >> (8 * i));
+	}
+
+	return fwrite(bytes, 1, size, file) == size;
+}
+
+
+/**
+ * @brief Read an unsigned little endian integer
+ *
+ * @param[in] bytes Input bytes
+ * @param[in] size Number of bytes
+ * @return the value
+ */
+static uint64_t get_le(const uint8_t *bytes, size_t size)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		value |= (uint64_t)bytes[i] << (8 * i);
+	}
+
+	return value;
+}
+
+
+/**
+ * @brief Write a double as little endian IEEE 754 bits
+ *
+ * @param[in] file Output file
+ * @param[in] value The value
+ * @return false if writing failed
+ */
+static bool write_f64(FILE *file, double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return write_le(file, bits, sizeof(bits));
+}
+
+
+/**
+ * @brief Double with little endian IEEE 754 bits
+ *
+ * @param[in] bytes Input bytes
+ * @return the value
+ */
+static double get_f64(const uint8_t *bytes)
+{
+	uint64_t bits = get_le(bytes, sizeof(bits));
+	double   value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+/**
+ * @brief Size of an open file
+ *
+ * @param[in] file The file
+ * @return the size, or -1 on failure
+ */
+static off_t file_size(FILE *file)
+{
+	if (fseeko(file, 0, SEEK_END) != 0)
+	{
+		return -1;
+	}
+
+	return ftello(file);
+}
+
+
+/**
+ * @brief Write the file header
+ *
+ * @param[in] file Output file
+ * @param[in] sensors How the sweeps of every sensor are measured
+ * @param[in] sensor_count Number of sensors
+ * @return false if writing failed
+ */
+static bool write_header(FILE *file, const record_sensor_t *sensors, uint32_t sensor_count)
+{
+	bool ok = fwrite(FILE_MAGIC, 1, sizeof(FILE_MAGIC), file) == sizeof(FILE_MAGIC) && write_le(file, RECORD_COLUMN_COUNT, 4);
+
+	for (int column = 0; column < RECORD_COLUMN_COUNT && ok; column++)
+	{
+		char name[RECORD_NAME_LENGTH] = {0};
+
+		strncpy(name, RECORD_COLUMN_NAMES[column], RECORD_NAME_LENGTH - 1);
+		ok = write_le(file, column, 1) && write_le(file, COLUMN_ENCODINGS[column], 1) &&
+		     fwrite(name, 1, RECORD_NAME_LENGTH, file) == RECORD_NAME_LENGTH;
+	}
+
+	ok = ok && write_le(file, sensor_count, 4);
+
+	for (uint32_t i = 0; i < sensor_count && ok; i++)
+	{
+		ok = write_le(file, sensors[i].sensor, 2) && write_le(file, sensors[i].mode, 1) &&
+		     write_le(file, sensors[i].bin_count, 2) && write_le(file, float_bits(sensors[i].start), 4) &&
+		     write_le(file, float_bits(sensors[i].length), 4);
+	}
+
+	return ok;
+}
+
+
+/**
+ * @brief Read the file header
+ *
+ * Recordings of versions 1 and 2 have the same file header up to the columns, without the
+ * sensors. The chunk headers of version 1 only hold the magic, the row count and the column
+ * count.
+ *
+ * @param[in]  file Input file, positioned at the start
+ * @param[out] sensors How the sweeps of every sensor are measured, RECORD_MAX_SENSORS entries
+ * @param[out] sensor_count Number of sensors, 0 for versions 1 and 2
+ * @param[out] header_size Size of the file header, the offset of the first chunk
+ * @return the format version, 1 to 3, or 0 if the file is not a recording
+ */
+static int read_header(FILE *file, record_sensor_t *sensors, uint32_t *sensor_count, uint64_t *header_size)
+{
+	uint8_t header[sizeof(FILE_MAGIC) + 4];
+	uint8_t bytes[SENSOR_HEADER_SIZE];
+	int     version;
+
+	*sensor_count = 0;
+	*header_size  = FILE_HEADER_SIZE_V2;
+
+	if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+	    get_le(header + sizeof(FILE_MAGIC), 4) != RECORD_COLUMN_COUNT)
+	{
+		return 0;
+	}
+
+	version = memcmp(header, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0 ? 3 :
+	          memcmp(header, FILE_MAGIC_V2, sizeof(FILE_MAGIC_V2)) == 0 ? 2 :
+	          memcmp(header, FILE_MAGIC_V1, sizeof(FILE_MAGIC_V1)) == 0 ? 1 : 0;
+
+	if (version < 3)
+	{
+		return version;
+	}
+
+	if (fseeko(file, FILE_HEADER_SIZE_V2, SEEK_SET) != 0 || fread(bytes, 1, 4, file) != 4 ||
+	    (*sensor_count = (uint32_t)get_le(bytes, 4)) > RECORD_MAX_SENSORS)
+	{
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < *sensor_count; i++)
+	{
+		if (fread(bytes, 1, SENSOR_HEADER_SIZE, file) != SENSOR_HEADER_SIZE || bytes[2] >= RECORD_MODE_COUNT)
+		{
+			return 0;
+		}
+
+		sensors[i].sensor    = (uint16_t)get_le(bytes, 2);
+		sensors[i].mode      = bytes[2];
+		sensors[i].bin_count = (uint16_t)get_le(bytes + 3, 2);
+		sensors[i].start     = bits_float((uint32_t)get_le(bytes + 5, 4));
+		sensors[i].length    = bits_float((uint32_t)get_le(bytes + 9, 4));
+	}
+
+	*header_size = FILE_HEADER_SIZE_V2 + 4 + (uint64_t)*sensor_count * SENSOR_HEADER_SIZE;
+	return version;
+}
+
+
+/**
+ * @brief Size of the chunk headers of a format version
+ *
+ * @param[in] version The format version
+ * @return the size in bytes
+ */
+static uint64_t chunk_header_size(int version)
+{
+	return version == 1 ? CHUNK_HEADER_SIZE_V1 : CHUNK_HEADER_SIZE;
+}
+
+
+/**
+ * @brief Encode one column of a chunk
+ *
+ * @param[in]  chunk The chunk
+ * @param[in]  column The column
+ * @param[out] out Output buffer, RECORD_BUFFER_SIZE bytes
+ * @param[out] min Smallest value in the chunk
+ * @param[out] max Largest value in the chunk
+ * @return number of encoded bytes
+ */
+static size_t encode_column(const chunk_t *chunk, record_column_t column, uint8_t *out, double *min, double *max)
+{
+	size_t   length   = 0;
+	uint64_t previous = 0;
+	double   value    = 0;
+
+	*min = 0;
+	*max = 0;
+
+	if (column == RECORD_COLUMN_SWEEP)
+	{
+		uint32_t sample = 0;
+
+		for (uint32_t row = 0; row < chunk->rows; row++)
+		{
+			int32_t last = 0;
+
+			for (uint16_t i = 0; i < chunk->sweep_length[row]; i++, sample++)
+			{
+				int32_t current = chunk->sweep[sample];
+
+				length += put_varint(out + length, zigzag(current - last));
+				last    = current;
+
+				if (sample == 0 || current < *min)
+				{
+					*min = current;
+				}
+
+				if (sample == 0 || current > *max)
+				{
+					*max = current;
+				}
+			}
+		}
+
+		return length;
+	}
+
+	for (uint32_t row = 0; row < chunk->rows; row++)
+	{
+		switch (column)
+		{
+			case RECORD_COLUMN_TIME:
+				length  += put_varint(out + length, zigzag((int64_t)(chunk->time_ms[row] - previous)));
+				previous = chunk->time_ms[row];
+				value    = chunk->time_ms[row];
+				break;
+			case RECORD_COLUMN_SENSOR:
+				length += put_varint(out + length, chunk->sensor[row]);
+				value   = chunk->sensor[row];
+				break;
+			case RECORD_COLUMN_RESULT:
+				length += put_varint(out + length, zigzag(chunk->result[row]));
+				value   = chunk->result[row];
+				break;
+			case RECORD_COLUMN_PEAK_AMP:
+				length  += put_varint(out + length, float_bits(chunk->peak_amp[row]) ^ previous);
+				previous = float_bits(chunk->peak_amp[row]);
+				value    = chunk->peak_amp[row];
+				break;
+			case RECORD_COLUMN_PEAK_DIST:
+				length  += put_varint(out + length, float_bits(chunk->peak_dist[row]) ^ previous);
+				previous = float_bits(chunk->peak_dist[row]);
+				value    = chunk->peak_dist[row];
+				break;
+			case RECORD_COLUMN_SWEEP_LENGTH:
+			default:
+				length += put_varint(out + length, chunk->sweep_length[row]);
+				value   = chunk->sweep_length[row];
+				break;
+		}
+
+		if (row == 0 || value < *min)
+		{
+			*min = value;
+		}
+
+		if (row == 0 || value > *max)
+		{
+			*max = value;
+		}
+	}
+
+	return length;
+}
+
+
+/**
+ * @brief Decode one column into a chunk, the sweep column after the sweep lengths
+ *
+ * @param[in,out] chunk The chunk, with the row count set
+ * @param[in]     column The column
+ * @param[in]     in Encoded bytes
+ * @param[in]     length Number of encoded bytes
+ * @return false if the column is corrupt
+ */
+static bool decode_column(chunk_t *chunk, record_column_t column, const uint8_t *in, size_t length)
+{
+	const uint8_t *end     = in + length;
+	uint64_t      previous = 0;
+	uint64_t      value;
+
+	if (column == RECORD_COLUMN_SWEEP)
+	{
+		uint32_t sample = 0;
+
+		for (uint32_t row = 0; row < chunk->rows; row++)
+		{
+			int32_t last = 0;
+
+			if (sample + chunk->sweep_length[row] > RECORD_CHUNK_SAMPLES)
+			{
+				return false;
+			}
+
+			chunk->sweep_start[row] = sample;
+			for (uint16_t i = 0; i < chunk->sweep_length[row]; i++, sample++)
+			{
+				if (!get_varint(&in, end, &value))
+				{
+					return false;
+				}
+
+				last                 += (int32_t)unzigzag(value);
+				chunk->sweep[sample]  = (uint16_t)last;
+			}
+		}
+
+		chunk->samples = sample;
+		return in == end;
+	}
+
+	for (uint32_t row = 0; row < chunk->rows; row++)
+	{
+		if (!get_varint(&in, end, &value))
+		{
+			return false;
+		}
+
+		switch (column)
+		{
+			case RECORD_COLUMN_TIME:
+				previous           += (uint64_t)unzigzag(value);
+				chunk->time_ms[row] = previous;
+				break;
+			case RECORD_COLUMN_SENSOR:
+				chunk->sensor[row] = (uint16_t)value;
+				break;
+			case RECORD_COLUMN_RESULT:
+				chunk->result[row] = (int8_t)unzigzag(value);
+				break;
+			case RECORD_COLUMN_PEAK_AMP:
+				previous            ^= value;
+				chunk->peak_amp[row] = bits_float((uint32_t)previous);
+				break;
+			case RECORD_COLUMN_PEAK_DIST:
+				previous             ^= value;
+				chunk->peak_dist[row] = bits_float((uint32_t)previous);
+				break;
+			case RECORD_COLUMN_SWEEP_LENGTH:
+			default:
+				chunk->sweep_length[row] = (uint16_t)value;
+				break;
+		}
+	}
+
+	return in == end;
+}
+
+
+/**
+ * @brief Time range of the buffered rows
+ *
+ * @param[in]  chunk The chunk
+ * @param[out] min Smallest time
+ * @param[out] max Largest time
+ */
+static void chunk_time_range(const chunk_t *chunk, uint64_t *min, uint64_t *max)
+{
+	*min = chunk->time_ms[0];
+	*max = chunk->time_ms[0];
+
+	for (uint32_t row = 1; row < chunk->rows; row++)
+	{
+		if (chunk->time_ms[row] < *min)
+		{
+			*min = chunk->time_ms[row];
+		}
+
+		if (chunk->time_ms[row] > *max)
+		{
+			*max = chunk->time_ms[row];
+		}
+	}
+}
+
+
+/**
+ * @brief Name of the index of a recording
+ *
+ * @param[in] file_name Name of the recording
+ * @return allocated name, or NULL
+ */
+static char *index_name(const char *file_name)
+{
+	size_t length = strlen(file_name) + sizeof(INDEX_SUFFIX);
+	char   *name  = malloc(length);
+
+	if (name != NULL)
+	{
+		snprintf(name, length, "%s%s", file_name, INDEX_SUFFIX);
+	}
+
+	return name;
+}
+
+
+/**
+ * @brief Write one index entry
+ *
+ * @param[in] file Index file
+ * @param[in] entry The entry
+ * @return false if writing failed
+ */
+static bool write_index_entry(FILE *file, const index_entry_t *entry)
+{
+	return write_le(file, entry->offset, 8) && write_le(file, entry->first_sequence, 8) &&
+	       write_le(file, entry->rows, 4) && write_le(file, entry->time_min_ms, 8) && write_le(file, entry->time_max_ms, 8);
+}
+
+
+/**
+ * @brief Write a whole index
+ *
+ * @param[in] name Name of the index
+ * @param[in] entries Index entries
+ * @param[in] entry_count Number of entries
+ * @param[in] covered Size of the recording covered, 0 if the recording is still written
+ * @return the index file positioned after the last entry, or NULL if writing failed
+ */
+static FILE *write_index(const char *name, const index_entry_t *entries, size_t entry_count, uint64_t covered)
+{
+	FILE *file = fopen(name, "w+b");
+	bool ok    = file != NULL && fwrite(INDEX_MAGIC, 1, sizeof(INDEX_MAGIC), file) == sizeof(INDEX_MAGIC) &&
+	             write_le(file, covered, 8);
+
+	for (size_t i = 0; i < entry_count && ok; i++)
+	{
+		ok = write_index_entry(file, &entries[i]);
+	}
+
+	if (file != NULL && (!ok || fflush(file) != 0))
+	{
+		fclose(file);
+		file = NULL;
+	}
+
+	return file;
+}
+
+
+/**
+ * @brief Read an index that covers the whole recording
+ *
+ * @param[in]  name Name of the index
+ * @param[in]  size Size of the recording
+ * @param[out] entries Allocated index entries
+ * @param[out] entry_count Number of entries
+ * @return false if the index is missing, stale or corrupt
+ */
+static bool read_index(const char *name, uint64_t size, index_entry_t **entries, size_t *entry_count)
+{
+	FILE    *file = fopen(name, "rb");
+	uint8_t bytes[INDEX_HEADER_SIZE > INDEX_ENTRY_SIZE ? INDEX_HEADER_SIZE : INDEX_ENTRY_SIZE];
+	off_t   length;
+	bool    ok;
+
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	length = file_size(file);
+	ok     = length >= INDEX_HEADER_SIZE && (length - INDEX_HEADER_SIZE) % INDEX_ENTRY_SIZE == 0 &&
+	         fseeko(file, 0, SEEK_SET) == 0 && fread(bytes, 1, INDEX_HEADER_SIZE, file) == INDEX_HEADER_SIZE &&
+	         memcmp(bytes, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && get_le(bytes + sizeof(INDEX_MAGIC), 8) == size;
+
+	*entry_count = ok ? (size_t)(length - INDEX_HEADER_SIZE) / INDEX_ENTRY_SIZE : 0;
+	*entries     = ok ? malloc((*entry_count + 1) * sizeof(**entries)) : NULL;
+	ok           = ok && *entries != NULL;
+
+	for (size_t i = 0; i < *entry_count && ok; i++)
+	{
+		index_entry_t *entry = &(*entries)[i];
+
+		ok = fread(bytes, 1, INDEX_ENTRY_SIZE, file) == INDEX_ENTRY_SIZE;
+
+		entry->offset         = get_le(bytes, 8);
+		entry->first_sequence = get_le(bytes + 8, 8);
+		entry->rows           = (uint32_t)get_le(bytes + 16, 4);
+		entry->time_min_ms    = get_le(bytes + 20, 8);
+		entry->time_max_ms    = get_le(bytes + 28, 8);
+	}
+
+	fclose(file);
+
+	if (!ok)
+	{
+		free(*entries);
+		*entries = NULL;
+	}
+
+	return ok;
+}
+
+
+/**
+ * @brief Rebuild the index from the chunk headers, skipping the column data
+ *
+ * Scanning stops at the first chunk that is incomplete or corrupt. Version 1 chunk headers
+ * have no sequence numbers and time range, so these are counted from the row counts and
+ * taken from the statistics of the time column.
+ *
+ * @param[in]  file The recording
+ * @param[in]  version Format version of the recording
+ * @param[in]  header_size Size of the file header
+ * @param[in]  size Size of the recording
+ * @param[out] entries Allocated index entries
+ * @param[out] entry_count Number of entries
+ * @param[out] valid_size Size of the recording up to the end of the last complete chunk
+ * @return false if out of memory
+ */
+static bool rebuild_index(FILE *file, int version, uint64_t header_size, uint64_t size, index_entry_t **entries,
+                          size_t *entry_count, uint64_t *valid_size)
+{
+	size_t   capacity    = 64;
+	uint64_t offset      = header_size;
+	uint64_t chunk_size  = chunk_header_size(version);
+	uint64_t sequence    = 0;
+	uint8_t  bytes[CHUNK_HEADER_SIZE];
+
+	*entry_count = 0;
+	*valid_size  = offset;
+	*entries     = malloc(capacity * sizeof(**entries));
+	if (*entries == NULL)
+	{
+		return false;
+	}
+
+	while (offset + chunk_size <= size)
+	{
+		index_entry_t entry;
+		uint64_t      next;
+		bool          ok;
+
+		ok = fseeko(file, (off_t)offset, SEEK_SET) == 0 && fread(bytes, 1, chunk_size, file) == chunk_size &&
+		     memcmp(bytes, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) == 0 && get_le(bytes + 8, 4) == RECORD_COLUMN_COUNT;
+		if (!ok)
+		{
+			break;
+		}
+
+		entry.offset = offset;
+		entry.rows   = (uint32_t)get_le(bytes + 4, 4);
+		if (version != 1)
+		{
+			entry.first_sequence = get_le(bytes + 12, 8);
+			entry.time_min_ms    = get_le(bytes + 20, 8);
+			entry.time_max_ms    = get_le(bytes + 28, 8);
+		}
+
+		next = offset + chunk_size;
+		for (int column = 0; column < RECORD_COLUMN_COUNT && ok; column++)
+		{
+			ok = next + COLUMN_HEADER_SIZE <= size && fseeko(file, (off_t)next, SEEK_SET) == 0 &&
+			     fread(bytes, 1, COLUMN_HEADER_SIZE, file) == COLUMN_HEADER_SIZE;
+			if (ok)
+			{
+				next += COLUMN_HEADER_SIZE + get_le(bytes + 2, 4);
+			}
+
+			//the statistics of the time column are the exact time range
+			if (ok && version == 1 && column == RECORD_COLUMN_TIME)
+			{
+				entry.first_sequence = sequence;
+				entry.time_min_ms    = (uint64_t)get_f64(bytes + 6);
+				entry.time_max_ms    = (uint64_t)get_f64(bytes + 14);
+			}
+		}
+
+		if (!ok || next > size)
+		{
+			break;
+		}
+
+		if (*entry_count == capacity)
+		{
+			index_entry_t *grown = realloc(*entries, 2 * capacity * sizeof(**entries));
+
+			if (grown == NULL)
+			{
+				free(*entries);
+				*entries = NULL;
+				return false;
+			}
+
+			*entries  = grown;
+			capacity *= 2;
+		}
+
+		(*entries)[(*entry_count)++] = entry;
+		offset                       = next;
+		sequence                    += entry.rows;
+		*valid_size                  = next;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief Load the index of a recording, rebuilding it if it does not cover the recording
+ *
+ * @param[in]  file_name Name of the recording
+ * @param[in]  file The recording
+ * @param[in]  version Format version of the recording
+ * @param[in]  header_size Size of the file header
+ * @param[out] entries Allocated index entries
+ * @param[out] entry_count Number of entries
+ * @param[out] valid_size Size of the recording up to the end of the last complete chunk
+ * @return false if the recording cannot be read
+ */
+static bool load_index(const char *file_name, FILE *file, int version, uint64_t header_size, index_entry_t **entries,
+                       size_t *entry_count, uint64_t *valid_size)
+{
+	off_t size  = file_size(file);
+	char  *name = index_name(file_name);
+	bool  ok    = size >= (off_t)header_size && name != NULL;
+
+	if (ok && read_index(name, (uint64_t)size, entries, entry_count))
+	{
+		*valid_size = (uint64_t)size;
+	}
+	else if (ok && rebuild_index(file, version, header_size, (uint64_t)size, entries, entry_count, valid_size))
+	{
+		//keep the rebuilt index for the next reader, a read only directory is not an error
+		if (*valid_size == (uint64_t)size)
+		{
+			FILE *index = write_index(name, *entries, *entry_count, *valid_size);
+
+			if (index != NULL)
+			{
+				fclose(index);
+			}
+		}
+	}
+	else
+	{
+		ok = false;
+	}
+
+	free(name);
+	return ok;
+}
+
+
+/**
+ * @brief Write the buffered rows as one chunk and add it to the index
+ *
+ * @param[in,out] writer The writer
+ * @return false if writing failed
+ */
+static bool flush_chunk(record_writer_t *writer)
+{
+	chunk_t       *chunk = &writer->chunk;
+	index_entry_t entry;
+
+	if (chunk->rows == 0)
+	{
+		return true;
+	}
+
+	chunk_time_range(chunk, &entry.time_min_ms, &entry.time_max_ms);
+	entry.offset         = (uint64_t)ftello(writer->file);
+	entry.first_sequence = writer->next_sequence;
+	entry.rows           = chunk->rows;
+
+	bool ok = fwrite(CHUNK_MAGIC, 1, sizeof(CHUNK_MAGIC), writer->file) == sizeof(CHUNK_MAGIC) &&
+	          write_le(writer->file, chunk->rows, 4) && write_le(writer->file, RECORD_COLUMN_COUNT, 4);
+
+	//a version 1 recording is continued in its own format
+	if (writer->version != 1)
+	{
+		ok = ok && write_le(writer->file, entry.first_sequence, 8) && write_le(writer->file, entry.time_min_ms, 8) &&
+		     write_le(writer->file, entry.time_max_ms, 8);
+	}
+
+	for (int column = 0; column < RECORD_COLUMN_COUNT && ok; column++)
+	{
+		double min;
+		double max;
+		size_t length = encode_column(chunk, column, writer->buffer, &min, &max);
+
+		ok = write_le(writer->file, column, 1) && write_le(writer->file, COLUMN_ENCODINGS[column], 1) &&
+		     write_le(writer->file, length, 4) && write_f64(writer->file, min) && write_f64(writer->file, max) &&
+		     fwrite(writer->buffer, 1, length, writer->file) == length;
+	}
+
+	writer->next_sequence += chunk->rows;
+	chunk->rows            = 0;
+	chunk->samples         = 0;
+
+	//the chunk must be on disk before the index points at it
+	return ok && fflush(writer->file) == 0 && write_index_entry(writer->index, &entry) && fflush(writer->index) == 0;
+}
+
+
+/**
+ * @brief Check that the sensors of a recording are measured as the ones of the writer
+ *
+ * @param[in] recorded Sensors in the header of the recording
+ * @param[in] recorded_count Number of sensors in the header
+ * @param[in] sensors Sensors of the writer
+ * @param[in] sensor_count Number of sensors of the writer
+ * @return true if both have the same sensors, ranges and modes
+ */
+static bool same_sensors(const record_sensor_t *recorded, uint32_t recorded_count, const record_sensor_t *sensors,
+                         uint32_t sensor_count)
+{
+	bool same = recorded_count == sensor_count;
+
+	for (uint32_t i = 0; i < sensor_count && same; i++)
+	{
+		same = recorded[i].sensor == sensors[i].sensor && recorded[i].mode == sensors[i].mode &&
+		       recorded[i].bin_count == sensors[i].bin_count && float_bits(recorded[i].start) == float_bits(sensors[i].start) &&
+		       float_bits(recorded[i].length) == float_bits(sensors[i].length);
+	}
+
+	return same;
+}
+
+
+record_writer_t *record_open(const char *file_name, const record_sensor_t *sensors, uint32_t sensor_count)
+{
+	record_writer_t *writer     = calloc(1, sizeof(*writer));
+	index_entry_t   *entries    = NULL;
+	size_t          entry_count = 0;
+	char            *name       = index_name(file_name);
+	bool            ok          = writer != NULL && name != NULL && sensor_count <= RECORD_MAX_SENSORS;
+
+	//append to an existing recording if the header matches
+	if (ok)
+	{
+		writer->file = fopen(file_name, "r+b");
+		if (writer->file != NULL && file_size(writer->file) > 0)
+		{
+			record_sensor_t recorded[RECORD_MAX_SENSORS];
+			uint32_t        recorded_count;
+			uint64_t        header_size;
+			uint64_t        valid_size;
+
+			ok = fseeko(writer->file, 0, SEEK_SET) == 0 &&
+			     (writer->version = read_header(writer->file, recorded, &recorded_count, &header_size)) != 0 &&
+			     load_index(file_name, writer->file, writer->version, header_size, &entries, &entry_count, &valid_size);
+
+			//earlier versions have no sensors in the header, their sweeps were never described
+			ok = ok && (writer->version < 3 || same_sensors(recorded, recorded_count, sensors, sensor_count));
+
+			//drop a chunk cut short by a crash
+			if (ok && valid_size != (uint64_t)file_size(writer->file))
+			{
+				ok = fflush(writer->file) == 0 && ftruncate(fileno(writer->file), (off_t)valid_size) == 0;
+			}
+
+			ok = ok && fseeko(writer->file, (off_t)valid_size, SEEK_SET) == 0;
+		}
+		else
+		{
+			if (writer->file != NULL)
+			{
+				fclose(writer->file);
+			}
+
+			writer->file    = fopen(file_name, "w+b");
+			writer->version = 3;
+			ok              = writer->file != NULL && write_header(writer->file, sensors, sensor_count) && fflush(writer->file) == 0;
+		}
+	}
+
+	if (ok && entry_count > 0)
+	{
+		writer->next_sequence = entries[entry_count - 1].first_sequence + entries[entry_count - 1].rows;
+	}
+
+	//the index covers nothing until it is finalised on close
+	writer->index = ok ? write_index(name, entries, entry_count, 0) : NULL;
+	ok            = ok && writer->index != NULL;
+
+	free(entries);
+	free(name);
+
+	if (!ok)
+	{
+		if (writer != NULL && writer->file != NULL)
+		{
+			fclose(writer->file);
+		}
+
+		free(writer);
+		return NULL;
+	}
+
+	return writer;
+}
+
+
+bool record_append(record_writer_t *writer, const record_t *record)
+{
+	chunk_t *chunk = &writer->chunk;
+
+	if (chunk->rows == RECORD_CHUNK_ROWS || chunk->samples + record->sweep_length > RECORD_CHUNK_SAMPLES)
+	{
+		if (!flush_chunk(writer))
+		{
+			return false;
+		}
+	}
+
+	uint32_t row = chunk->rows++;
+
+	chunk->time_ms[row]      = record->time_ms;
+	chunk->sensor[row]       = record->sensor;
+	chunk->result[row]       = record->result;
+	chunk->peak_amp[row]     = record->peak_amp;
+	chunk->peak_dist[row]    = record->peak_dist;
+	chunk->sweep_length[row] = record->sweep_length;
+	memcpy(&chunk->sweep[chunk->samples], record->sweep, record->sweep_length * sizeof(record->sweep[0]));
+	chunk->samples += record->sweep_length;
+
+	return true;
+}
+
+
+bool record_close(record_writer_t *writer)
+{
+	bool  ok = flush_chunk(writer);
+	off_t size;
+
+	size = ftello(writer->file);
+	ok   = ok && size > 0 && fseeko(writer->index, sizeof(INDEX_MAGIC), SEEK_SET) == 0 &&
+	       write_le(writer->index, (uint64_t)size, 8);
+	ok   = (fclose(writer->index) == 0) && ok;
+	ok   = (fclose(writer->file) == 0) && ok;
+	free(writer);
+
+	return ok;
+}
+
+
+/**
+ * @brief Read and decode the chunk of an index entry
+ *
+ * @param[in,out] reader The reader
+ * @param[in]     entry Index of the entry
+ * @return false if the chunk is corrupt
+ */
+static bool load_chunk(record_reader_t *reader, size_t entry)
+{
+	chunk_t *chunk = &reader->chunk;
+	uint8_t header[COLUMN_HEADER_SIZE];
+	bool    ok;
+
+	reader->entry  = entry;
+	reader->row    = 0;
+	reader->loaded = false;
+	chunk->rows    = reader->entries[entry].rows;
+
+	ok = chunk->rows <= RECORD_CHUNK_ROWS &&
+	     fseeko(reader->file, (off_t)(reader->entries[entry].offset + chunk_header_size(reader->version)), SEEK_SET) == 0;
+
+	for (int column = 0; column < RECORD_COLUMN_COUNT && ok; column++)
+	{
+		size_t length;
+
+		ok = fread(header, 1, COLUMN_HEADER_SIZE, reader->file) == COLUMN_HEADER_SIZE &&
+		     header[0] == column && header[1] == COLUMN_ENCODINGS[column];
+
+		length = ok ? get_le(header + 2, 4) : 0;
+		ok     = ok && length <= RECORD_BUFFER_SIZE && fread(reader->buffer, 1, length, reader->file) == length &&
+		         decode_column(chunk, column, reader->buffer, length);
+	}
+
+	reader->loaded = ok;
+	return ok;
+}
+
+
+record_reader_t *record_reader_open(const char *file_name)
+{
+	record_reader_t *reader = calloc(1, sizeof(*reader));
+	uint64_t        header_size;
+	uint64_t        valid_size;
+
+	if (reader == NULL)
+	{
+		return NULL;
+	}
+
+	reader->file = fopen(file_name, "rb");
+	if (reader->file == NULL ||
+	    (reader->version = read_header(reader->file, reader->sensors, &reader->sensor_count, &header_size)) == 0 ||
+	    !load_index(file_name, reader->file, reader->version, header_size, &reader->entries, &reader->entry_count, &valid_size))
+	{
+		if (reader->file != NULL)
+		{
+			fclose(reader->file);
+		}
+
+		free(reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+
+bool record_reader_seek_time(record_reader_t *reader, uint64_t time_ms)
+{
+	size_t low  = 0;
+	size_t high = reader->entry_count;
+
+	//first chunk ending at or after the time
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (reader->entries[middle].time_max_ms < time_ms)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	if (low == reader->entry_count || !load_chunk(reader, low))
+	{
+		return false;
+	}
+
+	while (reader->row < reader->chunk.rows && reader->chunk.time_ms[reader->row] < time_ms)
+	{
+		reader->row++;
+	}
+
+	return true;
+}
+
+
+bool record_reader_seek_sequence(record_reader_t *reader, uint64_t sequence)
+{
+	size_t low  = 0;
+	size_t high = reader->entry_count;
+
+	//last chunk starting at or before the sequence number
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+
+		if (reader->entries[middle].first_sequence <= sequence)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	if (low == 0 || sequence - reader->entries[low - 1].first_sequence >= reader->entries[low - 1].rows ||
+	    !load_chunk(reader, low - 1))
+	{
+		return false;
+	}
+
+	reader->row = (uint32_t)(sequence - reader->entries[low - 1].first_sequence);
+	return true;
+}
+
+
+bool record_reader_seek_chunk(record_reader_t *reader, uint64_t chunk, uint32_t *rows)
+{
+	if (chunk >= reader->entry_count || !load_chunk(reader, chunk))
+	{
+		return false;
+	}
+
+	*rows = reader->entries[chunk].rows;
+	return true;
+}
+
+
+bool record_reader_next(record_reader_t *reader, record_t *record, uint64_t *sequence)
+{
+	chunk_t *chunk = &reader->chunk;
+
+	if (!reader->loaded)
+	{
+		if (reader->entry >= reader->entry_count || !load_chunk(reader, reader->entry))
+		{
+			return false;
+		}
+	}
+
+	while (reader->row == chunk->rows)
+	{
+		if (reader->entry + 1 >= reader->entry_count || !load_chunk(reader, reader->entry + 1))
+		{
+			return false;
+		}
+	}
+
+	uint32_t row = reader->row++;
+
+	record->time_ms      = chunk->time_ms[row];
+	record->sensor       = chunk->sensor[row];
+	record->result       = chunk->result[row];
+	record->peak_amp     = chunk->peak_amp[row];
+	record->peak_dist    = chunk->peak_dist[row];
+	record->sweep_length = chunk->sweep_length[row];
+	record->sweep        = &chunk->sweep[chunk->sweep_start[row]];
+	*sequence            = reader->entries[reader->entry].first_sequence + row;
+
+	return true;
+}
+
+
+void record_reader_size(const record_reader_t *reader, uint64_t *chunks, uint64_t *records)
+{
+	*chunks  = reader->entry_count;
+	*records = 0;
+
+	if (reader->entry_count > 0)
+	{
+		*records = reader->entries[reader->entry_count - 1].first_sequence + reader->entries[reader->entry_count - 1].rows;
+	}
+}
+
+
+uint32_t record_reader_sensors(const record_reader_t *reader, const record_sensor_t **sensors)
+{
+	*sensors = reader->sensors;
+	return reader->sensor_count;
+}
+
+
+bool record_reader_sensor(const record_reader_t *reader, uint16_t sensor, record_sensor_t *description)
+{
+	for (uint32_t i = 0; i < reader->sensor_count; i++)
+	{
+		if (reader->sensors[i].sensor == sensor)
+		{
+			*description = reader->sensors[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void record_reader_close(record_reader_t *reader)
+{
+	fclose(reader->file);
+	free(reader->entries);
+	free(reader);
+}
@@ -0,0 +1,257 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_RECORD_H_
+#define PARKING_RECORD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/*
+ * Columnar recording of sweeps and decisions.
+ *
+ * Records are buffered in chunks of at most RECORD_CHUNK_ROWS rows and RECORD_CHUNK_SAMPLES
+ * sweep samples, so memory stays bounded however long the recording runs. Every chunk
+ * stores each column separately with its own encoding and the minimum and maximum value of
+ * the column in the chunk, so a tool reading one field skips the bytes of all others, and
+ * chunks outside a range can be skipped by their statistics alone. Every record has a
+ * sequence number, counting from 0 at the start of the recording.
+ *
+ * All integers are little endian. The file starts with a header:
+ *   magic          8 bytes "PARKCOL3"
+ *   column count   u32
+ *   per column     u8 column id, u8 encoding, 14 bytes name padded with zeros
+ *   sensor count   u32
+ *   per sensor     u16 sensor, u8 acquisition mode, u16 requested power bins, f32 range start [m],
+ *                  f32 range length [m]
+ * followed by chunks:
+ *   magic          4 bytes "CHNK"
+ *   row count      u32
+ *   column count   u32
+ *   first sequence u64
+ *   first time     u64, smallest time in the chunk
+ *   last time      u64, largest time in the chunk
+ *   per column     u8 column id, u8 encoding, u32 byte count, f64 min, f64 max, data
+ *
+ * Encodings, all based on LEB128 varints, signed values zigzag encoded:
+ *   RECORD_ENCODING_DELTA    first value, then differences to the previous value
+ *   RECORD_ENCODING_VARINT   the value
+ *   RECORD_ENCODING_XOR      IEEE 754 bits of a float xor the bits of the previous value
+ *   RECORD_ENCODING_SWEEP    for each sweep the first sample, then differences to the previous
+ *                            sample; the sweep lengths are in the sweep_length column
+ *
+ * A sparse index with one entry per chunk is kept next to the recording, in <recording>.idx:
+ *   magic          8 bytes "PARKIDX1"
+ *   covered size   u64, size of the recording the index describes, 0 while it is written
+ *   per chunk      u64 offset, u64 first sequence, u32 row count, u64 first time, u64 last time
+ * Entries are appended as chunks are written, and the covered size is set when the recording
+ * is closed. An index that is missing or does not cover the recording is rebuilt from the
+ * chunk headers, which only reads the headers and skips the column data. A chunk cut short by
+ * a crash is dropped when the recording is opened for writing again.
+ *
+ * The sensors of the header describe how the sweeps of each sensor were measured, so a reader
+ * can give every sample its distance. A recording is only continued by a writer measuring the
+ * same sensors with the same ranges and modes.
+ *
+ * Recordings of the second version, "PARKCOL2", have no sensors in the header, so the range
+ * and mode of their sweeps are unknown. Recordings of the first version, "PARKCOL1", in
+ * addition have chunk headers with only the magic, the row count and the column count. They
+ * are read by rebuilding their index, with the sequence numbers counted from the row counts
+ * and the time range taken from the time column statistics. Both are continued in their own
+ * format when opened for writing.
+ */
+
+
+#define RECORD_CHUNK_ROWS    (1024)
+#define RECORD_CHUNK_SAMPLES (256 * 1024)
+#define RECORD_MAX_SENSORS   (32)
+
+typedef enum
+{
+	RECORD_COLUMN_TIME,
+	RECORD_COLUMN_SENSOR,
+	RECORD_COLUMN_RESULT,
+	RECORD_COLUMN_PEAK_AMP,
+	RECORD_COLUMN_PEAK_DIST,
+	RECORD_COLUMN_SWEEP_LENGTH,
+	RECORD_COLUMN_SWEEP,
+	RECORD_COLUMN_COUNT
+} record_column_t;
+
+typedef enum
+{
+	RECORD_ENCODING_DELTA,
+	RECORD_ENCODING_VARINT,
+	RECORD_ENCODING_XOR,
+	RECORD_ENCODING_SWEEP
+} record_encoding_t;
+
+/* acquisition mode of the sweeps, the values of acquisition_mode_t */
+typedef enum
+{
+	RECORD_MODE_ENVELOPE,
+	RECORD_MODE_POWER_BINS,
+	RECORD_MODE_COUNT
+} record_mode_t;
+
+extern const char *RECORD_COLUMN_NAMES[];
+
+extern const char *RECORD_MODE_NAMES[];
+
+/* how the sweeps of one sensor are measured */
+typedef struct
+{
+	uint16_t sensor;
+	uint8_t  mode;
+	uint16_t bin_count;
+	float    start;
+	float    length;
+} record_sensor_t;
+
+/* one measurement, time in milliseconds since the epoch */
+typedef struct
+{
+	uint64_t       time_ms;
+	uint16_t       sensor;
+	int8_t         result;
+	float          peak_amp;
+	float          peak_dist;
+	uint16_t       sweep_length;
+	const uint16_t *sweep;
+} record_t;
+
+typedef struct record_writer record_writer_t;
+typedef struct record_reader record_reader_t;
+
+
+/**
+ * @brief Open a recording, new records are appended to an existing one
+ *
+ * @param[in] file_name Name of the recording
+ * @param[in] sensors How the sweeps of every recorded sensor are measured
+ * @param[in] sensor_count Number of sensors, at most RECORD_MAX_SENSORS
+ * @return the writer, or NULL if the file cannot be opened, is not a recording or has other
+ *         sensors, ranges or modes
+ */
+record_writer_t *record_open(const char *file_name, const record_sensor_t *sensors, uint32_t sensor_count);
+
+
+/**
+ * @brief Add a record, full chunks are written at once
+ *
+ * @param[in,out] writer The writer
+ * @param[in]     record The record, the sweep is copied
+ * @return false if writing failed
+ */
+bool record_append(record_writer_t *writer, const record_t *record);
+
+
+/**
+ * @brief Write the buffered records, finalise the index and close the recording
+ *
+ * @param[in] writer The writer
+ * @return false if writing failed
+ */
+bool record_close(record_writer_t *writer);
+
+
+/**
+ * @brief Open a recording for reading, rebuilding its index if needed
+ *
+ * The reader is positioned at the first record.
+ *
+ * @param[in] file_name Name of the recording
+ * @return the reader, or NULL if the file cannot be opened or is not a recording
+ */
+record_reader_t *record_reader_open(const char *file_name);
+
+
+/**
+ * @brief Position the reader at the first record at or after a time
+ *
+ * Uses a binary search over the index and decodes a single chunk. Records are expected in
+ * time order, as they are written.
+ *
+ * @param[in,out] reader The reader
+ * @param[in]     time_ms Time in milliseconds since the epoch
+ * @return false if no record is that late, or reading failed
+ */
+bool record_reader_seek_time(record_reader_t *reader, uint64_t time_ms);
+
+
+/**
+ * @brief Position the reader at a sequence number
+ *
+ * @param[in,out] reader The reader
+ * @param[in]     sequence Sequence number
+ * @return false if there is no such record, or reading failed
+ */
+bool record_reader_seek_sequence(record_reader_t *reader, uint64_t sequence);
+
+
+/**
+ * @brief Position the reader at the first record of a chunk
+ *
+ * Lets several readers of the same recording split the work by chunk.
+ *
+ * @param[in,out] reader The reader
+ * @param[in]     chunk Index of the chunk, see record_reader_size()
+ * @param[out]    rows Number of records in the chunk
+ * @return false if there is no such chunk, or reading failed
+ */
+bool record_reader_seek_chunk(record_reader_t *reader, uint64_t chunk, uint32_t *rows);
+
+
+/**
+ * @brief Read the record at the position of the reader and advance to the next one
+ *
+ * @param[in,out] reader The reader
+ * @param[out]    record The record, the sweep is valid until the next call
+ * @param[out]    sequence Sequence number of the record
+ * @return false at the end of the recording, or if reading failed
+ */
+bool record_reader_next(record_reader_t *reader, record_t *record, uint64_t *sequence);
+
+
+/**
+ * @brief Number of chunks and records in the recording
+ *
+ * @param[in]  reader The reader
+ * @param[out] chunks Number of chunks
+ * @param[out] records Number of records
+ */
+void record_reader_size(const record_reader_t *reader, uint64_t *chunks, uint64_t *records);
+
+
+/**
+ * @brief How the sweeps of every sensor in the recording were measured
+ *
+ * @param[in]  reader The reader
+ * @param[out] sensors The sensors, valid until the reader is closed
+ * @return the number of sensors, 0 for recordings of earlier versions
+ */
+uint32_t record_reader_sensors(const record_reader_t *reader, const record_sensor_t **sensors);
+
+
+/**
+ * @brief How the sweeps of a sensor were measured
+ *
+ * @param[in]  reader The reader
+ * @param[in]  sensor The sensor
+ * @param[out] description Range and mode of the sensor
+ * @return false if the recording does not describe the sensor, as recordings of earlier
+ *         versions
+ */
+bool record_reader_sensor(const record_reader_t *reader, uint16_t sensor, record_sensor_t *description);
+
+
+/**
+ * @brief Close the recording
+ *
+ * @param[in] reader The reader
+ */
+void record_reader_close(record_reader_t *reader);
+
+
+#endif
@@ -0,0 +1,338 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parking-record.h"
+
+/*
+ * Replay of a recording made with ref-app-parking --export.
+ *
+ * Prints the recorded measurements of a time or sequence range, one per line. The start of
+ * the range is found through the index of the recording, so only the chunks in the range
+ * are read however long the recording is. Sweeps are printed with the acquisition mode and
+ * range stored for their sensor in the recording, which give the distance of every sample
+ * in the same way as format_data().
+ */
+
+/* default settings */
+
+static const uint64_t DEFAULT_SEQUENCE_TO = UINT64_MAX;
+static const uint64_t DEFAULT_TIME_TO     = UINT64_MAX;
+static const int      DEFAULT_SENSOR      = -1;
+
+typedef struct
+{
+	const char *file_name;
+	uint64_t   time_from;
+	uint64_t   time_to;
+	uint64_t   sequence_from;
+	uint64_t   sequence_to;
+	bool       seek_time;
+	bool       seek_sequence;
+	int        sensor;
+	bool       print_sweeps;
+	bool       verbose;
+} replay_configuration_t;
+
+
+/**
+ * @brief Print usage information to stdout
+ *
+ * @param[in] program_name
+ */
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] -f <recording>\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-f, --file                    recording to replay\n");
+	fprintf(stderr, "-F, --from                    first time, milliseconds since the epoch or \"YYYY-MM-DD HH:MM:SS\" local time\n");
+	fprintf(stderr, "-T, --to                      last time, same format as --from\n");
+	fprintf(stderr, "-q, --sequence-from           first sequence number\n");
+	fprintf(stderr, "-Q, --sequence-to             last sequence number\n");
+	fprintf(stderr, "-s, --sensor                  only measurements of this sensor\n");
+	fprintf(stderr, "-w, --sweeps                  print the acquisition mode, range start and end and sweep of every measurement\n");
+	fprintf(stderr, "-v, --verbose                 print the size of the recording and the range and mode of every sensor\n");
+}
+
+
+/**
+ * @brief Parse a time given in milliseconds since the epoch or as local date and time
+ *
+ * @param[in]  text The time
+ * @param[out] time_ms Milliseconds since the epoch
+ * @return false if the time cannot be parsed
+ */
+static bool parse_time(const char *text, uint64_t *time_ms)
+{
+	struct tm date = {0};
+	char      *end;
+	int       length = 0;
+
+	if (sscanf(text, "%d-%d-%d %d:%d:%d%n", &date.tm_year, &date.tm_mon, &date.tm_mday,
+	           &date.tm_hour, &date.tm_min, &date.tm_sec, &length) == 6 && text[length] == '\0')
+	{
+		date.tm_year -= 1900;
+		date.tm_mon  -= 1;
+		date.tm_isdst = -1;
+
+		time_t seconds = mktime(&date);
+
+		*time_ms = (uint64_t)seconds * 1000;
+		return seconds >= 0;
+	}
+
+	*time_ms = strtoull(text, &end, 10);
+	return end != text && *end == '\0';
+}
+
+
+/**
+ * @brief Parse command line options and update configuration struct
+ *
+ * @param[in]  argc Number of arguments passed to the main function
+ * @param[in]  argv Array with arguments passed to the main function
+ * @param[out] config configuration data to be updated
+ */
+static void parse_options(int argc, char *argv[], replay_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"file",                    required_argument,    0,    'f'},
+		{"from",                    required_argument,    0,    'F'},
+		{"to",                      required_argument,    0,    'T'},
+		{"sequence-from",           required_argument,    0,    'q'},
+		{"sequence-to",             required_argument,    0,    'Q'},
+		{"sensor",                  required_argument,    0,    's'},
+		{"sweeps",                  no_argument,          0,    'w'},
+		{"verbose",                 no_argument,          0,    'v'},
+		{NULL,                      0,                    NULL, 0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	memset(config, 0, sizeof(*config));
+	config->time_to     = DEFAULT_TIME_TO;
+	config->sequence_to = DEFAULT_SEQUENCE_TO;
+	config->sensor      = DEFAULT_SENSOR;
+
+	while ((character_code = getopt_long(argc, argv, "f:F:T:q:Q:s:wvh?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'f':
+			{
+				config->file_name = optarg;
+				break;
+			}
+
+			case 'F':
+			case 'T':
+			{
+				uint64_t *time_ms = character_code == 'F' ? &config->time_from : &config->time_to;
+
+				if (!parse_time(optarg, time_ms))
+				{
+					fprintf(stderr, "Invalid time: %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+
+				config->seek_time |= character_code == 'F';
+				break;
+			}
+
+			case 'q':
+			{
+				config->sequence_from = strtoull(optarg, NULL, 10);
+				config->seek_sequence = true;
+				break;
+			}
+
+			case 'Q':
+			{
+				config->sequence_to = strtoull(optarg, NULL, 10);
+				break;
+			}
+
+			case 's':
+			{
+				config->sensor = atoi(optarg);
+				break;
+			}
+
+			case 'w':
+			{
+				config->print_sweeps = true;
+				break;
+			}
+
+			case 'v':
+			{
+				config->verbose = true;
+				break;
+			}
+
+			case 'h':
+			case '?':
+			default:
+			{
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (config->file_name == NULL)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Print an error message and exit
+ *
+ * @param[in] message Error message
+ */
+static void handle_fatal_error(const char *message)
+{
+	fprintf(stderr, "Fatal error: %s\n", message);
+	exit(EXIT_FAILURE);
+}
+
+
+/**
+ * @brief Print one measurement
+ *
+ * Sweeps of sensors the recording does not describe, as in recordings of earlier versions,
+ * are printed with an unknown mode and range.
+ *
+ * @param[in] config The configuration
+ * @param[in] reader The recording
+ * @param[in] record The measurement
+ * @param[in] sequence Sequence number of the measurement
+ */
+static void print_record(const replay_configuration_t *config, const record_reader_t *reader, const record_t *record,
+                         uint64_t sequence)
+{
+	printf("%" PRIu64 " %" PRIu64 " %u %d %f %f %u", sequence, record->time_ms, (unsigned int)record->sensor,
+	       record->result, record->peak_amp, record->peak_dist, (unsigned int)record->sweep_length);
+
+	if (config->print_sweeps)
+	{
+		record_sensor_t description;
+
+		if (record_reader_sensor(reader, record->sensor, &description))
+		{
+			printf(" %s %f %f", RECORD_MODE_NAMES[description.mode], (double)description.start,
+			       (double)(description.start + description.length));
+		}
+		else
+		{
+			printf(" unknown nan nan");
+		}
+
+		for (uint16_t i = 0; i < record->sweep_length; i++)
+		{
+			printf(" %u", (unsigned int)record->sweep[i]);
+		}
+	}
+
+	printf("\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+	replay_configuration_t config;
+	record_reader_t        *reader;
+	record_t               record;
+	uint64_t               sequence;
+	bool                   found = true;
+
+	parse_options(argc, argv, &config);
+
+	reader = record_reader_open(config.file_name);
+	if (reader == NULL)
+	{
+		handle_fatal_error("Could not open the recording");
+	}
+
+	if (config.verbose)
+	{
+		uint64_t chunks;
+		uint64_t records;
+
+		const record_sensor_t *sensors;
+		uint32_t              sensor_count = record_reader_sensors(reader, &sensors);
+
+		record_reader_size(reader, &chunks, &records);
+		fprintf(stderr, "%" PRIu64 " measurements in %" PRIu64 " chunks\n", records, chunks);
+
+		for (uint32_t i = 0; i < sensor_count; i++)
+		{
+			fprintf(stderr, "Sensor %u: %s", (unsigned int)sensors[i].sensor, RECORD_MODE_NAMES[sensors[i].mode]);
+			if (sensors[i].mode == RECORD_MODE_POWER_BINS)
+			{
+				fprintf(stderr, " with %u bins", (unsigned int)sensors[i].bin_count);
+			}
+
+			fprintf(stderr, ", %f - %f m\n", (double)sensors[i].start, (double)(sensors[i].start + sensors[i].length));
+		}
+
+		if (sensor_count == 0)
+		{
+			fprintf(stderr, "Recorded before ranges and modes were stored\n");
+		}
+	}
+
+	if (config.seek_time)
+	{
+		found = record_reader_seek_time(reader, config.time_from);
+	}
+
+	if (found && config.seek_sequence)
+	{
+		uint64_t start = config.sequence_from;
+
+		//start at the later of the two positions, the other bound is checked per measurement
+		if (config.seek_time && record_reader_next(reader, &record, &sequence) && sequence > start)
+		{
+			start = sequence;
+		}
+
+		found = record_reader_seek_sequence(reader, start);
+	}
+
+	while (found && record_reader_next(reader, &record, &sequence))
+	{
+		if (sequence > config.sequence_to || record.time_ms > config.time_to)
+		{
+			break;
+		}
+
+		if (sequence < config.sequence_from || record.time_ms < config.time_from)
+		{
+			continue;
+		}
+
+		if (config.sensor == DEFAULT_SENSOR || config.sensor == record.sensor)
+		{
+			print_record(&config, reader, &record, sequence);
+		}
+	}
+
+	record_reader_close(reader);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <stdio.h>
+#include <string.h>
+
+#include "parking-roi.h"
+
+
+static const float    ROI_MARGIN           = 0.05;
+static const float    ROI_LOW_PERCENTILE   = 0.02;
+static const float    ROI_HIGH_PERCENTILE  = 0.98;
+static const uint32_t ROI_MIN_OCCUPIED     = 50;
+
+
+static int roi_bin(float dist)
+{
+	int bin = dist / ROI_BIN_SIZE;
+
+	return (bin < 0) ? 0 : (bin >= ROI_BIN_COUNT) ? ROI_BIN_COUNT - 1 : bin;
+}
+
+
+void roi_init(roi_histogram_t *roi)
+{
+	memset(roi, 0, sizeof(*roi));
+}
+
+
+bool roi_load(roi_histogram_t *roi, const char *file_name)
+{
+	FILE     *fin = fopen(file_name, "r");
+	unsigned n;
+	int      res;
+
+	roi_init(roi);
+
+	if (fin == NULL)
+	{
+		return true;
+	}
+
+	res = fscanf(fin, "n %u\n", &n);
+	if (res != 1 || n != ROI_BIN_COUNT)
+	{
+		fclose(fin);
+		return false;
+	}
+
+	res = 0;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		res += fscanf(fin, (i == 0) ? "occupied %u" : "%u", &roi->occupied[i]);
+	}
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		res += fscanf(fin, (i == 0) ? " empty %u" : "%u", &roi->empty[i]);
+	}
+
+	fclose(fin);
+
+	if (res != (int)(2 * n))
+	{
+		roi_init(roi);
+		return false;
+	}
+
+	return true;
+}
+
+
+bool roi_save(const roi_histogram_t *roi, const char *file_name)
+{
+	FILE *fout = fopen(file_name, "w");
+
+	if (fout == NULL)
+	{
+		return false;
+	}
+
+	fprintf(fout, "n %u\n", ROI_BIN_COUNT);
+
+	fprintf(fout, "occupied");
+	for (int i = 0; i < ROI_BIN_COUNT; i++)
+	{
+		fprintf(fout, " %u", roi->occupied[i]);
+	}
+
+	fprintf(fout, "\nempty");
+	for (int i = 0; i < ROI_BIN_COUNT; i++)
+	{
+		fprintf(fout, " %u", roi->empty[i]);
+	}
+
+	fprintf(fout, "\n");
+
+	return fclose(fout) == 0;
+}
+
+
+void roi_add(roi_histogram_t *roi, float peak_dist, bool occupied)
+{
+	uint32_t *bins = occupied ? roi->occupied : roi->empty;
+	int      bin   = roi_bin(peak_dist);
+
+	if (bins[bin] < UINT32_MAX)
+	{
+		bins[bin]++;
+	}
+}
+
+
+bool roi_propose(const roi_histogram_t *roi, float range_start, float range_length, float *start, float *length)
+{
+	uint32_t total = 0;
+
+	for (int i = 0; i < ROI_BIN_COUNT; i++)
+	{
+		total += roi->occupied[i];
+	}
+
+	if (total < ROI_MIN_OCCUPIED)
+	{
+		return false;
+	}
+
+	uint32_t count = 0;
+	int      low   = -1;
+	int      high  = -1;
+
+	for (int i = 0; i < ROI_BIN_COUNT; i++)
+	{
+		count += roi->occupied[i];
+
+		if (low < 0 && count > total * ROI_LOW_PERCENTILE)
+		{
+			low = i;
+		}
+
+		if (high < 0 && count >= total * ROI_HIGH_PERCENTILE)
+		{
+			high = i;
+		}
+	}
+
+	float range_end = range_start + range_length;
+	float roi_start = low * ROI_BIN_SIZE - ROI_MARGIN;
+	float roi_end   = (high + 1) * ROI_BIN_SIZE + ROI_MARGIN;
+
+	if (roi_start < range_start)
+	{
+		roi_start = range_start;
+	}
+
+	if (roi_end > range_end)
+	{
+		roi_end = range_end;
+	}
+
+	if (roi_end <= roi_start)
+	{
+		return false;
+	}
+
+	*start  = roi_start;
+	*length = roi_end - roi_start;
+
+	return true;
+}
+
+
+float roi_empty_share(const roi_histogram_t *roi, float start, float length)
+{
+	uint32_t total  = 0;
+	uint32_t inside = 0;
+	int      first  = roi_bin(start);
+	int      last   = roi_bin(start + length);
+
+	for (int i = 0; i < ROI_BIN_COUNT; i++)
+	{
+		total += roi->empty[i];
+		if (i >= first && i <= last)
+		{
+			inside += roi->empty[i];
+		}
+	}
+
+	return (total > 0) ? (float)inside / total : 0;
+}
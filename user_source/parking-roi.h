@@ -0,0 +1,93 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_ROI_H_
+#define PARKING_ROI_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define ROI_BIN_COUNT    (200)
+#define ROI_BIN_SIZE     (0.01f)
+#define ROI_MAX_DISTANCE (ROI_BIN_COUNT * ROI_BIN_SIZE)
+
+
+/*
+ * Histogram of peak positions, kept separately for occupied and empty decisions.
+ * Bin i counts peaks at distances [i, i + 1) * ROI_BIN_SIZE, so the histogram only covers
+ * ranges ending within ROI_MAX_DISTANCE.
+ */
+typedef struct
+{
+	uint32_t occupied[ROI_BIN_COUNT];
+	uint32_t empty[ROI_BIN_COUNT];
+} roi_histogram_t;
+
+
+/**
+ * @brief Clear all bins of the histogram
+ *
+ * @param[out] roi The histogram
+ */
+void roi_init(roi_histogram_t *roi);
+
+
+/**
+ * @brief Load the histogram from file, an empty histogram is used if the file does not exist
+ *
+ * @param[out] roi The histogram
+ * @param[in]  file_name Name of the histogram file
+ * @return false if the file exists but could not be parsed
+ */
+bool roi_load(roi_histogram_t *roi, const char *file_name);
+
+
+/**
+ * @brief Save the histogram to file
+ *
+ * @param[in] roi The histogram
+ * @param[in] file_name Name of the histogram file
+ * @return false if the file could not be written
+ */
+bool roi_save(const roi_histogram_t *roi, const char *file_name);
+
+
+/**
+ * @brief Add the position of one detection peak
+ *
+ * @param[in,out] roi The histogram
+ * @param[in]     peak_dist Distance to the peak [m]
+ * @param[in]     occupied Result of the detection
+ */
+void roi_add(roi_histogram_t *roi, float peak_dist, bool occupied);
+
+
+/**
+ * @brief Propose a processing window covering the peaks of occupied decisions
+ *
+ * The window spans the 2nd to 98th percentile of occupied peak positions, widened by one
+ * pulse length on each side and limited to the calibrated range.
+ *
+ * @param[in]  roi The histogram
+ * @param[in]  range_start Start of the calibrated range [m]
+ * @param[in]  range_length Length of the calibrated range [m]
+ * @param[out] start Proposed start [m]
+ * @param[out] length Proposed length [m]
+ * @return false if there are too few occupied decisions to propose a window
+ */
+bool roi_propose(const roi_histogram_t *roi, float range_start, float range_length, float *start, float *length);
+
+
+/**
+ * @brief Share of empty decisions with their peak inside a window
+ *
+ * @param[in] roi The histogram
+ * @param[in] start Start of the window [m]
+ * @param[in] length Length of the window [m]
+ * @return share 0.0 - 1.0, 0.0 if there are no empty decisions
+ */
+float roi_empty_share(const roi_histogram_t *roi, float start, float length);
+
+
+#endif
@@ -0,0 +1,179 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include "parking-schedule.h"
+
+
+/* weight of the latest duration in the cost estimate */
+static const double COST_SMOOTHING = 0.2;
+
+/* release this many times the total cost of all tasks before the deadline */
+static const double RELEASE_MARGIN = 2.0;
+
+/* but at least this long before the deadline, to cover wake up and scheduling jitter [s] */
+static const double MIN_RELEASE_SLACK = 0.02;
+
+
+/**
+ * @brief Sum of the costs of all tasks
+ *
+ * @param[in] tasks The tasks
+ * @param[in] count Number of tasks
+ * @return total cost [s]
+ */
+static double total_cost(const schedule_task_t *tasks, unsigned int count)
+{
+	double sum = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		sum += tasks[i].cost;
+	}
+
+	return sum;
+}
+
+
+void schedule_init(schedule_task_t *tasks, const double *freshness, unsigned int count, double now)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		tasks[i].freshness    = freshness[i];
+		tasks[i].cost         = 0;
+		tasks[i].deadline     = now + freshness[i];
+		tasks[i].release      = now;
+		tasks[i].measurements = 0;
+		tasks[i].misses       = 0;
+		tasks[i].max_lateness = 0;
+	}
+}
+
+
+/**
+ * @brief Plan the next measurement of a task after a result completed
+ *
+ * @param[in,out] tasks The tasks
+ * @param[in]     count Number of tasks
+ * @param[in]     index Task that was measured
+ * @param[in]     end Time the result completed [s]
+ */
+static void plan_next(schedule_task_t *tasks, unsigned int count, unsigned int index, double end)
+{
+	schedule_task_t *task  = &tasks[index];
+	double          slack = RELEASE_MARGIN * total_cost(tasks, count);
+
+	//the fresh result must be replaced before it gets too old
+	task->deadline = end + task->freshness;
+	task->release  = task->deadline - ((slack > MIN_RELEASE_SLACK) ? slack : MIN_RELEASE_SLACK);
+	if (task->release < end)
+	{
+		task->release = end;
+	}
+}
+
+
+void schedule_resume(schedule_task_t *tasks, unsigned int count, unsigned int index, double cost, double last)
+{
+	tasks[index].cost = cost;
+	plan_next(tasks, count, index, last);
+}
+
+
+int schedule_next(const schedule_task_t *tasks, unsigned int count, double now, double *wait)
+{
+	int    next          = -1;
+	double first_release = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (tasks[i].release <= now)
+		{
+			if (next < 0 || tasks[i].deadline < tasks[next].deadline)
+			{
+				next = i;
+			}
+		}
+		else if (first_release == 0 || tasks[i].release < first_release)
+		{
+			first_release = tasks[i].release;
+		}
+	}
+
+	*wait = (next < 0) ? first_release - now : 0;
+	return next;
+}
+
+
+unsigned int schedule_released(const schedule_task_t *tasks, unsigned int count, double now, unsigned int *order)
+{
+	unsigned int released = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (tasks[i].release > now)
+		{
+			continue;
+		}
+
+		//ties keep the order of the tasks, like schedule_next()
+		unsigned int position = released++;
+
+		while (position > 0 && tasks[order[position - 1]].deadline > tasks[i].deadline)
+		{
+			order[position] = order[position - 1];
+			position--;
+		}
+
+		order[position] = i;
+	}
+
+	return released;
+}
+
+
+bool schedule_complete(schedule_task_t *tasks, unsigned int count, unsigned int index, double start, double end)
+{
+	schedule_task_t *task    = &tasks[index];
+	double          duration = end - start;
+	double          lateness = end - task->deadline;
+	bool            missed   = lateness > 0;
+
+	task->cost = (task->measurements == 0) ? duration : task->cost + COST_SMOOTHING * (duration - task->cost);
+	task->measurements++;
+
+	if (missed)
+	{
+		task->misses++;
+		if (lateness > task->max_lateness)
+		{
+			task->max_lateness = lateness;
+		}
+	}
+
+	plan_next(tasks, count, index, end);
+
+	return missed;
+}
+
+
+void schedule_set_freshness(schedule_task_t *tasks, unsigned int index, double freshness)
+{
+	schedule_task_t *task = &tasks[index];
+
+	task->deadline  += freshness - task->freshness;
+	task->release   += freshness - task->freshness;
+	task->freshness  = freshness;
+}
+
+
+double schedule_utilization(const schedule_task_t *tasks, unsigned int count)
+{
+	double utilization = 0;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		utilization += tasks[i].cost / tasks[i].freshness;
+	}
+
+	return utilization;
+}
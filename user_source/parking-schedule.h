@@ -0,0 +1,117 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_SCHEDULE_H_
+#define PARKING_SCHEDULE_H_
+
+#include <stdbool.h>
+
+
+/*
+ * Earliest deadline first scheduling of measurements on sensors sharing one bus.
+ *
+ * The result of every sensor must never be older than its freshness, so each measurement
+ * has to complete before the previous result of the sensor has aged that long. Measurements
+ * are not preempted, so a measurement is released early enough that it can still complete
+ * if every other sensor is measured first. Among released measurements the one with the
+ * earliest deadline runs next. The cost of a measurement is learned from its duration.
+ */
+typedef struct
+{
+	double       freshness;
+	double       cost;
+	double       deadline;
+	double       release;
+	unsigned int measurements;
+	unsigned int misses;
+	double       max_lateness;
+} schedule_task_t;
+
+
+/**
+ * @brief Initialize the tasks, all of them are released at once
+ *
+ * @param[out] tasks The tasks
+ * @param[in]  freshness Maximum age of the result of every task [s]
+ * @param[in]  count Number of tasks
+ * @param[in]  now Current time [s]
+ */
+void schedule_init(schedule_task_t *tasks, const double *freshness, unsigned int count, double now);
+
+
+/**
+ * @brief Continue a task measured by a previous process, see parking-checkpoint.h
+ *
+ * The next measurement is planned as if the last result of the previous process had been
+ * measured by this one.
+ *
+ * @param[in,out] tasks The tasks
+ * @param[in]     count Number of tasks
+ * @param[in]     index Task to continue
+ * @param[in]     cost Cost learned by the previous process [s]
+ * @param[in]     last Time the last result completed [s]
+ */
+void schedule_resume(schedule_task_t *tasks, unsigned int count, unsigned int index, double cost, double last);
+
+
+/**
+ * @brief Select the next measurement
+ *
+ * @param[in]  tasks The tasks
+ * @param[in]  count Number of tasks
+ * @param[in]  now Current time [s]
+ * @param[out] wait Time until the next release if no task is released [s]
+ * @return index of the released task with the earliest deadline, or -1 if no task is released
+ */
+int schedule_next(const schedule_task_t *tasks, unsigned int count, double now, double *wait);
+
+
+/**
+ * @brief List the released measurements, earliest deadline first
+ *
+ * The first one is the one schedule_next() selects, so the others can be measured along with
+ * it when that is cheaper than measuring them one at a time.
+ *
+ * @param[in]  tasks The tasks
+ * @param[in]  count Number of tasks
+ * @param[in]  now Current time [s]
+ * @param[out] order Index of every released task, count entries
+ * @return number of released tasks
+ */
+unsigned int schedule_released(const schedule_task_t *tasks, unsigned int count, double now, unsigned int *order);
+
+
+/**
+ * @brief Record a completed measurement and plan the next one of the task
+ *
+ * @param[in,out] tasks The tasks
+ * @param[in]     count Number of tasks
+ * @param[in]     index Task that was measured
+ * @param[in]     start Time the measurement started [s]
+ * @param[in]     end Time the measurement completed [s]
+ * @return true if the deadline was missed
+ */
+bool schedule_complete(schedule_task_t *tasks, unsigned int count, unsigned int index, double start, double end);
+
+
+/**
+ * @brief Change the freshness of a task, moving its planned measurement accordingly
+ *
+ * @param[in,out] tasks The tasks
+ * @param[in]     index Task to change
+ * @param[in]     freshness Maximum age of the result [s]
+ */
+void schedule_set_freshness(schedule_task_t *tasks, unsigned int index, double freshness);
+
+
+/**
+ * @brief Share of the bus time the tasks need with their current costs
+ *
+ * @param[in] tasks The tasks
+ * @param[in] count Number of tasks
+ * @return utilization, above 1 deadlines cannot be met
+ */
+double schedule_utilization(const schedule_task_t *tasks, unsigned int count);
+
+
+#endif
@@ -2,33 +2,51 @@
 // All rights reserved
 
 #include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-#include "acc_driver_hal.h"
-
 #include "acc_log.h"
 #include "acc_rss.h"
 #include "acc_service.h"
-#include "acc_service_envelope.h"
-#include "acc_sweep_configuration.h"
 
 #include "acc_version.h"
 
+#include "parking-baseline.h"
+#include "parking-board.h"
+#include "parking-checkpoint.h"
+#include "parking-detector.h"
+#include "parking-governor.h"
+#include "parking-history.h"
+#include "parking-model.h"
+#include "parking-pass.h"
+#include "parking-record.h"
+#include "parking-roi.h"
+#include "parking-schedule.h"
+#include "parking-sensor.h"
+#include "parking-shm.h"
+#include "parking-threshold.h"
+
 static acc_hal_t hal;
 
-static void handle_fatal_error(char *);
+static volatile sig_atomic_t stop_requested = false;
 
+static volatile sig_atomic_t reload_requested = false;
 
-static inline uint16_t min(uint16_t a, uint16_t b)
-{
-	return (a < b) ? a : b;
-}
+static volatile sig_atomic_t handover_requested = false;
 
+static bool taken_over = false;
 
-#define MAX_DATA_SIZE (3000)
+static record_writer_t *recorder = NULL;
+
+static model_t *model = NULL;
+
+static checkpoint_t *checkpoint = NULL;
 
 /* default settings */
 
@@ -39,34 +57,146 @@ static const int   DEFAULT_SENSOR                 = 1;
 static const int   NBR_OF_SWEEPS                  = 1;
 static const int   FREQUENCY                      = 100;
 static const int   DEFAULT_DELAY                  = 10;
-
-#define  MAX_FILE_NAME_LENGTH (200)
-
+static const int   DEFAULT_BIN_COUNT              = 8;
+static const float DEFAULT_PHASE_STABILITY        = 0.9;
+static const int   MAX_REJECTED_SWEEPS            = 5;
+static const float DEFAULT_RANGE_GAIN             = 0;
+static const float DEFAULT_RUNNING_AVERAGE        = RUNNING_AVERAGE_SERVICE_DEFAULT;
+static const int   MAX_NBR_OF_SWEEPS              = 100;
+static const float DEFAULT_CPU_BUDGET             = 0.8;
+static const float DEFAULT_BUS_BUDGET             = 0.9;
+static const int   TAKE_OVER_TIMEOUT              = 30;
+static const int   BASELINE_SLOTS                 = 48;
+static const float DEFAULT_PASS_GAP               = 0.2;
+static const int   PASS_ENTER_SWEEPS              = 2;
+static const float PASS_HYSTERESIS                = 0.8;
+
+#define  MAX_FILE_NAME_LENGTH  (200)
+#define  MAX_SENSORS           (4)
+#define  MAX_SEGMENTS          (4)
+#define  MAX_BOARD_NAME_LENGTH (15)
+
+/* options without a short form, the shared memory ones are used by the supervisor when it starts workers */
+enum
+{
+	OPTION_SHM_NAME = 256,
+	OPTION_SHM_SLOT,
+	OPTION_CPU_BUDGET,
+	OPTION_BUS_BUDGET,
+	OPTION_SHED_POLICY,
+	OPTION_CHECKPOINT,
+	OPTION_BATCH_SEARCH,
+};
+
+/* range of one segment of a sensor, bin_count 0 means the configured bin count */
 typedef struct
 {
-	float           start_range;
-	float           length_range;
-	int             nbr_of_sweeps;
-	int             frequency;
-	acc_sensor_id_t sensor;
-} radar_configuration_t;
+	float    start;
+	float    length;
+	uint16_t bin_count;
+} segment_range_t;
 
 typedef struct
 {
 	bool                  calibrate;
 	bool                  read_calibration_file;
+	double                baseline_hours;
 	radar_configuration_t radar_config;
+	segment_range_t       segments[MAX_SEGMENTS];
+	unsigned int          segment_count;
 	int                   loglevel;
 	char                  calibration_file_name[MAX_FILE_NAME_LENGTH + 1];
 	int                   time_delay;
 	bool                  delay;
+	bool                  phase_check;
+	float                 phase_stability;
+	bool                  roi;
+	bool                  roi_apply;
+	char                  roi_file_name[MAX_FILE_NAME_LENGTH + 1];
+	bool                  tune_threshold;
+	char                  threshold_file_name[MAX_FILE_NAME_LENGTH + 1];
+	char                  model_file_name[MAX_FILE_NAME_LENGTH + 1];
+	bool                  interference_check;
+	float                 range_gain;
+	bool                  smooth;
+	bool                  loop;
+	bool                  pass_count;
+	float                 pass_gap;
+	char                  shm_name[MAX_FILE_NAME_LENGTH + 1];
+	unsigned int          shm_slot;
+	char                  checkpoint_name[MAX_FILE_NAME_LENGTH + 1];
+	char                  history_file_name[MAX_FILE_NAME_LENGTH + 1];
+	int                   sensors[MAX_SENSORS];
+	double                freshness[MAX_SENSORS];
+	unsigned int          sensor_count;
+	bool                  batch;
+	bool                  batch_search;
+	char                  board[MAX_BOARD_NAME_LENGTH + 1];
+	char                  export_file_name[MAX_FILE_NAME_LENGTH + 1];
+	bool                  governor;
+	float                 cpu_budget;
+	float                 bus_budget;
+	governor_policy_t     shed_policy;
 } app_configuration_t;
 
-typedef struct datapoint
+typedef struct
+{
+	float     avg_calib_amp;
+	float     avg_amp_factor;
+	Datapoint peak_amp;
+	float     start;
+	float     end;
+	unsigned  data_length;
+	uint16_t  data[MAX_DATA_SIZE];
+} calibration_t;
+
+/* per sample tables, computed when the length of the sweeps is known */
+typedef struct
 {
-	float dist;
-	float amp;
-} Datapoint;
+	uint16_t        length;
+	float           noise_profile[MAX_DATA_SIZE];
+	float           gain[MAX_DATA_SIZE];
+	acc_sensor_id_t previous_sensor;
+	uint16_t        previous_length;
+	uint16_t        previous[MAX_DATA_SIZE];
+} sweep_tables_t;
+
+/* state of one range segment, measured with its own service */
+typedef struct
+{
+	radar_configuration_t       radar_config;
+	calibration_t               calibration;
+	sweep_tables_t              tables;
+	acc_service_configuration_t service_configuration;
+	acc_service_handle_t        service_handle;
+} segment_t;
+
+/* state of one sensor */
+typedef struct
+{
+	app_configuration_t   config;
+	unsigned int          segment_count;
+	segment_t             segments[MAX_SEGMENTS];
+	roi_histogram_t       roi;
+	threshold_histogram_t tuning;
+	history_t             *history;
+	int                   last_result;
+	baseline_t            *baseline;
+} sensor_context_t;
+
+/* the measured sensors, the single sensor or the sensors of the list in order */
+static sensor_context_t sensors[MAX_SENSORS];
+
+/* first sweep of a sensor searched across sensors, see measure_sensors_batch() */
+typedef struct
+{
+	uint16_t  sweep_data[MAX_DATA_SIZE];
+	uint16_t  sweep_length;
+	Datapoint peak;
+	int       present;
+	double    duration;
+	double    cpu_time;
+} batch_measurement_t;
 
 
 /**
@@ -76,17 +206,51 @@ typedef struct datapoint
  */
 static void init_configuration(app_configuration_t *app_config)
 {
-	app_config->calibrate                  = false;
-	app_config->read_calibration_file      = false;
-	app_config->radar_config.start_range   = DEFAULT_START_RANGE;
-	app_config->radar_config.length_range  = DEFAULT_LENGTH_RANGE;
-	app_config->radar_config.nbr_of_sweeps = NBR_OF_SWEEPS;
-	app_config->radar_config.frequency     = FREQUENCY;
-	app_config->radar_config.sensor        = DEFAULT_SENSOR;
-	app_config->loglevel                   = ACC_LOG_LEVEL_ERROR;
-	app_config->time_delay                 = DEFAULT_DELAY;
-	app_config->delay                      = false;
+	app_config->calibrate                           = false;
+	app_config->read_calibration_file               = false;
+	app_config->baseline_hours                      = 0;
+	app_config->radar_config.start_range            = DEFAULT_START_RANGE;
+	app_config->radar_config.length_range           = DEFAULT_LENGTH_RANGE;
+	app_config->radar_config.nbr_of_sweeps          = NBR_OF_SWEEPS;
+	app_config->radar_config.frequency              = FREQUENCY;
+	app_config->radar_config.sensor                 = DEFAULT_SENSOR;
+	app_config->radar_config.mode                   = ACQUISITION_MODE_ENVELOPE;
+	app_config->radar_config.bin_count              = DEFAULT_BIN_COUNT;
+	app_config->radar_config.running_average_factor = DEFAULT_RUNNING_AVERAGE;
+	app_config->segment_count                       = 0;
+	app_config->loglevel                            = ACC_LOG_LEVEL_ERROR;
+	app_config->time_delay                          = DEFAULT_DELAY;
+	app_config->delay                               = false;
+	app_config->phase_check                         = false;
+	app_config->phase_stability                     = DEFAULT_PHASE_STABILITY;
+	app_config->roi                                 = false;
+	app_config->roi_apply                           = false;
+	app_config->roi_file_name[0]                    = '\0';
+	app_config->tune_threshold                      = false;
+	app_config->threshold_file_name[0]              = '\0';
+	app_config->interference_check                  = false;
+	app_config->range_gain                          = DEFAULT_RANGE_GAIN;
+	app_config->smooth                              = false;
+	app_config->loop                                = false;
+	app_config->pass_count                          = false;
+	app_config->pass_gap                            = DEFAULT_PASS_GAP;
+	app_config->shm_name[0]                         = '\0';
+	app_config->shm_slot                            = 0;
+	app_config->checkpoint_name[0]                  = '\0';
+	app_config->history_file_name[0]                = '\0';
+	app_config->sensors[0]                          = DEFAULT_SENSOR;
+	app_config->freshness[0]                        = 0;
+	app_config->sensor_count                        = 1;
+	app_config->batch                               = false;
+	app_config->batch_search                        = false;
 	strcpy(app_config->calibration_file_name, DEFAULT_CALIBRATION_FILE_NAME);
+	strcpy(app_config->board, DEFAULT_BOARD);
+	app_config->export_file_name[0] = '\0';
+	app_config->model_file_name[0]  = '\0';
+	app_config->governor            = false;
+	app_config->cpu_budget          = DEFAULT_CPU_BUDGET;
+	app_config->bus_budget          = DEFAULT_BUS_BUDGET;
+	app_config->shed_policy         = GOVERNOR_POLICY_FRESHNESS;
 }
 
 
@@ -100,15 +264,169 @@ static void print_usage(const char *program_name)
 	fprintf(stderr, "Usage: %s [OPTIONS]\n", program_name);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "-h, --help                    this help\n");
-	fprintf(stderr, "-s, --sensor                  sensor to use, default %u\n", DEFAULT_SENSOR);
+	fprintf(stderr, "-B, --board                   connector board, default %s, linked boards: ", DEFAULT_BOARD);
+	board_print_names(stderr);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-s, --sensor                  sensor to use, default %u, a list like 1,2,3 measures every sensor once with\n", DEFAULT_SENSOR);
+	fprintf(stderr, "                              calibration file <calibration-file>.<sensor> and prints one line per sensor,\n");
+	fprintf(stderr, "                              with --loop a list like 1:5,2:30 keeps every result fresher than the given\n");
+	fprintf(stderr, "                              seconds (default the delay) by measuring earliest deadline first\n");
 	fprintf(stderr, "-c, --calibrate               record read empty parking spot data and store calibration file\n");
 	fprintf(stderr, "-f, --calibration-file        name of the calibration file, default %s\n", DEFAULT_CALIBRATION_FILE_NAME);
+	fprintf(stderr, "-E, --baseline                estimate the sweep of the empty spot as the lowest one over this many hours, so\n");
+	fprintf(stderr, "                              the spot need not be empty: with --calibrate measure with the delay until the\n");
+	fprintf(stderr, "                              calibration file can be written, with --loop keep the calibration up to date\n");
 	fprintf(stderr, "-a, --range-start             start measure at this distance [m], default %.3f\n", (double)DEFAULT_START_RANGE);
+	fprintf(stderr, "-w, --segments                with --calibrate, measure only these range segments, a list like 0.2:0.1,0.9:0.3\n");
+	fprintf(stderr, "                              of start:length [m], at most %d, each calibrated and decided on its own\n", MAX_SEGMENTS);
 	fprintf(stderr, "-d, --delay                   do multiple measurements with a time delay in between (time in seconds)\n");
+	fprintf(stderr, "-m, --mode                    acquisition mode, envelope or power-bins, default %s\n", ACQUISITION_MODE_NAMES[ACQUISITION_MODE_ENVELOPE]);
+	fprintf(stderr, "-b, --bin-count               number of bins in power-bins mode, default %u\n", DEFAULT_BIN_COUNT);
+	fprintf(stderr, "-p, --phase-check             confirm detections with an IQ phase stability check, optional minimum stability (0-1), default %.2f\n",
+	        (double)DEFAULT_PHASE_STABILITY);
+	fprintf(stderr, "-r, --roi-file                learn the region of interest from peak positions stored in this file\n");
+	fprintf(stderr, "-R, --roi-apply               measure only the learned region of interest once enough data is collected\n");
+	fprintf(stderr, "-t, --threshold-file          tune the detection threshold from peak amplitudes stored in this file\n");
+	fprintf(stderr, "-M, --model                   decide with the learned model in this file instead of the calibrated\n");
+	fprintf(stderr, "                              threshold, reloaded on SIGHUP\n");
+	fprintf(stderr, "-i, --interference-check      reject sweeps corrupted by interference and measure again\n");
+	fprintf(stderr, "-g, --range-gain              compensate amplitudes for distance with this range exponent, default %.1f (off)\n",
+	        (double)DEFAULT_RANGE_GAIN);
+	fprintf(stderr, "-S, --smooth                  smooth every sweep with a 3 sample filter before the peak search\n");
+	fprintf(stderr, "-n, --sweeps                  number of sweeps averaged per measurement, default %d\n", NBR_OF_SWEEPS);
+	fprintf(stderr, "-A, --running-average         average the sweeps on the sensor with this factor (0-1) instead of on the host,\n");
+	fprintf(stderr, "                              envelope mode only, 0 turns it off, default the SDK default\n");
+	fprintf(stderr, "-x, --export                  record sweeps and decisions in this columnar file, appended if it exists\n");
+	fprintf(stderr, "-H, --history                 append every change of the result to this occupancy history, for a sensor\n");
+	fprintf(stderr, "                              list <history>.<sensor>, see ref-app-parking-query\n");
+	fprintf(stderr, "-l, --loop                    measure continuously with the delay in between until terminated\n");
+	fprintf(stderr, "-P, --pass-count              count the vehicles passing under the sensor in a lane, streaming at %d Hz until\n", FREQUENCY);
+	fprintf(stderr, "                              terminated, optional minimum gap between vehicles [s] as -P<gap>, default %.2f\n",
+	        (double)DEFAULT_PASS_GAP);
+	fprintf(stderr, "-G, --governor                with --loop and a sensor list, degrade the least critical sensors while the\n");
+	fprintf(stderr, "                              gateway CPU or the bus is over budget and restore them when load drops\n");
+	fprintf(stderr, "    --cpu-budget              with --governor, CPU utilization budget of the gateway (0-1), default %.2f\n",
+	        (double)DEFAULT_CPU_BUDGET);
+	fprintf(stderr, "    --bus-budget              with --governor, bus utilization budget (0-1), default %.2f\n", (double)DEFAULT_BUS_BUDGET);
+	fprintf(stderr, "    --shed-policy             with --governor, least critical sensors first, freshness (longest) or order\n");
+	fprintf(stderr, "                              (last in list),");
+	fprintf(stderr, " default %s\n", GOVERNOR_POLICY_NAMES[GOVERNOR_POLICY_FRESHNESS]);
+	fprintf(stderr, "    --batch-search            with a sensor list, measure the sensors due before deciding any of them and\n");
+	fprintf(stderr, "                              search their sweeps for peaks in one pass across sensors, not with -S, -g, -i\n");
+	fprintf(stderr, "                              or -M, sensors with several segments are searched on their own\n");
+	fprintf(stderr, "    --checkpoint              keep the state of every sensor in this shared memory region, and take over\n");
+	fprintf(stderr, "                              from the process using it, which stops measuring, for zero downtime upgrades\n");
+	fprintf(stderr, "    --shm-name                publish every result in this shared memory region created by the supervisor\n");
+	fprintf(stderr, "    --shm-slot                slot in the shared memory region, 0 - %u, default 0\n", SHM_MAX_WORKERS - 1);
 	fprintf(stderr, "-v, --verbose                 enable verbose logging\n");
 }
 
 
+/**
+ * @brief Parse a comma separated list of sensor ids, each optionally followed by a freshness
+ *
+ * @param[in]  list The list, e.g. "1,2,3" or "1:5,2:30"
+ * @param[out] app_config configuration data, the sensors, freshness and sensor_count are updated
+ * @return true if the list is valid
+ */
+static bool parse_sensor_list(const char *list, app_configuration_t *app_config)
+{
+	const char   *next = list;
+	unsigned int count = 0;
+
+	do
+	{
+		char *end;
+		long sensor = strtol(next, &end, 10);
+
+		double freshness = 0;
+
+		if (end != next && *end == ':')
+		{
+			next      = end + 1;
+			freshness = strtod(next, &end);
+			if (end == next || !isfinite(freshness) || freshness <= 0)
+			{
+				return false;
+			}
+		}
+
+		if (end == next || sensor <= 0 || count == MAX_SENSORS || (*end != ',' && *end != '\0'))
+		{
+			return false;
+		}
+
+		app_config->sensors[count]   = sensor;
+		app_config->freshness[count] = freshness;
+		count++;
+		next = end + 1;
+		if (*end == '\0')
+		{
+			break;
+		}
+	} while (true);
+
+	app_config->sensor_count = count;
+	return true;
+}
+
+
+/**
+ * @brief Parse a comma separated list of range segments
+ *
+ * A single segment only moves the range, so it is stored in the radar configuration and the
+ * calibration file keeps the format without segments.
+ *
+ * @param[in]  list The list, e.g. "0.2:0.1,0.9:0.3", in increasing distance without overlap
+ * @param[out] app_config configuration data, the segments and segment_count are updated
+ * @return true if the list is valid
+ */
+static bool parse_segment_list(const char *list, app_configuration_t *app_config)
+{
+	const char   *next = list;
+	unsigned int count = 0;
+
+	do
+	{
+		char  *end;
+		float start  = strtof(next, &end);
+		float length = 0;
+
+		if (end != next && *end == ':')
+		{
+			next   = end + 1;
+			length = strtof(next, &end);
+		}
+
+		if (end == next || start < 0 || length <= 0 || count == MAX_SEGMENTS || (*end != ',' && *end != '\0') ||
+		    (count > 0 && start < app_config->segments[count - 1].start + app_config->segments[count - 1].length))
+		{
+			return false;
+		}
+
+		app_config->segments[count].start     = start;
+		app_config->segments[count].length    = length;
+		app_config->segments[count].bin_count = 0;
+		count++;
+		next = end + 1;
+		if (*end == '\0')
+		{
+			break;
+		}
+	} while (true);
+
+	if (count == 1)
+	{
+		app_config->radar_config.start_range  = app_config->segments[0].start;
+		app_config->radar_config.length_range = app_config->segments[0].length;
+		count                                 = 0;
+	}
+
+	app_config->segment_count = count;
+	return true;
+}
+
+
 /**
  * @brief Parse command line options and update configuration struct
  *
@@ -121,27 +439,68 @@ static void parse_options(int argc, char *argv[], app_configuration_t *app_confi
 	static struct option long_options[] =
 	{
 		{"help",                    no_argument,          0,    'h'},
+		{"board",                   required_argument,    0,    'B'},
 		{"sensor",                  required_argument,    0,    's'},
 		{"calibrate",               no_argument,          0,    'c'},
 		{"calibration-file",        required_argument,    0,    'f'},
+		{"baseline",                required_argument,    0,    'E'},
 		{"range-start",             required_argument,    0,    'a'},
+		{"segments",                required_argument,    0,    'w'},
 		{"delay",                   required_argument,    0,    'd'},
+		{"mode",                    required_argument,    0,    'm'},
+		{"bin-count",               required_argument,    0,    'b'},
+		{"phase-check",             optional_argument,    0,    'p'},
+		{"roi-file",                required_argument,    0,    'r'},
+		{"roi-apply",               no_argument,          0,    'R'},
+		{"threshold-file",          required_argument,    0,    't'},
+		{"model",                   required_argument,    0,    'M'},
+		{"interference-check",      no_argument,          0,    'i'},
+		{"range-gain",              required_argument,    0,    'g'},
+		{"smooth",                  no_argument,          0,    'S'},
+		{"sweeps",                  required_argument,    0,    'n'},
+		{"running-average",         required_argument,    0,    'A'},
+		{"export",                  required_argument,    0,    'x'},
+		{"history",                 required_argument,    0,    'H'},
+		{"loop",                    no_argument,          0,    'l'},
+		{"pass-count",              optional_argument,    0,    'P'},
+		{"governor",                no_argument,          0,    'G'},
+		{"cpu-budget",              required_argument,    0,    OPTION_CPU_BUDGET},
+		{"bus-budget",              required_argument,    0,    OPTION_BUS_BUDGET},
+		{"shed-policy",             required_argument,    0,    OPTION_SHED_POLICY},
+		{"batch-search",            no_argument,          0,    OPTION_BATCH_SEARCH},
+		{"checkpoint",              required_argument,    0,    OPTION_CHECKPOINT},
+		{"shm-name",                required_argument,    0,    OPTION_SHM_NAME},
+		{"shm-slot",                required_argument,    0,    OPTION_SHM_SLOT},
 		{"verbose",                 no_argument,          0,    'v'},
 		{NULL,                      0,                    NULL,   0}
 	};
 
-	int character_code;
-	int option_index = 0;
+	int  character_code;
+	int  option_index     = 0;
+	bool governor_options = false;
 
 	init_configuration(app_config);
 
-	while ((character_code = getopt_long(argc, argv, "s:a:f:d:cvh?:", long_options, &option_index)) != -1)
+	while ((character_code = getopt_long(argc, argv, "B:s:a:w:f:E:d:m:b:p::P::r:t:M:g:n:A:x:H:cRiSlGvh?:", long_options, &option_index)) != -1)
 	{
 		switch (character_code)
 		{
+			case 'B':
+			{
+				strncpy(app_config->board, optarg, MAX_BOARD_NAME_LENGTH);
+				app_config->board[MAX_BOARD_NAME_LENGTH] = '\0';
+				break;
+			}
+
 			case 's':
 			{
-				app_config->radar_config.sensor = atoi(optarg);
+				if (!parse_sensor_list(optarg, app_config))
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->radar_config.sensor = app_config->sensors[0];
 				break;
 			}
 
@@ -159,6 +518,19 @@ static void parse_options(int argc, char *argv[], app_configuration_t *app_confi
 				break;
 			}
 
+			case 'E':
+			{
+				double hours = atof(optarg);
+				if (hours <= 0)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->baseline_hours = hours;
+				break;
+			}
+
 			case 'a':
 			{
 				char *next;
@@ -166,6 +538,17 @@ static void parse_options(int argc, char *argv[], app_configuration_t *app_confi
 				break;
 			}
 
+			case 'w':
+			{
+				if (!parse_segment_list(optarg, app_config))
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				break;
+			}
+
 			case 'd':
 			{
 				app_config->delay      = true;
@@ -173,6 +556,114 @@ static void parse_options(int argc, char *argv[], app_configuration_t *app_confi
 				break;
 			}
 
+			case 'm':
+			{
+				if (!parse_acquisition_mode(optarg, &app_config->radar_config.mode))
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				break;
+			}
+
+			case 'b':
+			{
+				int bin_count = atoi(optarg);
+				if (bin_count <= 0 || bin_count > MAX_DATA_SIZE)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->radar_config.bin_count = bin_count;
+				break;
+			}
+
+			case 'p':
+			{
+				app_config->phase_check = true;
+				if (optarg != NULL)
+				{
+					char  *next;
+					float stability = strtof(optarg, &next);
+					if (next == optarg || *next != '\0' || !(stability >= 0 && stability <= 1))
+					{
+						print_usage(argv[0]);
+						exit(EXIT_FAILURE);
+					}
+
+					app_config->phase_stability = stability;
+				}
+
+				break;
+			}
+
+			case 'P':
+			{
+				app_config->pass_count = true;
+				if (optarg != NULL)
+				{
+					char *next;
+					app_config->pass_gap = strtof(optarg, &next);
+					if (app_config->pass_gap <= 0)
+					{
+						print_usage(argv[0]);
+						exit(EXIT_FAILURE);
+					}
+				}
+
+				break;
+			}
+
+			case 'r':
+			{
+				app_config->roi = true;
+				strncpy(app_config->roi_file_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->roi_file_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
+
+			case 'R':
+			{
+				app_config->roi_apply = true;
+				break;
+			}
+
+			case 't':
+			{
+				app_config->tune_threshold = true;
+				strncpy(app_config->threshold_file_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->threshold_file_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
+
+			case 'M':
+			{
+				strncpy(app_config->model_file_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->model_file_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
+
+			case 'i':
+			{
+				app_config->interference_check = true;
+				break;
+			}
+
+			case 'S':
+			{
+				app_config->smooth = true;
+				break;
+			}
+
+			case 'g':
+			{
+				char *next;
+				app_config->range_gain = strtof(optarg, &next);
+				break;
+			}
+
 			case 'h':
 			case '?':
 			{
@@ -180,442 +671,2588 @@ static void parse_options(int argc, char *argv[], app_configuration_t *app_confi
 				exit(0);
 			}
 
-			case 'v':
+			case 'n':
 			{
-				app_config->loglevel = ACC_LOG_LEVEL_INFO;
+				int nbr_of_sweeps = atoi(optarg);
+				if (nbr_of_sweeps <= 0 || nbr_of_sweeps > MAX_NBR_OF_SWEEPS)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->radar_config.nbr_of_sweeps = nbr_of_sweeps;
 				break;
 			}
-		}
-	}
-}
-
 
-/**
- * @brief Decides if car is present based on average amplitude, peak amplitudes, and calibration data.
- * This algorithm needs calibration.
- *
- * @param[in] avg_peak_amp The max peak amplitude from the collected envelope data
- * @param[in] avg_calib_amp The threshold from calibration which decides whether the algorithm should output 1 or 0
- * @param[in] avg_amp_factor Amplitude factor
- * @return 0 if no car, and 1 if car is present.
- **/
-static int car_present(float avg_peak_amp, float avg_calib_amp, float avg_amp_factor)
-{
-	return avg_peak_amp > avg_calib_amp * avg_amp_factor * 4;
-}
+			case 'A':
+			{
+				char  *next;
+				float factor = strtof(optarg, &next);
+				if (factor < 0 || factor >= 1)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->radar_config.running_average_factor = factor;
+				break;
+			}
 
+			case 'x':
+			{
+				strncpy(app_config->export_file_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->export_file_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
 
-/**
- * @brief Organizes collected amplitude data 'amp' with its distance 'dist'. Calculates the
- * start-to-end range and adds each amplitude 'amp' to a distance 'dist' with
- * 'step' interval, within the range.
- *
- * @param[out] data Array of the collected envelope data organized as datapoints with amplitude and distance
- * @param[in]  amp Array of collected amplitude data
- * @param[in]  length Length of datapoint array
- * @param[in]  start Corresponds to start range in the application configuration
- * @param[in]  end The end range for the distance the sensor is measuring
- **/
-static void format_data(Datapoint *data, const uint16_t *amp, int length, float start, float end)
-{
-	float range = end - start;
-	float step  = range/length;
+			case 'H':
+			{
+				strncpy(app_config->history_file_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->history_file_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
 
-	for (int i = 0; i < length; i++)
-	{
-		data[i].dist = start + step*i;
-		data[i].amp  = amp[i];
-	}
-}
+			case 'l':
+			{
+				app_config->loop = true;
+				break;
+			}
 
+			case 'G':
+			{
+				app_config->governor = true;
+				break;
+			}
 
-/**
- * @brief Calculates the average amplitude for given data.
- *
- * @param[in] data Array of envelope data
- * @param[in] length The length of the envelope data array
- * @return a float number corresponding to the average amplitude for all sweeps
- **/
-static float get_average_amplitude(Datapoint *data, int length)
-{
-	float sum = 0;
+			case OPTION_CPU_BUDGET:
+			case OPTION_BUS_BUDGET:
+			{
+				float budget = strtof(optarg, NULL);
+				if (budget <= 0 || budget > 1)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				*((character_code == OPTION_CPU_BUDGET) ? &app_config->cpu_budget : &app_config->bus_budget) = budget;
+				governor_options = true;
+				break;
+			}
 
-	for (int i = 0; i < length; i++)
-	{
-		sum += data[i].amp;
-	}
+			case OPTION_SHED_POLICY:
+			{
+				int policy = 0;
+				while (policy < GOVERNOR_POLICY_COUNT && strcmp(optarg, GOVERNOR_POLICY_NAMES[policy]) != 0)
+				{
+					policy++;
+				}
+
+				if (policy == GOVERNOR_POLICY_COUNT)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->shed_policy = policy;
+				governor_options        = true;
+				break;
+			}
 
-	return sum / length;
-}
+			case OPTION_BATCH_SEARCH:
+			{
+				app_config->batch_search = true;
+				break;
+			}
 
+			case OPTION_CHECKPOINT:
+			{
+				strncpy(app_config->checkpoint_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->checkpoint_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
 
-/**
- * @brief Calculates the max peak for given data. Assumes there is only one
- * sweep in data.
- *
- * @param[in] data Array of envelope data
- * @param[in] length The length of the envelope data array
- * @return a datapoint with average max peak amplitude and distance from all sweeps.
- **/
-static Datapoint get_max_peak(Datapoint *data, int length)
-{
-	Datapoint max;
+			case OPTION_SHM_NAME:
+			{
+				strncpy(app_config->shm_name, optarg, MAX_FILE_NAME_LENGTH);
+				app_config->shm_name[MAX_FILE_NAME_LENGTH] = '\0';
+				break;
+			}
 
-	max.amp  = -1;
-	max.dist = -1;
+			case OPTION_SHM_SLOT:
+			{
+				int slot = atoi(optarg);
+				if (slot < 0 || slot >= SHM_MAX_WORKERS)
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				app_config->shm_slot = slot;
+				break;
+			}
 
-	for (int i = 0; i < length; i++)
-	{
-		if (data[i].amp > max.amp)
-		{
-			max = data[i];
+			case 'v':
+			{
+				app_config->loglevel = ACC_LOG_LEVEL_INFO;
+				break;
+			}
 		}
 	}
 
-	return max;
-}
-
-
-/**
- * @brief Calculate threashold from calibration data stored in file
- *
- * The threshold_data[i] is set to  captured envelope data from calibration.
- *
- * @param[in]  app_config configuration data
- * @param[out] avg_calib_amp The average amplitude value from the threshold data
- * @param[out] peak_amp The datapoint with highest amplitude and its corresponding distance
- * @param[out] avg_amp_factor = peak_amp/avg_calib_amp
- */
-static void read_and_calculate_threshold(app_configuration_t *app_config, float *avg_calib_amp, Datapoint *peak_amp, float *avg_amp_factor)
-{
-	uint16_t threshold_data[MAX_DATA_SIZE];
-	float    start;
-	float    length;
-	unsigned n;
-	uint16_t res;
-	FILE     *fin;
-
-	fin = fopen(app_config->calibration_file_name, "r");
+	app_config->batch = app_config->sensor_count > 1;
 
-	if (fin == NULL)
+	//a worker publishing to the supervisor serves a single sensor
+	if (app_config->batch && app_config->shm_name[0] != '\0')
 	{
-		handle_fatal_error("Unable to read calibration data file");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	res  =  fscanf(fin, "start %f\n", &start);
-	res += fscanf(fin, "length %f\n", &length);
-	res += fscanf(fin, "n %u\n", &n);
+	//the freshness of a sensor is only used by the schedule of a sensor list measured with --loop
+	for (unsigned int i = 0; i < app_config->sensor_count; i++)
+	{
+		if (app_config->freshness[i] > 0 && !(app_config->batch && app_config->loop))
+		{
+			print_usage(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
 
-	if (n == 0)
+	//the governor only runs the schedule of a sensor list measured with --loop
+	if ((app_config->governor || governor_options) && !(app_config->governor && app_config->batch && app_config->loop))
 	{
-		handle_fatal_error("n must be bigger than 0.\n");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	if (res != 3)
+	//the tuned threshold replaces the rule the model replaces
+	if (app_config->tune_threshold && app_config->model_file_name[0] != '\0')
 	{
-		handle_fatal_error("Calibration data file format error.\n");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	res = 0;
-	for (unsigned int i = 0; i < n; i++)
+	//the baseline is estimated for a single sensor, calibrated or measured continuously
+	if (app_config->baseline_hours > 0 && (app_config->batch || (!app_config->calibrate && !app_config->loop)))
 	{
-		res += fscanf(fin, "%hu", &threshold_data[i]);
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	if (res != n)
+	//passes are counted with the calibrated threshold of a single sensor
+	if (app_config->pass_count && (app_config->batch || app_config->calibrate || app_config->model_file_name[0] != '\0'))
 	{
-		handle_fatal_error("Calibration data file format error.\n");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	if (start != app_config->radar_config.start_range)
+	//counting streams until terminated, without the measurements, history, baseline or checkpoint of the loop
+	if (app_config->pass_count && (app_config->loop || app_config->export_file_name[0] != '\0' ||
+	                               app_config->history_file_name[0] != '\0' || app_config->baseline_hours > 0 ||
+	                               app_config->checkpoint_name[0] != '\0'))
 	{
-		printf("Setting start_range to %1.2f due to calibration file\n", (double)start);
-		app_config->radar_config.start_range = start;
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	if (length < app_config->radar_config.length_range)
+	//the search across sensors tests the raw sweeps of a sensor list against the calibrated threshold
+	if (app_config->batch_search && (!app_config->batch || app_config->calibrate || app_config->smooth || app_config->range_gain != 0 ||
+	                                 app_config->interference_check || app_config->model_file_name[0] != '\0'))
 	{
-		printf("Setting length_range to %1.2f due to calibration file\n", (double)length);
-		app_config->radar_config.length_range = length;
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
 	}
 
-	n = min(n, MAX_DATA_SIZE);
-	memset(threshold_data, 0, n);
+	//calibrating would take the sensors from the process owning the checkpoint for nothing
+	if (app_config->calibrate && app_config->checkpoint_name[0] != '\0')
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
 
-	Datapoint th_data[n];
-	format_data(th_data, threshold_data, n, app_config->radar_config.start_range,
-	            app_config->radar_config.start_range + app_config->radar_config.length_range);
 
-	*avg_calib_amp  = get_average_amplitude(th_data, n);
-	*peak_amp       = get_max_peak(th_data, n);
-	*avg_amp_factor = peak_amp->amp / *avg_calib_amp;
+/**
+ * @brief Signal handler ending the measurement loop after the current detection
+ *
+ * @param[in] signal_number Ignored
+ */
+static void request_stop(int signal_number)
+{
+	(void)signal_number;
+	stop_requested = true;
 }
 
 
 /**
- * @brief Handle fatal errors by printing error message and terminating the program
+ * @brief Signal handler ending the measurement loop for the process taking over the sensors
  *
- * @param[in]  message error message
+ * @param[in] signal_number Ignored
  */
-static void handle_fatal_error(char *message)
+static void request_handover(int signal_number)
 {
-	fprintf(stderr, "Fatal error: %s\n", message);
-	exit(EXIT_FAILURE);
+	(void)signal_number;
+	handover_requested = true;
+	stop_requested     = true;
 }
 
 
 /**
- * @brief Capture envelope data and write to calibration file
+ * @brief Signal handler loading the model again before the next detection
  *
- * @param[in]   app_config Configuration data
- * @param[in]   envelope_configuration The envelope configuration
- * @returns     An envelope service instance
+ * @param[in] signal_number Ignored
  */
-static acc_service_handle_t create_sensor_service(app_configuration_t *app_config, acc_service_configuration_t envelope_configuration)
+static void request_reload(int signal_number)
 {
-	//set service profile
-	acc_service_envelope_profile_set(envelope_configuration, ACC_SERVICE_ENVELOPE_PROFILE_MAXIMIZE_SNR);
+	(void)signal_number;
+	reload_requested = true;
+}
 
-	//create sweep configuration
-	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(envelope_configuration);
-	if (sweep_configuration == NULL)
-	{
-		handle_fatal_error("Sweep configuration not available");
+
+/**
+ * @brief Load the model, or load it again after SIGHUP
+ *
+ * A model that cannot be loaded at startup is fatal. A model that cannot be loaded again is
+ * reported and the current model is kept, so a half copied file cannot stop the detection.
+ *
+ * @param[in] app_config Configuration data
+ */
+static void load_model(const app_configuration_t *app_config)
+{
+	if (app_config->model_file_name[0] == '\0' || (model != NULL && !reload_requested))
+	{
+		return;
+	}
+
+	reload_requested = false;
+
+	model_t *loaded = model_load(app_config->model_file_name);
+
+	if (loaded == NULL && model == NULL)
+	{
+		handle_fatal_error("Unable to load model");
+	}
+
+	if (loaded == NULL)
+	{
+		fprintf(stderr, "Unable to load model %s, keeping the current model\n", app_config->model_file_name);
+		return;
+	}
+
+	model_free(model);
+	model = loaded;
+
+	if (app_config->loglevel >= ACC_LOG_LEVEL_INFO)
+	{
+		printf("Loaded %s model %s\n", MODEL_KIND_NAMES[model_kind(model)], app_config->model_file_name);
+	}
+}
+
+
+/**
+ * @brief Get the number of range segments measured
+ *
+ * @param[in] app_config Configuration data
+ * @returns   1 for a single contiguous range, otherwise the number of segments
+ */
+static unsigned int get_segment_count(const app_configuration_t *app_config)
+{
+	return (app_config->segment_count > 0) ? app_config->segment_count : 1;
+}
+
+
+/**
+ * @brief Derive the radar configuration of one range segment
+ *
+ * @param[in]  app_config Configuration data
+ * @param[in]  index Index of the segment
+ * @param[out] radar_config Radar configuration of the segment
+ */
+static void get_segment_radar_config(const app_configuration_t *app_config, unsigned int index, radar_configuration_t *radar_config)
+{
+	*radar_config = app_config->radar_config;
+
+	if (app_config->segment_count > 0)
+	{
+		radar_config->start_range  = app_config->segments[index].start;
+		radar_config->length_range = app_config->segments[index].length;
+		if (app_config->segments[index].bin_count > 0)
+		{
+			radar_config->bin_count = app_config->segments[index].bin_count;
+		}
+	}
+}
+
+
+/**
+ * @brief Keep calibration data and calculate the threshold from it
+ *
+ * @param[in]  app_config Configuration data
+ * @param[in]  data Calibration data, the sweep of the empty spot
+ * @param[in]  n Number of samples
+ * @param[in]  start Start of the calibrated range [m]
+ * @param[in]  length Length of the calibrated range [m]
+ * @param[in]  range_start Start of the measured range [m]
+ * @param[in]  range_length Length of the measured range [m]
+ * @param[out] calibration Threshold and calibration data
+ */
+static void set_calibration(const app_configuration_t *app_config, const uint16_t *data, unsigned n, float start, float length,
+                            float range_start, float range_length, calibration_t *calibration)
+{
+	//keep the calibration data as noise profile for the interference check
+	calibration->start       = start;
+	calibration->end         = start + length;
+	calibration->data_length = n;
+	memcpy(calibration->data, data, n * sizeof(data[0]));
+
+	uint16_t threshold_data[n];
+	memcpy(threshold_data, data, n * sizeof(data[0]));
+	memset(threshold_data, 0, n);
+
+	//the threshold is compared with compensated amplitudes, so it is computed from compensated calibration data
+	float gain[n];
+	compute_gain_table(gain, n, range_start, range_start + range_length, app_config->range_gain);
+
+	calculate_threshold(threshold_data, n, range_start, range_start + range_length, (app_config->range_gain != 0) ? gain : NULL,
+	                    &calibration->avg_calib_amp, &calibration->peak_amp, &calibration->avg_amp_factor);
+}
+
+
+/**
+ * @brief Calculate threashold from the calibration data of one range segment
+ *
+ * The threshold_data[i] is set to  captured envelope data from calibration. A file without
+ * segments sets the range of the configuration like before, a segment sets its own range.
+ *
+ * @param[in]     fin The calibration file
+ * @param[in,out] app_config configuration data
+ * @param[in]     index Index of the segment
+ * @param[in]     count Number of segments in the file
+ * @param[out]    calibration Threshold and calibration data
+ * @returns       Number of calibration samples
+ */
+static unsigned read_calibration_segment(FILE *fin, app_configuration_t *app_config, unsigned int index, unsigned int count,
+                                         calibration_t *calibration)
+{
+	uint16_t threshold_data[MAX_DATA_SIZE];
+	float    start;
+	float    length;
+	float    range_start;
+	float    range_length;
+	unsigned n;
+	uint16_t res;
+	char     mode_name[MAX_MODE_NAME_LENGTH + 1];
+
+	res  =  fscanf(fin, " start %f\n", &start);
+	res += fscanf(fin, "length %f\n", &length);
+	res += fscanf(fin, "n %u\n", &n);
+
+	if (n == 0)
+	{
+		handle_fatal_error("n must be bigger than 0.\n");
+	}
+
+	if (res != 3)
+	{
+		handle_fatal_error("Calibration data file format error.\n");
+	}
+
+	// Calibration files written before power-bins support have no mode line
+	acquisition_mode_t mode = ACQUISITION_MODE_ENVELOPE;
+	if (fscanf(fin, "mode %15s\n", mode_name) == 1 && !parse_acquisition_mode(mode_name, &mode))
+	{
+		handle_fatal_error("Unknown acquisition mode in calibration file.\n");
+	}
+
+	res = 0;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		res += fscanf(fin, "%hu", &threshold_data[i]);
+	}
+
+	if (res != n)
+	{
+		handle_fatal_error("Calibration data file format error.\n");
+	}
+
+	if (count > 1)
+	{
+		//all segments share the service type
+		if (index > 0 && mode != app_config->radar_config.mode)
+		{
+			handle_fatal_error("Calibration segments with different acquisition modes.\n");
+		}
+
+		app_config->segments[index].start     = start;
+		app_config->segments[index].length    = length;
+		app_config->segments[index].bin_count = (mode == ACQUISITION_MODE_POWER_BINS) ? n : 0;
+		app_config->radar_config.mode         = mode;
+		range_start                           = start;
+		range_length                          = length;
+	}
+	else
+	{
+		if (start != app_config->radar_config.start_range)
+		{
+			if (!app_config->batch)
+			{
+				printf("Setting start_range to %1.2f due to calibration file\n", (double)start);
+			}
+
+			app_config->radar_config.start_range = start;
+		}
+
+		if (length < app_config->radar_config.length_range)
+		{
+			if (!app_config->batch)
+			{
+				printf("Setting length_range to %1.2f due to calibration file\n", (double)length);
+			}
+
+			app_config->radar_config.length_range = length;
+		}
+
+		if (mode != app_config->radar_config.mode)
+		{
+			if (!app_config->batch)
+			{
+				printf("Setting mode to %s due to calibration file\n", ACQUISITION_MODE_NAMES[mode]);
+			}
+
+			app_config->radar_config.mode = mode;
+		}
+
+		if (mode == ACQUISITION_MODE_POWER_BINS)
+		{
+			app_config->radar_config.bin_count = n;
+		}
+
+		range_start  = app_config->radar_config.start_range;
+		range_length = app_config->radar_config.length_range;
+	}
+
+	n = min(n, MAX_DATA_SIZE);
+
+	set_calibration(app_config, threshold_data, n, start, length, range_start, range_length, calibration);
+
+	return n;
+}
+
+
+/**
+ * @brief Calculate threasholds from calibration data stored in file
+ *
+ * A file written with several range segments starts with a "segments <count>" line followed by
+ * the calibration data of every segment, and replaces the range of the configuration with its
+ * segments. The ROI and the tuned threshold describe a single range, so they cannot be used with
+ * several segments.
+ *
+ * @param[in,out] app_config configuration data
+ * @param[out]    sensor Threshold and calibration data of every segment
+ */
+static void read_and_calculate_threshold(app_configuration_t *app_config, sensor_context_t *sensor)
+{
+	FILE         *fin;
+	char         line[32];
+	unsigned int count = 1;
+	unsigned     total = 0;
+
+	fin = fopen(app_config->calibration_file_name, "r");
+
+	if (fin == NULL)
+	{
+		handle_fatal_error("Unable to read calibration data file");
+	}
+
+	if (fgets(line, sizeof(line), fin) == NULL || sscanf(line, "segments %u", &count) != 1)
+	{
+		rewind(fin);
+		count = 1;
+	}
+
+	if (count == 0 || count > MAX_SEGMENTS)
+	{
+		handle_fatal_error("Calibration data file format error.\n");
+	}
+
+	//a recording stores one contiguous sweep per measurement, it has no place for the segment layout
+	if (count > 1 && (app_config->roi || app_config->tune_threshold || app_config->export_file_name[0] != '\0'))
+	{
+		handle_fatal_error("ROI, threshold tuning and recordings need a calibration without segments.\n");
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		total += read_calibration_segment(fin, app_config, i, count, &sensor->segments[i].calibration);
+	}
+
+	fclose(fin);
+
+	//the sweeps of all segments are stitched into one buffer
+	if (total > MAX_DATA_SIZE)
+	{
+		handle_fatal_error("Calibration segments too long.\n");
+	}
+
+	app_config->segment_count = (count > 1) ? count : 0;
+
+	if (count > 1 && !app_config->batch)
+	{
+		printf("Measuring %u segments due to calibration file\n", count);
+	}
+}
+
+
+/**
+ * @brief Write the calibration data of one range segment to the calibration file
+ *
+ * @param[in]   fout The calibration file
+ * @param[in]   radar_config Radar configuration of the segment
+ * @param[in]   data The sweep of the empty spot
+ * @param[in]   data_len Number of samples
+ */
+static void print_calibration_segment(FILE *fout, const radar_configuration_t *radar_config, const uint16_t *data, uint16_t data_len)
+{
+	fprintf(fout, "start %f\n", (double)radar_config->start_range);
+	fprintf(fout, "length %f\n", (double)radar_config->length_range);
+	fprintf(fout, "n %u\n", data_len);
+	fprintf(fout, "mode %s\n", ACQUISITION_MODE_NAMES[radar_config->mode]);
+
+	for (int i = 0; i < data_len; i++)
+	{
+		fprintf(fout, "%d ", data[i]);
+	}
+
+	fprintf(fout, "\n");
+}
+
+
+/**
+ * @brief Capture envelope or power bins data of one range segment and write it to the calibration file
+ *
+ * @param[in]   fout The calibration file
+ * @param[in]   radar_config Radar configuration of the segment
+ */
+static void write_calibration_segment(FILE *fout, const radar_configuration_t *radar_config)
+{
+	uint16_t data_len = MAX_DATA_SIZE;
+	uint16_t data[data_len];
+
+	acc_service_configuration_t service_configuration = create_service_configuration(radar_config);
+	acc_service_handle_t        service_handle        = create_sensor_service(radar_config, service_configuration);
+
+	data_len = get_one_sweep(radar_config, service_handle, data, data_len);
+	print_calibration_segment(fout, radar_config, data, data_len);
+
+	close_sensor_service(service_handle);
+	destroy_service_configuration(radar_config, &service_configuration);
+}
+
+
+/**
+ * @brief Open a temporary file next to the calibration file for writing a new calibration
+ *
+ * @param[in]   app_config Configuration data
+ * @param[out]  temporary_name Name of the temporary file, <calibration-file>.tmp,
+ *              MAX_FILE_NAME_LENGTH + 1 characters
+ * @returns     the temporary file
+ */
+static FILE *open_calibration_file(const app_configuration_t *app_config, char *temporary_name)
+{
+	FILE *fout;
+
+	if (snprintf(temporary_name, MAX_FILE_NAME_LENGTH + 1, "%s.tmp", app_config->calibration_file_name) > MAX_FILE_NAME_LENGTH)
+	{
+		handle_fatal_error("File name too long");
+	}
+
+	fout = fopen(temporary_name, "w");
+
+	if (fout == NULL)
+	{
+		handle_fatal_error("Unable to write calibration data to file\n");
+	}
+
+	return fout;
+}
+
+
+/**
+ * @brief Replace the calibration file with the temporary file written
+ *
+ * The temporary file is on disk before it is renamed over the calibration file, so a crash or
+ * power loss leaves either the old or the new calibration, never a truncated one.
+ *
+ * @param[in]   app_config Configuration data
+ * @param[in]   fout The temporary file, closed by the call
+ * @param[in]   temporary_name Name of the temporary file
+ */
+static void replace_calibration_file(const app_configuration_t *app_config, FILE *fout, const char *temporary_name)
+{
+	bool ok = fflush(fout) == 0 && fsync(fileno(fout)) == 0;
+
+	ok = (fclose(fout) == 0) && ok;
+
+	if (!ok || rename(temporary_name, app_config->calibration_file_name) != 0)
+	{
+		unlink(temporary_name);
+		handle_fatal_error("Unable to write calibration data to file\n");
+	}
+}
+
+
+/**
+ * @brief Capture envelope or power bins data and write to calibration file
+ *
+ * Every range segment is captured with its own service, one after the other.
+ *
+ * @param[in]   app_config Configuration data
+ */
+static void write_calibration_data(const app_configuration_t *app_config)
+{
+	char temporary_name[MAX_FILE_NAME_LENGTH + 1];
+	FILE *fout = open_calibration_file(app_config, temporary_name);
+
+	if (app_config->segment_count > 0)
+	{
+		fprintf(fout, "segments %u\n", app_config->segment_count);
+	}
+
+	for (unsigned int i = 0; i < get_segment_count(app_config); i++)
+	{
+		radar_configuration_t radar_config;
+
+		get_segment_radar_config(app_config, i, &radar_config);
+		write_calibration_segment(fout, &radar_config);
+	}
+
+	replace_calibration_file(app_config, fout, temporary_name);
+}
+
+
+/**
+ * @brief Set up the range segments of a sensor after its calibration is read
+ *
+ * @param[in,out] sensor The sensor, with its configuration and calibration
+ */
+static void open_segments(sensor_context_t *sensor)
+{
+	sensor->segment_count = get_segment_count(&sensor->config);
+
+	for (unsigned int i = 0; i < sensor->segment_count; i++)
+	{
+		segment_t *segment = &sensor->segments[i];
+
+		get_segment_radar_config(&sensor->config, i, &segment->radar_config);
+		segment->tables.length         = 0;
+		segment->service_configuration = create_service_configuration(&segment->radar_config);
+	}
+}
+
+
+/**
+ * @brief Create the service instances of the range segments of a sensor
+ *
+ * @param[in,out] sensor The sensor
+ */
+static void create_segment_services(sensor_context_t *sensor)
+{
+	for (unsigned int i = 0; i < sensor->segment_count; i++)
+	{
+		segment_t *segment = &sensor->segments[i];
+
+		segment->service_handle = create_sensor_service(&segment->radar_config, segment->service_configuration);
+	}
+}
+
+
+/**
+ * @brief Close the service instances of the range segments of a sensor
+ *
+ * @param[in,out] sensor The sensor
+ */
+static void close_segment_services(sensor_context_t *sensor)
+{
+	for (unsigned int i = 0; i < sensor->segment_count; i++)
+	{
+		close_sensor_service(sensor->segments[i].service_handle);
+	}
+}
+
+
+/**
+ * @brief Destroy the service configurations of the range segments of a sensor
+ *
+ * @param[in,out] sensor The sensor
+ */
+static void close_segments(sensor_context_t *sensor)
+{
+	for (unsigned int i = 0; i < sensor->segment_count; i++)
+	{
+		destroy_service_configuration(&sensor->segments[i].radar_config, &sensor->segments[i].service_configuration);
+	}
+}
+
+
+/**
+ * @brief Confirm an amplitude detection with the IQ phase stability check
+ *
+ * The check only runs when the amplitude already indicates a car, so empty spots cost no
+ * extra sweeps. The amplitude service is deactivated during the IQ burst and is activated
+ * again by the next call to get_one_sweep().
+ *
+ * @param[in]   app_config Configuration data
+ * @param[in]   service_handle The amplitude service instance
+ * @param[in]   peak The strongest datapoint of the amplitude sweep
+ * @param[in]   result Result of car_present()
+ * @param[out]  settled Set to true if the result is confirmed and needs no further measurements
+ * @returns     1 if there is a parked car, 0 otherwise
+ */
+static int confirm_detection(app_configuration_t *app_config, acc_service_handle_t service_handle, Datapoint peak, int result,
+                             bool *settled)
+{
+	if (!app_config->phase_check || result != 1)
+	{
+		return result;
+	}
+
+	acc_service_deactivate(service_handle);
+
+	float stability = get_phase_stability(&app_config->radar_config, peak.dist);
+	if (app_config->loglevel >= ACC_LOG_LEVEL_INFO)
+	{
+		printf("Phase stability at %1.2f m: %1.2f\n", (double)peak.dist, (double)stability);
+	}
+
+	if (stability >= app_config->phase_stability)
+	{
+		*settled = true;
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Decide with the tuned threshold and add the peak amplitude to its histogram
+ *
+ * A decision far from a tuned threshold is settled at once, so well separated spots need no
+ * confirming measurement.
+ *
+ * @param[in,out] tuning Peak amplitude histogram, may be NULL
+ * @param[in]     peak The strongest datapoint of the sweep
+ * @param[in]     result Result of car_present()
+ * @param[out]    settled Set to true if the result needs no further measurements
+ * @returns       1 if there is a car, 0 if the parking spot is empty
+ */
+static int tune_detection(threshold_histogram_t *tuning, Datapoint peak, int result, bool *settled)
+{
+	if (tuning == NULL)
+	{
+		return result;
+	}
+
+	*settled = threshold_settled(tuning, peak.amp);
+	result   = peak.amp > threshold_get(tuning);
+	threshold_add(tuning, peak.amp, time(NULL));
+
+	return result;
+}
+
+
+/**
+ * @brief Compute the per sample tables of a range segment when the length of the sweeps changes
+ *
+ * @param[in]     app_config Configuration data
+ * @param[in,out] segment The segment, with its calibration
+ * @param[in]     data_len Number of samples of the sweeps
+ */
+static void prepare_tables(const app_configuration_t *app_config, segment_t *segment, uint16_t data_len)
+{
+	const calibration_t *calibration = &segment->calibration;
+	sweep_tables_t      *tables      = &segment->tables;
+	float               start        = segment->radar_config.start_range;
+	float               end          = segment->radar_config.start_range + segment->radar_config.length_range;
+
+	if ((app_config->range_gain != 0 || app_config->interference_check) && tables->length != data_len)
+	{
+		resample_profile(calibration->data, calibration->data_length, calibration->start, calibration->end,
+		                 tables->noise_profile, data_len, start, end);
+		compute_gain_table(tables->gain, data_len, start, end, app_config->range_gain);
+		tables->length = data_len;
+	}
+}
+
+
+/**
+ * @brief Capture one sweep, find its peak and test it against the threshold
+ *
+ * The sweep goes through the detection pipeline of the configuration, see select_pipeline(),
+ * which smooths, compensates the range gain, searches the peak and classifies interference in
+ * a single pass. A rejected sweep is replaced by a new one at once, which is much cheaper than
+ * letting it through and running the -d loop on a wrong result. After MAX_REJECTED_SWEEPS
+ * rejections in a row the last sweep is used anyway, so persistent interference cannot stop
+ * the measurement. With a model loaded the decision is made by the model from the features
+ * of the sweep, see model_features(), instead of the threshold test of the pipeline.
+ *
+ * @param[in]     app_config Configuration data
+ * @param[in,out] segment The range segment with its service instance, calibration data used for threshold
+ *                and noise profile, and per sample tables, recomputed if the sweep length changes
+ * @param[out]    sweep_data Buffer for the raw sweep
+ * @param[in]     capacity Size of the buffer
+ * @param[out]    sweep_length Length of the raw sweep
+ * @param[out]    present 1 if there is a car, 0 if the parking spot is empty
+ * @param[in,out] rejected Number of rejected sweeps
+ * @returns       The strongest datapoint of the sweep
+ */
+static Datapoint get_sweep_peak(app_configuration_t *app_config, segment_t *segment, uint16_t *sweep_data, uint16_t capacity,
+                                uint16_t *sweep_length, int *present, int *rejected)
+{
+	const calibration_t  *calibration = &segment->calibration;
+	sweep_tables_t       *tables      = &segment->tables;
+	float                start        = segment->radar_config.start_range;
+	float                end          = segment->radar_config.start_range + segment->radar_config.length_range;
+	bool                 gain         = app_config->range_gain != 0;
+	detection_pipeline_t pipeline     = select_pipeline(app_config->smooth, gain, app_config->interference_check);
+	pipeline_context_t   context      = {start, end, tables->gain, tables->noise_profile,
+	                                     get_detection_threshold(calibration->avg_calib_amp, calibration->avg_amp_factor)};
+
+	for (int attempt = 0;; attempt++)
+	{
+		uint16_t data_len = get_one_sweep(&segment->radar_config, segment->service_handle, sweep_data, capacity);
+
+		*sweep_length = data_len;
+		prepare_tables(app_config, segment, data_len);
+
+		sweep_quality_t quality;
+		Datapoint       peak = pipeline(&context, sweep_data, data_len, present, &quality);
+
+		if (quality == SWEEP_OK || attempt >= MAX_REJECTED_SWEEPS)
+		{
+			if (model == NULL)
+			{
+				return peak;
+			}
+
+			float features[MODEL_FEATURE_COUNT];
+			bool  same = tables->previous_sensor == app_config->radar_config.sensor && tables->previous_length == data_len;
+
+			model_features(features, peak, sweep_data, same ? tables->previous : NULL, data_len);
+			*present = model_decide(model, features);
+
+			memcpy(tables->previous, sweep_data, data_len * sizeof(*sweep_data));
+			tables->previous_sensor = app_config->radar_config.sensor;
+			tables->previous_length = data_len;
+			return peak;
+		}
+
+		(*rejected)++;
+		if (app_config->loglevel >= ACC_LOG_LEVEL_INFO)
+		{
+			printf("Rejected sweep: %s\n", SWEEP_QUALITY_NAMES[quality]);
+		}
+	}
+}
+
+
+/**
+ * @brief Measure every range segment of a sensor and stitch the results
+ *
+ * With several segments every segment is decided with its own calibration, and its service is
+ * stopped before the next segment is measured since a sensor streams one service at a time.
+ * There is a car if any segment sees one. The peak is the strongest one of the segments seeing
+ * a car, or of all segments if none does. The sweeps of the segments are returned one after
+ * the other.
+ *
+ * @param[in,out] sensor The sensor
+ * @param[out]    sweep_data Buffer for the raw sweeps, MAX_DATA_SIZE samples
+ * @param[out]    sweep_length Total length of the raw sweeps
+ * @param[out]    present 1 if there is a car, 0 if the parking spot is empty
+ * @param[in,out] rejected Number of rejected sweeps
+ * @param[out]    segment_index Index of the segment of the peak
+ * @returns       The stitched peak
+ */
+static Datapoint get_sensor_peak(sensor_context_t *sensor, uint16_t *sweep_data, uint16_t *sweep_length, int *present, int *rejected,
+                                 unsigned int *segment_index)
+{
+	Datapoint peak   = {0, 0};
+	uint16_t  offset = 0;
+
+	*present       = 0;
+	*segment_index = 0;
+
+	for (unsigned int i = 0; i < sensor->segment_count; i++)
+	{
+		segment_t *segment = &sensor->segments[i];
+		uint16_t  length;
+		int       segment_present;
+		Datapoint segment_peak = get_sweep_peak(&sensor->config, segment, sweep_data + offset, MAX_DATA_SIZE - offset, &length,
+		                                        &segment_present, rejected);
+
+		if (sensor->segment_count > 1)
+		{
+			acc_service_deactivate(segment->service_handle);
+		}
+
+		offset += length;
+
+		if (i == 0 || segment_present > *present || (segment_present == *present && segment_peak.amp > peak.amp))
+		{
+			peak           = segment_peak;
+			*present       = segment_present;
+			*segment_index = i;
+		}
+	}
+
+	*sweep_length = offset;
+	return peak;
+}
+
+
+/**
+ * @brief Time on the monotonic clock
+ *
+ * @returns     time in seconds
+ */
+static double get_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+/**
+ * @brief Time on the wall clock, which the baseline state is saved with
+ *
+ * @returns     seconds since the epoch
+ */
+static double get_wall_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+/**
+ * @brief CPU time used by the process, including the threads of the radar libraries
+ *
+ * @returns     CPU time in seconds
+ */
+static double get_cpu_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+/**
+ * @brief Check if the sweeps of a sensor are searched across sensors
+ *
+ * --batch-search is refused with the options changing the pipeline, so only sensors
+ * calibrated with several segments, which are decided segment by segment, are left out.
+ *
+ * @param[in] sensor The sensor
+ * @returns   true if the sensor is measured with measure_sensors_batch()
+ */
+static bool batch_searchable(const sensor_context_t *sensor)
+{
+	return sensor->config.batch_search && sensor->segment_count == 1;
+}
+
+
+/**
+ * @brief Measure one sweep of every sensor and search the sweeps for peaks across sensors
+ *
+ * The sensors are measured one after the other, each service stopped before the next sensor
+ * streams, and the sweeps are gathered into a sweep batch searched in one pass, see
+ * get_max_peaks_batch(). The peaks and decisions are the ones the pipeline without smoothing,
+ * range gain and interference check gives for every sweep on its own. The time and CPU time
+ * of the search are shared evenly by the sensors.
+ *
+ * @param[in]  list The sensors, with created services, see batch_searchable()
+ * @param[in]  count Number of sensors
+ * @param[out] measurements The sweep, peak and decision of every sensor
+ */
+static void measure_sensors_batch(sensor_context_t *const *list, unsigned int count, batch_measurement_t *measurements)
+{
+	static sweep_batch_t batch;
+
+	Datapoint peaks[MAX_SENSORS];
+	int       present[MAX_SENSORS];
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	sweep_batch_clear(&batch);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		batch_measurement_t *measurement = &measurements[i];
+		segment_t           *segment     = &list[i]->segments[0];
+		const calibration_t *calibration = &segment->calibration;
+		float               start        = segment->radar_config.start_range;
+		float               end          = segment->radar_config.start_range + segment->radar_config.length_range;
+		float               threshold    = get_detection_threshold(calibration->avg_calib_amp, calibration->avg_amp_factor);
+		double              time_start   = get_time();
+		double              cpu_start    = get_cpu_time();
+
+		measurement->sweep_length = get_one_sweep(&segment->radar_config, segment->service_handle, measurement->sweep_data,
+		                                          MAX_DATA_SIZE);
+		acc_service_deactivate(segment->service_handle);
+
+		if (sweep_batch_add(&batch, measurement->sweep_data, measurement->sweep_length, start, end, threshold) < 0)
+		{
+			handle_fatal_error("Sweep too long for the search across sensors");
+		}
+
+		measurement->duration = get_time() - time_start;
+		measurement->cpu_time = get_cpu_time() - cpu_start;
+	}
+
+	double time_start = get_time();
+	double cpu_start  = get_cpu_time();
+
+	get_max_peaks_batch(&batch, peaks, present);
+
+	double duration = (get_time() - time_start) / count;
+	double cpu_time = (get_cpu_time() - cpu_start) / count;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		measurements[i].peak      = peaks[i];
+		measurements[i].present   = present[i];
+		measurements[i].duration += duration;
+		measurements[i].cpu_time += cpu_time;
+	}
+}
+
+
+/**
+ * @brief Add a measurement to the recording, if recording is enabled
+ *
+ * @param[in] app_config Configuration data
+ * @param[in] result The decision
+ * @param[in] peak The strongest datapoint of the sweep
+ * @param[in] sweep_data The raw sweep
+ * @param[in] sweep_length Length of the raw sweep
+ */
+static void record_measurement(const app_configuration_t *app_config, int result, Datapoint peak, const uint16_t *sweep_data,
+                               uint16_t sweep_length)
+{
+	if (recorder == NULL)
+	{
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	record_t record =
+	{
+		.time_ms      = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000,
+		.sensor       = app_config->radar_config.sensor,
+		.result       = result,
+		.peak_amp     = peak.amp,
+		.peak_dist    = peak.dist,
+		.sweep_length = sweep_length,
+		.sweep        = sweep_data
+	};
+
+	if (!record_append(recorder, &record))
+	{
+		handle_fatal_error("Unable to write recording");
+	}
+}
+
+
+/**
+ * @brief Open the recording, if recording is enabled
+ *
+ * The header of the recording describes the range and mode of every sensor measured, as read
+ * from the calibration files and the ROI files, so a recording made with other settings is not
+ * continued.
+ *
+ * @param[in] app_config Configuration data
+ * @param[in] count Number of sensors measured
+ */
+static void open_recording(const app_configuration_t *app_config, unsigned int count)
+{
+	record_sensor_t descriptions[MAX_SENSORS];
+
+	if (app_config->export_file_name[0] == '\0' || app_config->calibrate)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const radar_configuration_t *radar_config = &sensors[i].config.radar_config;
+
+		descriptions[i].sensor    = radar_config->sensor;
+		descriptions[i].mode      = radar_config->mode == ACQUISITION_MODE_POWER_BINS ? RECORD_MODE_POWER_BINS : RECORD_MODE_ENVELOPE;
+		descriptions[i].bin_count = radar_config->bin_count;
+		descriptions[i].start     = radar_config->start_range;
+		descriptions[i].length    = radar_config->length_range;
+	}
+
+	recorder = record_open(app_config->export_file_name, descriptions, count);
+	if (recorder == NULL)
+	{
+		handle_fatal_error("Unable to open recording, or it was recorded with other sensors, ranges or modes");
+	}
+}
+
+
+/**
+ * @brief Write the buffered measurements and close the recording, if recording is enabled
+ */
+static void close_recording(void)
+{
+	if (recorder != NULL && !record_close(recorder))
+	{
+		handle_fatal_error("Unable to write recording");
+	}
+
+	recorder = NULL;
+}
+
+
+/**
+ * @brief Take over the sensors and their state from the process owning the checkpoint, if enabled
+ *
+ * Runs before the radar system is activated, since the previous process has to release the
+ * sensors first, but after every file that can be read without the radar, so a file that
+ * cannot be read stops this process and not the running one. Like SIGTERM, SIGUSR1 ends the
+ * measurements after the current one, so the next process can take over from this one in
+ * turn, but the occupancy history is left as it is, since the next process continues it.
+ *
+ * @param[in] app_config Configuration data
+ * @returns   true if a running process was stopped
+ */
+static bool open_checkpoint(const app_configuration_t *app_config)
+{
+	if (app_config->checkpoint_name[0] == '\0')
+	{
+		return false;
+	}
+
+	checkpoint = checkpoint_open(app_config->checkpoint_name);
+	if (checkpoint == NULL)
+	{
+		handle_fatal_error("Unable to open checkpoint");
+	}
+
+	signal(SIGUSR1, request_handover);
+
+	pid_t  previous;
+	double start = get_time();
+
+	if (!checkpoint_take_over(checkpoint, TAKE_OVER_TIMEOUT, &previous))
+	{
+		handle_fatal_error("The process owning the checkpoint did not release the sensors");
+	}
+
+	if (previous != 0)
+	{
+		printf("Took over from process %d in %.0f ms\n", (int)previous, (get_time() - start) * 1000);
+	}
+
+	taken_over = previous != 0;
+	return taken_over;
+}
+
+
+/**
+ * @brief Release the checkpoint after the radar system is deactivated, if enabled
+ */
+static void close_checkpoint(void)
+{
+	if (checkpoint != NULL)
+	{
+		checkpoint_release(checkpoint);
+		checkpoint_close(checkpoint);
+	}
+
+	checkpoint = NULL;
+}
+
+
+/**
+ * @brief Get the state of a sensor left by the process taken over from
+ *
+ * @param[in] sensor Sensor id
+ * @returns   The state, or NULL if checkpoints are disabled or the sensor has not been measured
+ */
+static const checkpoint_sensor_t *resume_sensor(int sensor)
+{
+	const checkpoint_sensor_t *state = (checkpoint != NULL) ? checkpoint_sensor(checkpoint, sensor) : NULL;
+
+	if (state == NULL || state->update_time == 0)
+	{
+		return NULL;
+	}
+
+	printf("Sensor %d: resuming after %u measurements, last result %d %.0f %.3f, %.1f s old\n", sensor, state->measurements,
+	       state->result, (double)state->peak_amp, (double)state->peak_dist, get_time() - state->update_time);
+
+	return state;
+}
+
+
+/**
+ * @brief Keep the state of a sensor in the checkpoint, if enabled
+ *
+ * @param[in] sensor Sensor id
+ * @param[in] result The decision
+ * @param[in] peak The peak of the measurement
+ * @param[in] level Governor level of the sensor
+ * @param[in] cost Learned duration of a measurement [s]
+ */
+static void update_checkpoint(int sensor, int result, Datapoint peak, int level, double cost)
+{
+	checkpoint_sensor_t *state = (checkpoint != NULL) ? checkpoint_sensor(checkpoint, sensor) : NULL;
+
+	if (state == NULL)
+	{
+		return;
+	}
+
+	state->result      = result;
+	state->peak_amp    = peak.amp;
+	state->peak_dist   = peak.dist;
+	state->level       = level;
+	state->cost        = cost;
+	state->update_time = get_time();
+	state->measurements++;
+}
+
+
+/**
+ * @brief Open the occupancy history of a sensor for appending, if enabled
+ *
+ * A measurement loop that stops ends the history with an unknown result, see close_history().
+ * If a loop is started on a history that does not end with one, and no running process was
+ * taken over, the previous process died without closing the history, so an unknown result is
+ * added at the time of its last measurement in the checkpoint, or now without a checkpoint.
+ *
+ * @param[in,out] sensor The sensor, with its configuration
+ */
+static void open_history(sensor_context_t *sensor)
+{
+	history_entry_t last;
+
+	sensor->history     = NULL;
+	sensor->last_result = -1;
+
+	if (sensor->config.history_file_name[0] == '\0')
+	{
+		return;
+	}
+
+	sensor->history = history_open(sensor->config.history_file_name, true);
+	if (sensor->history == NULL)
+	{
+		handle_fatal_error("Unable to open occupancy history");
+	}
+
+	if (history_last(sensor->history, &last))
+	{
+		sensor->last_result = last.result;
+	}
+
+	if (sensor->config.loop && !taken_over && sensor->last_result != -1)
+	{
+		int                       id      = sensor->config.radar_config.sensor;
+		const checkpoint_sensor_t *state   = (checkpoint != NULL) ? checkpoint_sensor(checkpoint, id) : NULL;
+		double                    stopped = get_wall_time();
+
+		//the region does not survive a reboot, so its monotonic times are from this boot
+		if (state != NULL && state->update_time > 0)
+		{
+			stopped -= get_time() - state->update_time;
+		}
+
+		history_entry_t unknown = {.time_ms = (uint64_t)(stopped * 1000), .peak_amp = 0, .result = -1};
+
+		if (!history_append(sensor->history, &unknown))
+		{
+			handle_fatal_error("Unable to write occupancy history");
+		}
+
+		sensor->last_result = -1;
+	}
+}
+
+
+/**
+ * @brief Append the result of a sensor to its occupancy history if it changed, if enabled
+ *
+ * @param[in,out] sensor The sensor
+ * @param[in]     result The decision, -1 if unknown
+ * @param[in]     peak_amp Peak amplitude of the measurement
+ */
+static void update_history(sensor_context_t *sensor, int result, float peak_amp)
+{
+	struct timespec now;
+
+	if (sensor->history == NULL || result == sensor->last_result)
+	{
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	history_entry_t entry =
+	{
+		.time_ms  = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000,
+		.peak_amp = peak_amp,
+		.result   = result
+	};
+
+	if (!history_append(sensor->history, &entry))
+	{
+		handle_fatal_error("Unable to write occupancy history");
+	}
+
+	sensor->last_result = result;
+}
+
+
+/**
+ * @brief Close the occupancy history of a sensor, if enabled
+ *
+ * The state is unknown from when a measurement loop stops until the next process measures
+ * again, unless the next process has taken over the sensors already.
+ *
+ * @param[in,out] sensor The sensor
+ * @param[in]     stopped true if a measurement loop stopped
+ */
+static void close_history(sensor_context_t *sensor, bool stopped)
+{
+	if (sensor->history == NULL)
+	{
+		return;
+	}
+
+	if (stopped && !handover_requested)
+	{
+		update_history(sensor, -1, 0);
+	}
+
+	history_close(sensor->history);
+	sensor->history = NULL;
+}
+
+
+/**
+ * @brief Get the name of the baseline state file, <calibration-file>.bln
+ *
+ * @param[in]  app_config Configuration data
+ * @param[out] file_name Name of the state file, MAX_FILE_NAME_LENGTH + 1 characters
+ */
+static void get_baseline_file_name(const app_configuration_t *app_config, char *file_name)
+{
+	if (snprintf(file_name, MAX_FILE_NAME_LENGTH + 1, "%s.bln", app_config->calibration_file_name) > MAX_FILE_NAME_LENGTH)
+	{
+		handle_fatal_error("File name too long");
+	}
+}
+
+
+/**
+ * @brief Create the baseline estimate of a sensor and continue the saved one
+ *
+ * @param[in]  app_config Configuration data
+ * @param[in]  length Number of samples of the sweeps
+ * @param[in]  file_name Name of the state file
+ * @returns    The estimate
+ */
+static baseline_t *open_baseline(const app_configuration_t *app_config, uint16_t length, const char *file_name)
+{
+	baseline_t *baseline = baseline_create(length, BASELINE_SLOTS, app_config->baseline_hours * 3600 / BASELINE_SLOTS);
+	if (baseline == NULL)
+	{
+		handle_fatal_error("Unable to allocate baseline");
+	}
+
+	if (!baseline_load(baseline, file_name))
+	{
+		handle_fatal_error("Baseline file format error.\n");
+	}
+
+	return baseline;
+}
+
+
+/**
+ * @brief Write a calibration file with the estimated sweep of the empty spot
+ *
+ * @param[in]   app_config Configuration data
+ * @param[in]   radar_config Radar configuration the sweeps were measured with
+ * @param[in]   data The estimated sweep
+ * @param[in]   data_len Number of samples
+ */
+static void write_baseline_calibration(const app_configuration_t *app_config, const radar_configuration_t *radar_config,
+                                       const uint16_t *data, uint16_t data_len)
+{
+	char temporary_name[MAX_FILE_NAME_LENGTH + 1];
+	FILE *fout = open_calibration_file(app_config, temporary_name);
+
+	print_calibration_segment(fout, radar_config, data, data_len);
+	replace_calibration_file(app_config, fout, temporary_name);
+}
+
+
+/**
+ * @brief Calibrate from the lowest sweeps over the baseline window instead of one sweep of an empty spot
+ *
+ * Measures with the delay in between until the window is covered, see parking-baseline.h, and
+ * writes the estimate as calibration file. The spot may be occupied, as long as it is empty
+ * for a while every window. The coverage is printed for every slot, and the state is saved so
+ * a stopped calibration continues where it was.
+ *
+ * @param[in]   app_config Configuration data
+ * @returns     true if the calibration file was written, false if stopped before
+ */
+static bool learn_calibration_data(const app_configuration_t *app_config)
+{
+	const radar_configuration_t *radar_config = &app_config->radar_config;
+
+	uint16_t   data[MAX_DATA_SIZE];
+	uint16_t   data_len = 0;
+	char       file_name[MAX_FILE_NAME_LENGTH + 1];
+	baseline_t *baseline = NULL;
+	bool       done      = false;
+
+	get_baseline_file_name(app_config, file_name);
+
+	if (app_config->segment_count > 0)
+	{
+		handle_fatal_error("The baseline is estimated for a single range.\n");
+	}
+
+	acc_service_configuration_t service_configuration = create_service_configuration(radar_config);
+	acc_service_handle_t        service_handle        = create_sensor_service(radar_config, service_configuration);
+
+	signal(SIGTERM, request_stop);
+	signal(SIGINT, request_stop);
+
+	while (!stop_requested && !done)
+	{
+		uint16_t sweep[MAX_DATA_SIZE];
+		uint16_t length = get_one_sweep(radar_config, service_handle, sweep, MAX_DATA_SIZE);
+
+		if (baseline == NULL)
+		{
+			baseline = open_baseline(app_config, length, file_name);
+			data_len = length;
+		}
+
+		if (baseline_add(baseline, get_wall_time(), sweep, length))
+		{
+			float coverage;
+
+			if (!baseline_save(baseline, file_name))
+			{
+				handle_fatal_error("Unable to write baseline file");
+			}
+
+			done = baseline_get(baseline, data, &coverage);
+			printf("Baseline window %.0f%% covered\n", (double)coverage * 100);
+			fflush(stdout);
+		}
+
+		if (!done && !stop_requested)
+		{
+			sleep(app_config->time_delay);
+		}
+	}
+
+	close_sensor_service(service_handle);
+	destroy_service_configuration(radar_config, &service_configuration);
+
+	if (baseline != NULL && !baseline_save(baseline, file_name))
+	{
+		handle_fatal_error("Unable to write baseline file");
+	}
+
+	baseline_free(baseline);
+
+	if (done)
+	{
+		write_baseline_calibration(app_config, radar_config, data, data_len);
+	}
+
+	return done;
+}
+
+
+/**
+ * @brief Add a measured sweep to the baseline estimate and recalibrate, if enabled
+ *
+ * Every completed slot saves the state, and once the window is covered the calibration of the
+ * sensor and its calibration file are replaced with the estimate, so the threshold follows
+ * slow changes of the empty spot.
+ *
+ * @param[in,out] sensor The sensor
+ * @param[in]     sweep_data The raw sweep
+ * @param[in]     sweep_length Number of samples
+ */
+static void update_baseline(sensor_context_t *sensor, const uint16_t *sweep_data, uint16_t sweep_length)
+{
+	app_configuration_t *app_config = &sensor->config;
+	segment_t           *segment    = &sensor->segments[0];
+
+	uint16_t data[MAX_DATA_SIZE];
+	char     file_name[MAX_FILE_NAME_LENGTH + 1];
+	float    coverage;
+
+	if (app_config->baseline_hours <= 0)
+	{
+		return;
+	}
+
+	get_baseline_file_name(app_config, file_name);
+
+	if (sensor->baseline == NULL)
+	{
+		sensor->baseline = open_baseline(app_config, sweep_length, file_name);
+	}
+
+	if (!baseline_add(sensor->baseline, get_wall_time(), sweep_data, sweep_length))
+	{
+		return;
+	}
+
+	if (!baseline_save(sensor->baseline, file_name))
+	{
+		handle_fatal_error("Unable to write baseline file");
+	}
+
+	if (!baseline_get(sensor->baseline, data, &coverage))
+	{
+		printf("Baseline window %.0f%% covered\n", (double)coverage * 100);
+		return;
+	}
+
+	float start  = segment->radar_config.start_range;
+	float length = segment->radar_config.length_range;
+
+	set_calibration(app_config, data, sweep_length, start, length, start, length, &segment->calibration);
+	segment->tables.length = 0;
+
+	write_baseline_calibration(app_config, &segment->radar_config, data, sweep_length);
+	printf("Baseline updated, threshold %.0f\n", (double)get_detection_threshold(segment->calibration.avg_calib_amp, segment->calibration.avg_amp_factor));
+}
+
+
+/**
+ * @brief Save the baseline estimate of a sensor, if enabled
+ *
+ * @param[in,out] sensor The sensor
+ */
+static void close_baseline(sensor_context_t *sensor)
+{
+	char file_name[MAX_FILE_NAME_LENGTH + 1];
+
+	if (sensor->baseline == NULL)
+	{
+		return;
+	}
+
+	get_baseline_file_name(&sensor->config, file_name);
+	if (!baseline_save(sensor->baseline, file_name))
+	{
+		handle_fatal_error("Unable to write baseline file");
+	}
+
+	baseline_free(sensor->baseline);
+	sensor->baseline = NULL;
+}
+
+
+/**
+ * @brief Get a detection (car/empty) from the envelope or power bins data
+ *
+ * Uses algorithm car_present() on the strongest sample of each sweep. In power-bins mode
+ * the samples are the bins, so only a handful of values are transferred and searched.
+ * With phase check enabled a detection confirmed by confirm_detection() ends the measurement
+ * at once instead of waiting for two equal results, and so does a decision far from a tuned
+ * threshold. The host CPU time spent on reading and processing the sweeps is reported per
+ * sweep, since it depends on the mode and on where the sweeps are averaged.
+ *
+ * The peak position of every measurement is added to the ROI histogram and the peak amplitude
+ * to the threshold histogram of the sensor, and the sweep to the baseline estimate, if enabled.
+ *
+ * @param[in,out] sensor The sensor, with its configuration, calibration and segments
+ * @param[in]     first The first measurement if it was searched across sensors, with the services
+ *                already created, see measure_sensors_batch(), otherwise NULL
+ * @param[out]    peak The peak of the last measurement
+ * @returns       1 if there is a car, 0 if the parking spot is empty
+ */
+static int get_detection(sensor_context_t *sensor, const batch_measurement_t *first, Datapoint *peak)
+{
+	app_configuration_t   *app_config = &sensor->config;
+	roi_histogram_t       *roi        = app_config->roi ? &sensor->roi : NULL;
+	threshold_histogram_t *tuning     = app_config->tune_threshold ? &sensor->tuning : NULL;
+
+	uint16_t       sweep_data[MAX_DATA_SIZE];
+	const uint16_t *sweep;
+	uint16_t       sweep_length;
+	unsigned int   segment_index;
+	int            rejected     = 0;
+	bool           settled      = false;
+	int            result       = -2;
+	int            first_res;
+	int            measurements = 0;
+	double         cpu_time     = 0;
+
+	load_model(app_config);
+	if (first == NULL)
+	{
+		create_segment_services(sensor);
+	}
+
+	do
+	{
+		first_res = result;
+		if (first_res != -2)
+		{
+			sleep(app_config->time_delay);
+		}
+
+		Datapoint avg_peak;
+
+		if (first != NULL && measurements == 0)
+		{
+			avg_peak      = first->peak;
+			result        = first->present;
+			sweep         = first->sweep_data;
+			sweep_length  = first->sweep_length;
+			segment_index = 0;
+			cpu_time     += first->cpu_time;
+		}
+		else
+		{
+			double cpu_start = get_cpu_time();
+
+			avg_peak  = get_sensor_peak(sensor, sweep_data, &sweep_length, &result, &rejected, &segment_index);
+			sweep     = sweep_data;
+			cpu_time += get_cpu_time() - cpu_start;
+		}
+
+		measurements++;
+
+		result = tune_detection(tuning, avg_peak, result, &settled);
+		result = confirm_detection(app_config, sensor->segments[segment_index].service_handle, avg_peak, result, &settled);
+		if (roi != NULL)
+		{
+			roi_add(roi, avg_peak.dist, result == 1);
+		}
+
+		record_measurement(app_config, result, avg_peak, sweep, sweep_length);
+		update_baseline(sensor, sweep, sweep_length);
+
+		if (!app_config->batch)
+		{
+			printf("%d\n", result);
+		}
+
+		*peak = avg_peak;
+	} while (app_config->delay && first_res != result && !settled);
+
+	if (rejected > 0 && !app_config->batch)
+	{
+		printf("Rejected sweeps: %d\n", rejected);
+	}
+
+	if (!app_config->batch)
+	{
+		const radar_configuration_t *radar_config = &app_config->radar_config;
+		int                         sweeps        = (measurements * sensor->segment_count + rejected) * radar_config->nbr_of_sweeps;
+
+		printf("Host CPU per sweep: %.1f us (%s, ", cpu_time * 1e6 / sweeps, ACQUISITION_MODE_NAMES[radar_config->mode]);
+		if (radar_config->nbr_of_sweeps > 1)
+		{
+			printf("%d sweeps averaged on the %s)\n", radar_config->nbr_of_sweeps, sensor_averaging(radar_config) ? "sensor" : "host");
+		}
+		else
+		{
+			printf("single sweep)\n");
+		}
+	}
+
+	close_segment_services(sensor);
+	return result;
+}
+
+
+/**
+ * @brief Load the peak position histogram and propose, or apply, a tighter range
+ *
+ * Applying the proposal shrinks the requested range, which reduces both the data
+ * transferred from the sensor and the samples searched for every sweep.
+ *
+ * @param[in,out] app_config Configuration data, the range is updated if the proposal is applied
+ * @param[out]    roi The loaded histogram
+ */
+static void apply_roi(app_configuration_t *app_config, roi_histogram_t *roi)
+{
+	float start;
+	float length;
+
+	//peaks beyond the last bin would all be counted in it and cut the proposal there
+	if (app_config->radar_config.start_range + app_config->radar_config.length_range > ROI_MAX_DISTANCE)
+	{
+		handle_fatal_error("The ROI file covers ranges up to 2 m, the calibrated range ends beyond it.\n");
+	}
+
+	if (!roi_load(roi, app_config->roi_file_name))
+	{
+		handle_fatal_error("ROI file format error.\n");
+	}
+
+	if (!roi_propose(roi, app_config->radar_config.start_range, app_config->radar_config.length_range, &start, &length))
+	{
+		return;
+	}
+
+	if (!app_config->batch)
+	{
+		printf("Proposed range: %1.2f - %1.2f m (%.0f%% of empty peaks inside)\n", (double)start, (double)(start + length),
+		       (double)(roi_empty_share(roi, start, length) * 100));
+	}
+
+	if (app_config->roi_apply)
+	{
+		if (!app_config->batch)
+		{
+			printf("Setting start_range to %1.2f and length_range to %1.2f due to ROI file\n", (double)start, (double)length);
+		}
+
+		app_config->radar_config.start_range  = start;
+		app_config->radar_config.length_range = length;
+	}
+}
+
+
+/**
+ * @brief Load the peak amplitude histogram and show the tuned threshold
+ *
+ * @param[in]  app_config Configuration data
+ * @param[in]  calibration Calibration data giving the calibrated threshold
+ * @param[out] tuning The loaded histogram
+ */
+static void load_threshold(const app_configuration_t *app_config, const calibration_t *calibration, threshold_histogram_t *tuning)
+{
+	float reference = get_detection_threshold(calibration->avg_calib_amp, calibration->avg_amp_factor);
+
+	if (!threshold_load(tuning, app_config->threshold_file_name, reference))
+	{
+		handle_fatal_error("Threshold file format error.\n");
+	}
+
+	if (!app_config->batch && threshold_get(tuning) != reference)
+	{
+		printf("Tuned threshold: %.0f (calibrated %.0f, separation %.2f)\n", (double)threshold_get(tuning), (double)reference,
+		       (double)tuning->separation);
+	}
+}
+
+
+/**
+ * @brief Read the calibration, ROI and threshold files of a sensor
+ *
+ * @param[in,out] sensor The sensor, with its configuration
+ */
+static void load_sensor(sensor_context_t *sensor)
+{
+	read_and_calculate_threshold(&sensor->config, sensor);
+
+	if (sensor->config.roi)
+	{
+		apply_roi(&sensor->config, &sensor->roi);
 	}
 
-	//set sweep configs
-	acc_sweep_configuration_requested_range_set(sweep_configuration, app_config->radar_config.start_range, app_config->radar_config.length_range);
-	acc_sweep_configuration_repetition_mode_streaming_set(sweep_configuration, 100);
-	acc_sweep_configuration_sensor_set(sweep_configuration, app_config->radar_config.sensor);
+	if (sensor->config.tune_threshold)
+	{
+		load_threshold(&sensor->config, &sensor->segments[0].calibration, &sensor->tuning);
+	}
+}
+
 
-	//create service
-	acc_service_handle_t envelope_handle = acc_service_create(envelope_configuration);
-	if (envelope_handle == NULL)
+/**
+ * @brief Read the ROI and threshold histograms of a sensor again
+ *
+ * The process taken over from saves them after its last measurement, which ends after they
+ * were read by load_sensor(). The range proposed by the ROI is not applied again.
+ *
+ * @param[in,out] sensor The sensor
+ */
+static void reload_histograms(sensor_context_t *sensor)
+{
+	if (sensor->config.roi && !roi_load(&sensor->roi, sensor->config.roi_file_name))
 	{
-		handle_fatal_error("acc_service_create() failed.");
+		handle_fatal_error("ROI file format error.\n");
 	}
 
-	return envelope_handle;
+	if (sensor->config.tune_threshold &&
+	    !threshold_load(&sensor->tuning, sensor->config.threshold_file_name, sensor->tuning.reference))
+	{
+		handle_fatal_error("Threshold file format error.\n");
+	}
 }
 
 
 /**
- * @brief Captures one sweep of envelope data
+ * @brief Derive the configuration of one sensor in the list
  *
- * @param[in]   envelope_handle The envelope service instance
- * @param[out]  envelope_data Array with envelope data
- * @param[in]   data_length Max length of envelope data array
- * @returns     Actual length of the envelope_data array
+ * @param[in]  app_config Configuration data
+ * @param[in]  index Index of the sensor in the list
+ * @param[out] sensor_config Configuration data of the sensor, with its own calibration, ROI, threshold and history file
  */
-static uint16_t get_one_sweep(acc_service_handle_t envelope_handle, uint16_t *envelope_data, uint16_t data_length)
+static void get_sensor_configuration(const app_configuration_t *app_config, unsigned int index, app_configuration_t *sensor_config)
 {
-	//get number of samples (data length) that will be used
-	acc_service_envelope_metadata_t envelope_metadata;
+	int sensor = app_config->sensors[index];
 
-	acc_service_envelope_get_metadata(envelope_handle, &envelope_metadata);
-	uint16_t actual_data_length = min(envelope_metadata.data_length, data_length);
+	*sensor_config                     = *app_config;
+	sensor_config->radar_config.sensor = sensor;
 
-	//start doing measurements
-	acc_service_status_t service_status = acc_service_activate(envelope_handle);
-	if (service_status != ACC_SERVICE_STATUS_OK)
+	if (snprintf(sensor_config->calibration_file_name, sizeof(sensor_config->calibration_file_name), "%s.%d",
+	             app_config->calibration_file_name, sensor) >= (int)sizeof(sensor_config->calibration_file_name) ||
+	    snprintf(sensor_config->roi_file_name, sizeof(sensor_config->roi_file_name), "%s.%d",
+	             app_config->roi_file_name, sensor) >= (int)sizeof(sensor_config->roi_file_name) ||
+	    snprintf(sensor_config->threshold_file_name, sizeof(sensor_config->threshold_file_name), "%s.%d",
+	             app_config->threshold_file_name, sensor) >= (int)sizeof(sensor_config->threshold_file_name))
 	{
-		handle_fatal_error("acc_service_activate() failed.");
+		handle_fatal_error("File name too long");
 	}
 
-	//read envelope data from sensor
-	acc_service_envelope_result_info_t result_info;
+	//the history is enabled by its name
+	if (app_config->history_file_name[0] != '\0' &&
+	    snprintf(sensor_config->history_file_name, sizeof(sensor_config->history_file_name), "%s.%d",
+	             app_config->history_file_name, sensor) >= (int)sizeof(sensor_config->history_file_name))
+	{
+		handle_fatal_error("File name too long");
+	}
+}
+
 
-	service_status = acc_service_envelope_get_next(envelope_handle,
-	                                               envelope_data,
-	                                               envelope_metadata.data_length,
-	                                               &result_info);
-	if (service_status != ACC_SERVICE_STATUS_OK)
+/**
+ * @brief Read the files of the single sensor or of every sensor in the list, see load_sensor()
+ *
+ * @param[in] app_config Configuration data
+ * @return the number of sensors
+ */
+static unsigned int load_sensors(const app_configuration_t *app_config)
+{
+	if (!app_config->batch)
 	{
-		handle_fatal_error("acc_service_envelope_get_next() failed.");
+		sensors[0].config = *app_config;
+		load_sensor(&sensors[0]);
+		return 1;
 	}
 
-	return actual_data_length;
+	for (unsigned int i = 0; i < app_config->sensor_count; i++)
+	{
+		get_sensor_configuration(app_config, i, &sensors[i].config);
+		load_sensor(&sensors[i]);
+	}
+
+	return app_config->sensor_count;
 }
 
 
 /**
- * @brief Deactivate and destroy envelope service instance
+ * @brief Calibrate or measure every sensor in the list once, sharing the RSS activation
+ *
+ * Sensor n uses calibration file <calibration-file>.n, ROI file <roi-file>.n, threshold file
+ * <threshold-file>.n and occupancy history <history>.n if enabled. The files of the sensors
+ * measured are read by load_sensors() first.
+ * One line is printed per sensor: the sensor id followed by the calibration file name, or by
+ * the result, peak amplitude and peak distance.
  *
- * @param[in]   envelope_handle The envelope service instance
+ * With --batch-search the first sweep of every sensor is measured before any sensor is
+ * decided, and the sweeps are searched in one pass across sensors, see measure_sensors_batch().
+ * The measurements confirming a result with -d and -p are made sensor by sensor.
+ *
+ * @param[in] app_config Configuration data
  */
-static void close_sensor_service(acc_service_handle_t envelope_handle)
+static void run_batch(const app_configuration_t *app_config)
 {
-	acc_service_deactivate(envelope_handle);
-	acc_service_destroy(&envelope_handle);
+	static batch_measurement_t measurements[MAX_SENSORS];
+
+	sensor_context_t *searched[MAX_SENSORS];
+	int              first[MAX_SENSORS];
+	unsigned int     searched_count = 0;
+
+	for (unsigned int i = 0; i < app_config->sensor_count; i++)
+	{
+		first[i] = -1;
+		if (app_config->batch_search)
+		{
+			open_segments(&sensors[i]);
+			if (batch_searchable(&sensors[i]))
+			{
+				create_segment_services(&sensors[i]);
+				first[i]                   = searched_count;
+				searched[searched_count++] = &sensors[i];
+			}
+		}
+	}
+
+	measure_sensors_batch(searched, searched_count, measurements);
+
+	for (unsigned int i = 0; i < app_config->sensor_count; i++)
+	{
+		sensor_context_t    *context       = &sensors[i];
+		app_configuration_t *sensor_config = &context->config;
+		int                 sensor         = app_config->sensors[i];
+
+		if (app_config->calibrate)
+		{
+			get_sensor_configuration(app_config, i, sensor_config);
+			write_calibration_data(sensor_config);
+			printf("%d %s\n", sensor, sensor_config->calibration_file_name);
+			continue;
+		}
+
+		if (!app_config->batch_search)
+		{
+			open_segments(context);
+		}
+
+		open_history(context);
+
+		Datapoint peak;
+		int       result = get_detection(context, (first[i] >= 0) ? &measurements[first[i]] : NULL, &peak);
+
+		update_history(context, result, peak.amp);
+		close_history(context, false);
+
+		if (sensor_config->roi && !roi_save(&context->roi, sensor_config->roi_file_name))
+		{
+			handle_fatal_error("Unable to write ROI file");
+		}
+
+		if (sensor_config->tune_threshold && !threshold_save(&context->tuning, sensor_config->threshold_file_name))
+		{
+			handle_fatal_error("Unable to write threshold file");
+		}
+
+		close_segments(context);
+		update_checkpoint(sensor, result, peak, 0, 0);
+		printf("%d %d %.0f %.3f\n", sensor, result, (double)peak.amp, (double)peak.dist);
+	}
 }
 
 
 /**
- * @brief Capture envelope data and write to calibration file
+ * @brief Apply the averaging depth and freshness of the governor level of a scheduled sensor
  *
- * @param[in]   app_config Configuration data
- * @param[in]   envelope_configuration The envelope service configuration
+ * @param[in,out] sensor The sensor
+ * @param[in,out] tasks The tasks of the scheduler
+ * @param[in]     index Index of the sensor
+ * @param[in]     shedding Governor state of the sensor
+ * @param[out]    sweeps Averaging depth at the level
+ * @param[out]    freshness Freshness at the level [s]
  */
-static void write_calibration_data(app_configuration_t *app_config, acc_service_configuration_t envelope_configuration)
+static void apply_level(sensor_context_t *sensor, schedule_task_t *tasks, unsigned int index, const governor_sensor_t *shedding,
+                        int *sweeps, double *freshness)
 {
-	uint16_t data_len = MAX_DATA_SIZE;
-	uint16_t data[data_len];
+	governor_settings(shedding, sweeps, freshness);
+
+	sensor->config.radar_config.nbr_of_sweeps = *sweeps;
+	for (unsigned int i = 0; i < sensor->segment_count; i++)
+	{
+		sensor->segments[i].radar_config.nbr_of_sweeps = *sweeps;
+	}
+
+	schedule_set_freshness(tasks, index, *freshness);
+}
 
-	FILE *fout;
 
-	fout = fopen(app_config->calibration_file_name, "w");
+/**
+ * @brief Measure the sensors in the list continuously, earliest deadline first
+ *
+ * Every sensor has its own calibration, ROI and threshold file, read by load_sensors() first,
+ * and its own service instance. The result of a sensor
+ * should never be older than its freshness, the delay unless given in the sensor list. One
+ * line is printed per measurement like in run_batch(), followed by the lateness if the
+ * deadline was missed. A summary with the deadline misses of every sensor is printed when
+ * the loop is stopped.
+ *
+ * With the governor enabled the averaging depth and freshness of the least critical sensors
+ * are reduced while the gateway is overloaded, see parking-governor.h, and every change is
+ * printed with the load that caused it.
+ *
+ * With --batch-search every sensor released when the next one is selected is measured along
+ * with it, and the sweeps are searched in one pass across sensors, see measure_sensors_batch().
+ * The results are then completed earliest deadline first, and the search is counted in the
+ * cost of every sensor by its share.
+ *
+ * @param[in] app_config Configuration data
+ */
+static void run_scheduled(const app_configuration_t *app_config)
+{
+	static schedule_task_t     tasks[MAX_SENSORS];
+	static governor_sensor_t   shedding[MAX_SENSORS];
+	static batch_measurement_t measurements[MAX_SENSORS];
+
+	uint16_t         sweep_data[MAX_DATA_SIZE];
+	uint16_t         sweep_length;
+	double           freshness[MAX_SENSORS];
+	int              sweeps[MAX_SENSORS];
+	double           bus_share[MAX_SENSORS];
+	unsigned int     released[MAX_SENSORS];
+	unsigned int     round[MAX_SENSORS];
+	sensor_context_t *searched[MAX_SENSORS];
+	governor_t       governor;
+	unsigned int     count          = app_config->sensor_count;
+	bool             overload_shown = false;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		sensor_context_t *sensor = &sensors[i];
 
-	acc_service_handle_t envelope_handle = create_sensor_service(app_config, envelope_configuration);
+		open_segments(sensor);
+		create_segment_services(sensor);
+		open_history(sensor);
+		freshness[i] = (app_config->freshness[i] > 0) ? app_config->freshness[i] : app_config->time_delay;
+		sweeps[i]    = sensor->config.radar_config.nbr_of_sweeps;
+	}
 
-	data_len = get_one_sweep(envelope_handle, data, data_len);
+	schedule_init(tasks, freshness, count, get_time());
+	governor_init(&governor, shedding, sweeps, freshness, count, app_config->shed_policy, app_config->cpu_budget,
+	              app_config->bus_budget, get_time());
 
-	if (fout == NULL)
+	//continue with the levels and the deadlines of the process taken over from
+	for (unsigned int i = 0; i < count; i++)
 	{
-		handle_fatal_error("Unable to write calibration data to file\n");
+		const checkpoint_sensor_t *state = resume_sensor(app_config->sensors[i]);
+
+		if (state == NULL)
+		{
+			continue;
+		}
+
+		if (app_config->governor && state->level > 0)
+		{
+			shedding[i].level = (state->level < shedding[i].max_level) ? state->level : shedding[i].max_level;
+			apply_level(&sensors[i], tasks, i, &shedding[i], &sweeps[i], &freshness[i]);
+		}
+
+		schedule_resume(tasks, count, i, state->cost, state->update_time);
 	}
 
-	fprintf(fout, "start %f\n", (double)app_config->radar_config.start_range);
-	fprintf(fout, "length %f\n", (double)app_config->radar_config.length_range);
-	fprintf(fout, "n %u\n", data_len);
+	while (!stop_requested)
+	{
+		double       wait;
+		double       now         = get_time();
+		int          next        = schedule_next(tasks, count, now, &wait);
+		unsigned int round_count = 1;
 
-	for (int i = 0; i < data_len; i++)
+		load_model(app_config);
+
+		if (next < 0)
+		{
+			struct timespec delay = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+			nanosleep(&delay, NULL);
+			continue;
+		}
+
+		//the released sensors searched across sensors are measured before any of them is decided
+		if (batch_searchable(&sensors[next]))
+		{
+			unsigned int released_count = schedule_released(tasks, count, now, released);
+
+			round_count = 0;
+			for (unsigned int i = 0; i < released_count; i++)
+			{
+				if (batch_searchable(&sensors[released[i]]))
+				{
+					round[round_count]    = released[i];
+					searched[round_count] = &sensors[released[i]];
+					round_count++;
+				}
+			}
+
+			measure_sensors_batch(searched, round_count, measurements);
+		}
+		else
+		{
+			round[0] = next;
+		}
+
+		for (unsigned int k = 0; k < round_count; k++)
+		{
+			sensor_context_t *sensor  = &sensors[round[k]];
+			bool             batched  = batch_searchable(sensor);
+			int              rejected = 0;
+			bool             settled  = false;
+			const uint16_t   *sweep   = sweep_data;
+			int              result;
+			unsigned int     segment_index;
+			double           start;
+			Datapoint        peak;
+
+			next = round[k];
+			if (batched)
+			{
+				start         = get_time() - measurements[k].duration;
+				peak          = measurements[k].peak;
+				result        = measurements[k].present;
+				sweep         = measurements[k].sweep_data;
+				sweep_length  = measurements[k].sweep_length;
+				segment_index = 0;
+			}
+			else
+			{
+				start = get_time();
+				peak  = get_sensor_peak(sensor, sweep_data, &sweep_length, &result, &rejected, &segment_index);
+			}
+
+			result = tune_detection(sensor->config.tune_threshold ? &sensor->tuning : NULL, peak, result, &settled);
+			result = confirm_detection(&sensor->config, sensor->segments[segment_index].service_handle, peak, result, &settled);
+
+			//stop streaming so the next sensor has the bus to itself, several segments and sweeps searched across
+			//sensors are stopped after every sweep already
+			if (!batched && sensor->segment_count == 1)
+			{
+				acc_service_deactivate(sensor->segments[0].service_handle);
+			}
+
+			//the export is written after the measurement is timed, so it does not count in the learned cost
+			double deadline = tasks[next].deadline;
+			double end      = get_time();
+			bool   missed   = schedule_complete(tasks, count, next, start, end);
+
+			record_measurement(&sensor->config, result, peak, sweep, sweep_length);
+
+			if (sensor->config.roi)
+			{
+				roi_add(&sensor->roi, peak.dist, result == 1);
+				if (!roi_save(&sensor->roi, sensor->config.roi_file_name))
+				{
+					handle_fatal_error("Unable to write ROI file");
+				}
+			}
+
+			if (sensor->config.tune_threshold && !threshold_save(&sensor->tuning, sensor->config.threshold_file_name))
+			{
+				handle_fatal_error("Unable to write threshold file");
+			}
+
+			if (missed)
+			{
+				printf("%d %d %.0f %.3f late %.3f\n", app_config->sensors[next], result, (double)peak.amp, (double)peak.dist,
+				       end - deadline);
+			}
+			else
+			{
+				printf("%d %d %.0f %.3f\n", app_config->sensors[next], result, (double)peak.amp, (double)peak.dist);
+			}
+
+			update_checkpoint(app_config->sensors[next], result, peak, shedding[next].level, tasks[next].cost);
+			update_history(sensor, result, peak.amp);
+			fflush(stdout);
+
+			double utilization = schedule_utilization(tasks, count);
+			if (utilization > 1 && !overload_shown)
+			{
+				printf("Bus utilization %.2f, the freshness of all sensors cannot be met\n", utilization);
+				overload_shown = true;
+			}
+
+			if (app_config->governor)
+			{
+				for (unsigned int i = 0; i < count; i++)
+				{
+					bus_share[i] = tasks[i].cost / tasks[i].freshness;
+				}
+
+				int changed = governor_update(&governor, shedding, bus_share, count, end);
+				if (changed >= 0)
+				{
+					int    changed_sweeps;
+					double changed_freshness;
+
+					apply_level(&sensors[changed], tasks, changed, &shedding[changed], &changed_sweeps, &changed_freshness);
+
+					printf("Load CPU %.2f bus %.3f: sensor %d at level %d, %d sweeps, freshness %.2f s\n", governor.cpu, governor.bus,
+					       app_config->sensors[changed], shedding[changed].level, changed_sweeps, changed_freshness);
+				}
+			}
+		}
+	}
+
+	printf("Bus utilization %.2f\n", schedule_utilization(tasks, count));
+
+	if (app_config->governor)
 	{
-		fprintf(fout, "%d ", data[i]);
+		printf("Governor: %u degradations, %u restorations\n", governor.degradations, governor.restorations);
 	}
 
-	fclose(fout);
-	close_sensor_service(envelope_handle);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		printf("Sensor %d: %u measurements, freshness %.2f s, cost %.2f ms, %u deadline misses, max %.3f s late\n",
+		       app_config->sensors[i], tasks[i].measurements, tasks[i].freshness, tasks[i].cost * 1000, tasks[i].misses,
+		       tasks[i].max_lateness);
+
+		close_segment_services(&sensors[i]);
+		close_segments(&sensors[i]);
+		close_history(&sensors[i], true);
+	}
 }
 
 
 /**
- * @brief Get a detection (car/empty) from the envelope data
+ * @brief Count the vehicles passing under the sensor until stopped
  *
- * Uses algorithm car_present() or car_present2() depending on input arguments in main()
+ * The service is activated once and streams at FREQUENCY, and every sweep goes through the
+ * detection pipeline of the configuration and the pass counter, see parking-pass.h. Nothing
+ * but the events is printed, so the loop keeps up with the sensor: one line per vehicle with
+ * the count, the peak distance and amplitude and the latency since the first sweep seeing it,
+ * and one line when it has left. Every sweep is used as it is, so --sweeps does not apply.
+ * Sweeps dropped by the host are found from the sequence numbers and reported, since a pass
+ * shorter than the drop could be missed. A summary is printed when the counting is stopped.
  *
- * @param[in]   app_config Configuration data
- * @param[in]   envelope_configuration The envelope service configuration
- * @param[out]  avg_calib_amp The average amplitude value from the threshold data
- * @param[out]  avg_amp_factor = peak_amp/avg_calib_amp
- * @returns     1 if there is a car, 0 if the parking spot is empty
+ * @param[in,out] sensor The sensor, with its calibration
  */
-static int get_detection(app_configuration_t *app_config, acc_service_configuration_t envelope_configuration, float *avg_calib_amp,
-                         float *avg_amp_factor)
+static void run_pass_count(sensor_context_t *sensor)
 {
-	uint16_t data_len = MAX_DATA_SIZE;
-	uint16_t envelope_data[data_len];
+	app_configuration_t  *app_config  = &sensor->config;
+	segment_t            *segment     = &sensor->segments[0];
+	const calibration_t  *calibration = &segment->calibration;
+	float                start        = segment->radar_config.start_range;
+	float                end          = segment->radar_config.start_range + segment->radar_config.length_range;
+	detection_pipeline_t pipeline     = select_pipeline(app_config->smooth, app_config->range_gain != 0, app_config->interference_check);
+	float                threshold    = get_detection_threshold(calibration->avg_calib_amp, calibration->avg_amp_factor);
+	pipeline_context_t   context      = {start, end, segment->tables.gain, segment->tables.noise_profile, threshold};
+
+	uint16_t       sweep_data[MAX_DATA_SIZE];
+	pass_counter_t counter;
+	uint32_t       sequence_number;
+	uint32_t       previous_number = 0;
+	uint64_t       sweeps          = 0;
+	uint64_t       dropped         = 0;
+	uint64_t       rejected        = 0;
+	double         max_latency     = 0;
+	double         latency_sum     = 0;
+
+	if (sensor->segment_count > 1)
+	{
+		handle_fatal_error("Passes are counted in a single range.\n");
+	}
+
+	pass_init(&counter, threshold, PASS_HYSTERESIS, PASS_ENTER_SWEEPS, app_config->pass_gap);
 
-	acc_service_handle_t envelope_handle = create_sensor_service(app_config, envelope_configuration);
+	signal(SIGTERM, request_stop);
+	signal(SIGINT, request_stop);
+
+	create_segment_services(sensor);
+	if (acc_service_activate(segment->service_handle) != ACC_SERVICE_STATUS_OK)
+	{
+		handle_fatal_error("acc_service_activate() failed.");
+	}
 
-	data_len = get_one_sweep(envelope_handle, envelope_data, MAX_DATA_SIZE);
-	Datapoint data[data_len];
-	format_data(data, envelope_data, data_len, app_config->radar_config.start_range,
-	            app_config->radar_config.start_range + app_config->radar_config.length_range);
+	printf("Counting passes, threshold %.0f, minimum gap %.2f s\n", (double)threshold, (double)app_config->pass_gap);
+	fflush(stdout);
 
-	Datapoint avg_peak = get_max_peak(data, data_len);
+	double start_time = get_time();
 
-	int result = -2;
-	result = car_present(avg_peak.amp, *avg_calib_amp, *avg_amp_factor);
-	printf("%d\n", result);
-	if (app_config->delay)
+	while (!stop_requested)
 	{
-		int first_res = -2;
+		uint16_t data_len = get_next_sweep(&segment->radar_config, segment->service_handle, sweep_data, MAX_DATA_SIZE, &sequence_number);
+		double   now      = get_time();
 
-		while (first_res != result)
+		if (sweeps > 0 && sequence_number - previous_number > 1)
 		{
-			first_res = result;
-			sleep(app_config->time_delay);
+			dropped += sequence_number - previous_number - 1;
+			printf("Dropped %u sweeps\n", (unsigned int)(sequence_number - previous_number - 1));
+		}
 
-			data_len = get_one_sweep(envelope_handle, envelope_data, data_len);
-			format_data(data, envelope_data, data_len, app_config->radar_config.start_range,
-			            app_config->radar_config.start_range + app_config->radar_config.length_range);
+		previous_number = sequence_number;
+		sweeps++;
 
-			avg_peak = get_max_peak(data, data_len);
+		prepare_tables(app_config, segment, data_len);
 
-			result = car_present(avg_peak.amp, *avg_calib_amp, *avg_amp_factor);
-			printf("%d\n", result);
+		sweep_quality_t quality;
+		int             present;
+		Datapoint       peak = pipeline(&context, sweep_data, data_len, &present, &quality);
+
+		if (quality != SWEEP_OK)
+		{
+			rejected++;
+			continue;
+		}
+
+		pass_event_t event = pass_update(&counter, peak.amp, now);
+
+		if (event == PASS_ENTER)
+		{
+			double latency = get_time() - counter.edge_time;
+
+			latency_sum += latency;
+			if (latency > max_latency)
+			{
+				max_latency = latency;
+			}
+
+			printf("pass %" PRIu64 " %.3f %.0f %.1f ms\n", counter.passes, (double)peak.dist, (double)peak.amp, latency * 1000);
+			fflush(stdout);
+		}
+		else if (event == PASS_EXIT)
+		{
+			printf("clear %.2f s\n", counter.edge_time - counter.enter_time);
+			fflush(stdout);
 		}
 	}
 
-	close_sensor_service(envelope_handle);
-	return result;
+	double elapsed = get_time() - start_time;
+
+	printf("Passes: %" PRIu64 " in %.0f s, %" PRIu64 " sweeps at %.1f Hz, %" PRIu64 " dropped, %" PRIu64 " rejected\n",
+	       counter.passes, elapsed, sweeps, (elapsed > 0) ? sweeps / elapsed : 0, dropped, rejected);
+	if (counter.passes > 0)
+	{
+		printf("Latency: mean %.1f ms, max %.1f ms\n", latency_sum * 1000 / counter.passes, max_latency * 1000);
+	}
+
+	close_segment_services(sensor);
 }
 
 
 int main(int argc, char *argv[])
 {
-	float     avg_calib_amp = 0;
-	Datapoint peak_amp;
-
-	peak_amp.amp  = 0;
-	peak_amp.dist = 0;
-	float avg_amp_factor = 0;
+	sensor_context_t *sensor = &sensors[0];
+	unsigned int     count   = 0;
 
 	app_configuration_t app_config;
 	parse_options(argc, argv, &app_config);
 
-	printf("start ref_app\n");
+	if (!app_config.batch)
+	{
+		printf("start ref_app\n");
+	}
+
+	if (!app_config.calibrate && !app_config.read_calibration_file)
+	{
+		printf("Please specify calibration file.\n");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	//read everything that does not need the radar before the sensors are taken over
+	if (!app_config.calibrate)
+	{
+		load_model(&app_config);
+		signal(SIGHUP, request_reload);
+
+		count = load_sensors(&app_config);
+	}
+
+	if (!app_config.calibrate && !app_config.batch)
+	{
+		if (sensor->config.segment_count > 0)
+		{
+			for (unsigned int i = 0; i < sensor->config.segment_count; i++)
+			{
+				printf("Segment %u: %f - %f\n", i, (double)sensor->config.segments[i].start,
+				       (double)(sensor->config.segments[i].start + sensor->config.segments[i].length));
+			}
+		}
+		else
+		{
+			printf("Start range: %f\n", (double)sensor->config.radar_config.start_range);
+		}
+
+		if (app_config.baseline_hours > 0 && sensor->config.segment_count > 0)
+		{
+			handle_fatal_error("The baseline is estimated for a single range.\n");
+		}
+	}
 
-	if (!acc_driver_hal_init())
+	if (open_checkpoint(&app_config))
 	{
-		handle_fatal_error("acc_driver_hal_init() failed");
+		for (unsigned int i = 0; i < count; i++)
+		{
+			reload_histograms(&sensors[i]);
+		}
 	}
 
-	hal = acc_driver_hal_get_implementation();
+	if (!board_init(app_config.board, &hal))
+	{
+		fprintf(stderr, "Linked boards: ");
+		board_print_names(stderr);
+		fprintf(stderr, "\n");
+		handle_fatal_error("board_init() failed");
+	}
 
 	if (!acc_rss_activate_with_hal(&hal))
 	{
 		handle_fatal_error("acc_rss_activate() failed");
 	}
 
-	printf("rss_activated\n");
+	//the process taken over from appends to the recording until it stops
+	open_recording(&app_config, count);
 
-	//create envelope configuration
-	acc_service_configuration_t envelope_configuration = acc_service_envelope_configuration_create();
-	if (envelope_configuration == NULL)
+	if (app_config.batch)
 	{
-		handle_fatal_error("acc_service_envelope_configuration_create() failed.");
+		if (app_config.loop)
+		{
+			signal(SIGTERM, request_stop);
+			signal(SIGINT, request_stop);
+			run_scheduled(&app_config);
+		}
+		else
+		{
+			run_batch(&app_config);
+		}
+
+		close_recording();
+		model_free(model);
+		acc_rss_deactivate();
+		close_checkpoint();
+
+		return EXIT_SUCCESS;
 	}
 
+	printf("rss_activated\n");
+
 	if (app_config.calibrate)
 	{
-		write_calibration_data(&app_config, envelope_configuration);
-		printf("Calibration done. Saved in file %s\n", app_config.calibration_file_name);
+		if (app_config.baseline_hours > 0)
+		{
+			if (!learn_calibration_data(&app_config))
+			{
+				printf("Calibration stopped, continues with the same options\n");
+
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			write_calibration_data(&app_config);
+		}
 
-		acc_service_envelope_configuration_destroy(&envelope_configuration);
+		printf("Calibration done. Saved in file %s\n", app_config.calibration_file_name);
 
 		return EXIT_SUCCESS;
 	}
 
-	if (app_config.read_calibration_file)
+	//create the configurations after reading calibration, since it decides the acquisition mode and segments
+	open_segments(sensor);
+
+	if (app_config.pass_count)
 	{
-		read_and_calculate_threshold(&app_config, &avg_calib_amp, &peak_amp, &avg_amp_factor);
+		run_pass_count(sensor);
+		close_segments(sensor);
+
+		close_recording();
+		model_free(model);
+		acc_rss_deactivate();
+		close_checkpoint();
+
+		return EXIT_SUCCESS;
 	}
-	else
+
+	open_history(sensor);
+
+	shm_results_t *results = NULL;
+
+	if (app_config.shm_name[0] != '\0')
 	{
-		printf("Please specify calibration file.\n");
-		print_usage(argv[0]);
-		acc_service_envelope_configuration_destroy(&envelope_configuration);
-		exit(EXIT_FAILURE);
+		results = shm_results_open(app_config.shm_name, false);
+		if (results == NULL)
+		{
+			handle_fatal_error("Unable to open shared memory results");
+		}
 	}
 
-	printf("Start range: %f\n", (double)app_config.radar_config.start_range);
+	if (app_config.loop)
+	{
+		signal(SIGTERM, request_stop);
+		signal(SIGINT, request_stop);
+	}
 
-	int result = get_detection(&app_config, envelope_configuration, &avg_calib_amp, &avg_amp_factor);
+	//keep the delay since the last detection of the process taken over from
+	const checkpoint_sensor_t *resumed = resume_sensor(app_config.radar_config.sensor);
 
-	acc_service_envelope_configuration_destroy(&envelope_configuration);
+	if (resumed != NULL && app_config.loop)
+	{
+		double wait = resumed->update_time + app_config.time_delay - get_time();
 
-	acc_rss_deactivate();
+		if (wait > 0)
+		{
+			struct timespec delay = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+			nanosleep(&delay, NULL);
+		}
+	}
 
-	//print results
-	if (result == 1)
+	do
 	{
-		printf("\nCar detected.\n");
-	}
-	else
+		Datapoint peak;
+		int       result = get_detection(sensor, NULL, &peak);
+
+		update_checkpoint(app_config.radar_config.sensor, result, peak, 0, 0);
+		update_history(sensor, result, peak.amp);
+
+		if (app_config.roi && !roi_save(&sensor->roi, app_config.roi_file_name))
+		{
+			handle_fatal_error("Unable to write ROI file");
+		}
+
+		if (app_config.tune_threshold && !threshold_save(&sensor->tuning, app_config.threshold_file_name))
+		{
+			handle_fatal_error("Unable to write threshold file");
+		}
+
+		if (results != NULL)
+		{
+			shm_results_publish(results, app_config.shm_slot, result, peak.amp, peak.dist);
+		}
+
+		//print results
+		if (result == 1)
+		{
+			printf("\nCar detected.\n");
+		}
+		else
+		{
+			printf("\nNothing detected.\n");
+		}
+
+		fflush(stdout);
+
+		if (app_config.loop && !stop_requested)
+		{
+			sleep(app_config.time_delay);
+		}
+	} while (app_config.loop && !stop_requested);
+
+	if (results != NULL)
 	{
-		printf("\nNothing detected.\n");
+		shm_results_close(results);
 	}
 
+	close_segments(sensor);
+	close_history(sensor, app_config.loop);
+	close_baseline(sensor);
+
+	close_recording();
+	model_free(model);
+	acc_rss_deactivate();
+	close_checkpoint();
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,381 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <complex.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "acc_service.h"
+#include "acc_service_envelope.h"
+#include "acc_service_iq.h"
+#include "acc_service_power_bins.h"
+#include "acc_sweep_configuration.h"
+
+#include "parking-sensor.h"
+
+
+static const int   PHASE_CHECK_SWEEPS  = 20;
+static const float PHASE_CHECK_LENGTH  = 0.06;
+static const int   STREAMING_FREQUENCY = 100;
+
+const char *ACQUISITION_MODE_NAMES[] = {"envelope", "power-bins"};
+
+
+void handle_fatal_error(char *message)
+{
+	fprintf(stderr, "Fatal error: %s\n", message);
+	exit(EXIT_FAILURE);
+}
+
+
+bool parse_acquisition_mode(const char *name, acquisition_mode_t *mode)
+{
+	for (unsigned int i = 0; i <= ACQUISITION_MODE_POWER_BINS; i++)
+	{
+		if (strcmp(name, ACQUISITION_MODE_NAMES[i]) == 0)
+		{
+			*mode = (acquisition_mode_t)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+acc_service_configuration_t create_service_configuration(const radar_configuration_t *radar_config)
+{
+	acc_service_configuration_t service_configuration = NULL;
+
+	switch (radar_config->mode)
+	{
+		case ACQUISITION_MODE_ENVELOPE:
+		{
+			service_configuration = acc_service_envelope_configuration_create();
+			if (service_configuration == NULL)
+			{
+				handle_fatal_error("acc_service_envelope_configuration_create() failed.");
+			}
+
+			break;
+		}
+
+		case ACQUISITION_MODE_POWER_BINS:
+		{
+			service_configuration = acc_service_power_bins_configuration_create();
+			if (service_configuration == NULL)
+			{
+				handle_fatal_error("acc_service_power_bins_configuration_create() failed.");
+			}
+
+			break;
+		}
+	}
+
+	return service_configuration;
+}
+
+
+void destroy_service_configuration(const radar_configuration_t *radar_config, acc_service_configuration_t *service_configuration)
+{
+	switch (radar_config->mode)
+	{
+		case ACQUISITION_MODE_ENVELOPE:
+			acc_service_envelope_configuration_destroy(service_configuration);
+			break;
+		case ACQUISITION_MODE_POWER_BINS:
+			acc_service_power_bins_configuration_destroy(service_configuration);
+			break;
+	}
+}
+
+
+acc_service_handle_t create_sensor_service(const radar_configuration_t *radar_config, acc_service_configuration_t service_configuration)
+{
+	//set service specific settings
+	switch (radar_config->mode)
+	{
+		case ACQUISITION_MODE_ENVELOPE:
+			acc_service_envelope_profile_set(service_configuration, ACC_SERVICE_ENVELOPE_PROFILE_MAXIMIZE_SNR);
+			if (radar_config->running_average_factor >= 0)
+			{
+				acc_service_envelope_running_average_factor_set(service_configuration, radar_config->running_average_factor);
+			}
+
+			break;
+		case ACQUISITION_MODE_POWER_BINS:
+			acc_service_power_bins_requested_bin_count_set(service_configuration, radar_config->bin_count);
+			break;
+	}
+
+	//create sweep configuration
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(service_configuration);
+	if (sweep_configuration == NULL)
+	{
+		handle_fatal_error("Sweep configuration not available");
+	}
+
+	//set sweep configs
+	acc_sweep_configuration_requested_range_set(sweep_configuration, radar_config->start_range, radar_config->length_range);
+	acc_sweep_configuration_repetition_mode_streaming_set(sweep_configuration, STREAMING_FREQUENCY);
+	acc_sweep_configuration_sensor_set(sweep_configuration, radar_config->sensor);
+
+	//create service
+	acc_service_handle_t service_handle = acc_service_create(service_configuration);
+	if (service_handle == NULL)
+	{
+		handle_fatal_error("acc_service_create() failed.");
+	}
+
+	return service_handle;
+}
+
+
+/**
+ * @brief Reads the next sweep of envelope data from an active service
+ *
+ * @param[in]   envelope_handle The envelope service instance
+ * @param[out]  envelope_data Array with envelope data
+ * @param[in]   data_length Max length of envelope data array
+ * @param[out]  sequence_number Sequence number of the sweep
+ * @returns     Actual length of the envelope_data array
+ */
+static uint16_t read_envelope_sweep(acc_service_handle_t envelope_handle, uint16_t *envelope_data, uint16_t data_length,
+                                    uint32_t *sequence_number)
+{
+	//get number of samples (data length) that will be used
+	acc_service_envelope_metadata_t envelope_metadata;
+
+	acc_service_envelope_get_metadata(envelope_handle, &envelope_metadata);
+	uint16_t actual_data_length = min(envelope_metadata.data_length, data_length);
+
+	//read envelope data from sensor
+	acc_service_envelope_result_info_t result_info;
+
+	acc_service_status_t service_status = acc_service_envelope_get_next(envelope_handle,
+	                                               envelope_data,
+	                                               envelope_metadata.data_length,
+	                                               &result_info);
+	if (service_status != ACC_SERVICE_STATUS_OK)
+	{
+		handle_fatal_error("acc_service_envelope_get_next() failed.");
+	}
+
+	*sequence_number = result_info.sequence_number;
+	return actual_data_length;
+}
+
+
+/**
+ * @brief Reads the next sweep of power bins data from an active service
+ *
+ * @param[in]   power_bins_handle The power bins service instance
+ * @param[out]  power_bins_data Array with power bins data
+ * @param[in]   data_length Max length of power bins data array
+ * @param[out]  sequence_number Sequence number of the sweep
+ * @returns     Actual length of the power_bins_data array
+ */
+static uint16_t read_power_bins_sweep(acc_service_handle_t power_bins_handle, uint16_t *power_bins_data, uint16_t data_length,
+                                      uint32_t *sequence_number)
+{
+	//get number of bins that will be used
+	acc_service_power_bins_metadata_t power_bins_metadata;
+
+	acc_service_power_bins_get_metadata(power_bins_handle, &power_bins_metadata);
+	uint16_t actual_data_length = min(power_bins_metadata.actual_bin_count, data_length);
+
+	//read power bins data from sensor
+	acc_service_power_bins_result_info_t result_info;
+
+	acc_service_status_t service_status = acc_service_power_bins_get_next(power_bins_handle,
+	                                                 power_bins_data,
+	                                                 power_bins_metadata.actual_bin_count,
+	                                                 &result_info);
+	if (service_status != ACC_SERVICE_STATUS_OK)
+	{
+		handle_fatal_error("acc_service_power_bins_get_next() failed.");
+	}
+
+	*sequence_number = result_info.sequence_number;
+	return actual_data_length;
+}
+
+
+/**
+ * @brief Reads the next sweep from an active service of the selected acquisition mode
+ *
+ * @param[in]   radar_config Radar configuration
+ * @param[in]   service_handle The service instance
+ * @param[out]  data Array with envelope or power bins data
+ * @param[in]   data_length Max length of data array
+ * @param[out]  sequence_number Sequence number of the sweep
+ * @returns     Actual length of the data array
+ */
+static uint16_t read_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data, uint16_t data_length,
+                           uint32_t *sequence_number)
+{
+	switch (radar_config->mode)
+	{
+		case ACQUISITION_MODE_POWER_BINS:
+			return read_power_bins_sweep(service_handle, data, data_length, sequence_number);
+		case ACQUISITION_MODE_ENVELOPE:
+		default:
+			return read_envelope_sweep(service_handle, data, data_length, sequence_number);
+	}
+}
+
+
+bool sensor_averaging(const radar_configuration_t *radar_config)
+{
+	return radar_config->mode == ACQUISITION_MODE_ENVELOPE && radar_config->running_average_factor > 0;
+}
+
+
+uint16_t get_one_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data, uint16_t data_length)
+{
+	uint32_t sequence_number;
+
+	//start doing measurements
+	acc_service_status_t service_status = acc_service_activate(service_handle);
+	if (service_status != ACC_SERVICE_STATUS_OK)
+	{
+		handle_fatal_error("acc_service_activate() failed.");
+	}
+
+	//the sensor keeps its running average while it streams, so the sweeps in between are not
+	//transferred: the host waits until the sensor has measured all but one of them and reads
+	//the last one
+	if (sensor_averaging(radar_config) && radar_config->nbr_of_sweeps > 1)
+	{
+		int             sweeps = radar_config->nbr_of_sweeps - 1;
+		struct timespec time   = {sweeps / STREAMING_FREQUENCY, sweeps % STREAMING_FREQUENCY * (1000000000L / STREAMING_FREQUENCY)};
+
+		while (nanosleep(&time, &time) != 0)
+		{
+		}
+	}
+
+	uint16_t actual_data_length = read_sweep(radar_config, service_handle, data, data_length, &sequence_number);
+
+	if (radar_config->nbr_of_sweeps <= 1 || sensor_averaging(radar_config))
+	{
+		return actual_data_length;
+	}
+
+	uint16_t sweep_data[data_length];
+	uint32_t sum[actual_data_length];
+
+	for (uint16_t i = 0; i < actual_data_length; i++)
+	{
+		sum[i] = data[i];
+	}
+
+	for (int sweep = 1; sweep < radar_config->nbr_of_sweeps; sweep++)
+	{
+		read_sweep(radar_config, service_handle, sweep_data, data_length, &sequence_number);
+		for (uint16_t i = 0; i < actual_data_length; i++)
+		{
+			sum[i] += sweep_data[i];
+		}
+	}
+
+	for (uint16_t i = 0; i < actual_data_length; i++)
+	{
+		data[i] = (sum[i] + radar_config->nbr_of_sweeps / 2) / radar_config->nbr_of_sweeps;
+	}
+
+	return actual_data_length;
+}
+
+
+uint16_t get_next_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data, uint16_t data_length,
+                        uint32_t *sequence_number)
+{
+	return read_sweep(radar_config, service_handle, data, data_length, sequence_number);
+}
+
+
+void close_sensor_service(acc_service_handle_t service_handle)
+{
+	acc_service_deactivate(service_handle);
+	acc_service_destroy(&service_handle);
+}
+
+
+float get_phase_stability(const radar_configuration_t *radar_config, float peak_dist)
+{
+	acc_service_configuration_t iq_configuration = acc_service_iq_configuration_create();
+	if (iq_configuration == NULL)
+	{
+		handle_fatal_error("acc_service_iq_configuration_create() failed.");
+	}
+
+	acc_service_iq_output_format_set(iq_configuration, ACC_SERVICE_IQ_OUTPUT_FORMAT_FLOAT_COMPLEX);
+
+	acc_sweep_configuration_t sweep_configuration = acc_service_get_sweep_configuration(iq_configuration);
+	if (sweep_configuration == NULL)
+	{
+		handle_fatal_error("Sweep configuration not available");
+	}
+
+	//only look at a narrow window around the peak
+	acc_sweep_configuration_requested_range_set(sweep_configuration, peak_dist - PHASE_CHECK_LENGTH / 2, PHASE_CHECK_LENGTH);
+	acc_sweep_configuration_repetition_mode_streaming_set(sweep_configuration, radar_config->frequency);
+	acc_sweep_configuration_sensor_set(sweep_configuration, radar_config->sensor);
+
+	acc_service_handle_t iq_handle = acc_service_create(iq_configuration);
+	if (iq_handle == NULL)
+	{
+		handle_fatal_error("acc_service_create() failed.");
+	}
+
+	acc_service_iq_metadata_t iq_metadata;
+	acc_service_iq_get_metadata(iq_handle, &iq_metadata);
+
+	uint16_t      data_len = min(iq_metadata.data_length, MAX_DATA_SIZE);
+	float complex iq_data[iq_metadata.data_length];
+
+	if (acc_service_activate(iq_handle) != ACC_SERVICE_STATUS_OK)
+	{
+		handle_fatal_error("acc_service_activate() failed.");
+	}
+
+	acc_service_iq_result_info_t result_info;
+	float complex                phasor_sum = 0;
+	uint16_t                     peak_index = 0;
+	int                          count      = 0;
+
+	for (int sweep = 0; sweep < PHASE_CHECK_SWEEPS; sweep++)
+	{
+		if (acc_service_iq_get_next(iq_handle, iq_data, iq_metadata.data_length, &result_info) != ACC_SERVICE_STATUS_OK)
+		{
+			handle_fatal_error("acc_service_iq_get_next() failed.");
+		}
+
+		//lock on to the strongest sample of the first sweep
+		if (sweep == 0)
+		{
+			for (uint16_t i = 1; i < data_len; i++)
+			{
+				if (cabsf(iq_data[i]) > cabsf(iq_data[peak_index]))
+				{
+					peak_index = i;
+				}
+			}
+		}
+
+		float magnitude = cabsf(iq_data[peak_index]);
+		if (magnitude > 0)
+		{
+			phasor_sum += iq_data[peak_index] / magnitude;
+			count++;
+		}
+	}
+
+	acc_service_deactivate(iq_handle);
+	acc_service_destroy(&iq_handle);
+	acc_service_iq_configuration_destroy(&iq_configuration);
+
+	return (count > 0) ? cabsf(phasor_sum) / count : 0;
+}
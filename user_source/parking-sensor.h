@@ -0,0 +1,164 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_SENSOR_H_
+#define PARKING_SENSOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "acc_service.h"
+
+
+#define MAX_DATA_SIZE (3000)
+#define MAX_MODE_NAME_LENGTH (15)
+
+/* running_average_factor that keeps the running average factor the service defaults to */
+#define RUNNING_AVERAGE_SERVICE_DEFAULT (-1.0f)
+
+
+typedef enum
+{
+	ACQUISITION_MODE_ENVELOPE,
+	ACQUISITION_MODE_POWER_BINS
+} acquisition_mode_t;
+
+extern const char *ACQUISITION_MODE_NAMES[];
+
+typedef struct
+{
+	float              start_range;
+	float              length_range;
+	int                nbr_of_sweeps;
+	int                frequency;
+	acc_sensor_id_t    sensor;
+	acquisition_mode_t mode;
+	uint16_t           bin_count;
+	float              running_average_factor;
+} radar_configuration_t;
+
+
+static inline uint16_t min(uint16_t a, uint16_t b)
+{
+	return (a < b) ? a : b;
+}
+
+
+/**
+ * @brief Handle fatal errors by printing error message and terminating the program
+ *
+ * @param[in]  message error message
+ */
+void handle_fatal_error(char *message);
+
+
+/**
+ * @brief Look up an acquisition mode by name
+ *
+ * @param[in]  name Mode name as given on the command line or in the calibration file
+ * @param[out] mode The matching acquisition mode
+ * @return true if the name is a known mode
+ */
+bool parse_acquisition_mode(const char *name, acquisition_mode_t *mode);
+
+
+/**
+ * @brief Create the service configuration matching the selected acquisition mode
+ *
+ * @param[in]   radar_config Radar configuration
+ * @returns     An envelope or power bins service configuration
+ */
+acc_service_configuration_t create_service_configuration(const radar_configuration_t *radar_config);
+
+
+/**
+ * @brief Destroy a service configuration created by create_service_configuration()
+ *
+ * @param[in]   radar_config Radar configuration
+ * @param[in]   service_configuration The service configuration to destroy
+ */
+void destroy_service_configuration(const radar_configuration_t *radar_config, acc_service_configuration_t *service_configuration);
+
+
+/**
+ * @brief Create a service instance from the service configuration
+ *
+ * @param[in]   radar_config Radar configuration
+ * @param[in]   service_configuration The envelope or power bins configuration
+ * @returns     A service instance
+ */
+acc_service_handle_t create_sensor_service(const radar_configuration_t *radar_config, acc_service_configuration_t service_configuration);
+
+
+/**
+ * @brief Check if the sensor averages the sweeps itself
+ *
+ * Only the envelope service has a running average on the sensor side. The host only leaves the
+ * averaging to the sensor when a factor was set, not with the running average of the service
+ * default.
+ *
+ * @param[in]   radar_config Radar configuration
+ * @returns     true if the sweeps are averaged by the sensor
+ */
+bool sensor_averaging(const radar_configuration_t *radar_config);
+
+
+/**
+ * @brief Captures one sweep using the service of the selected acquisition mode
+ *
+ * With nbr_of_sweeps above 1 that many sweeps are captured and averaged on the host. If the
+ * sensor averages the sweeps itself only one sweep is read, after the sensor has measured
+ * nbr_of_sweeps sweeps since activation. That is a running average, which weighs the latest
+ * sweeps most, not the mean of nbr_of_sweeps sweeps the host computes.
+ *
+ * @param[in]   radar_config Radar configuration
+ * @param[in]   service_handle The service instance
+ * @param[out]  data Array with envelope or power bins data
+ * @param[in]   data_length Max length of data array
+ * @returns     Actual length of the data array
+ */
+uint16_t get_one_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data, uint16_t data_length);
+
+
+/**
+ * @brief Read the next sweep of a streaming service, without averaging
+ *
+ * The service must be activated by the caller and stay active, so the sensor keeps streaming
+ * at the configured rate between calls. A gap in the sequence numbers means the host did not
+ * read the sweeps in time and some were dropped.
+ *
+ * @param[in]   radar_config Radar configuration
+ * @param[in]   service_handle The active service instance
+ * @param[out]  data Array with envelope or power bins data
+ * @param[in]   data_length Max length of data array
+ * @param[out]  sequence_number Sequence number of the sweep
+ * @returns     Actual length of the data array
+ */
+uint16_t get_next_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data, uint16_t data_length,
+                        uint32_t *sequence_number);
+
+
+/**
+ * @brief Deactivate and destroy service instance
+ *
+ * @param[in]   service_handle The service instance
+ */
+void close_sensor_service(acc_service_handle_t service_handle);
+
+
+/**
+ * @brief Measure phase stability at the peak with a short IQ burst
+ *
+ * A parked vehicle is a rigid reflector, so the phase at its peak stays constant from sweep
+ * to sweep. People and other moving objects give a drifting phase even when their amplitude
+ * is as high as a car's. The stability is the length of the mean unit phasor, 1.0 for a
+ * perfectly stable phase and close to 0.0 for a random one.
+ *
+ * @param[in]   radar_config Radar configuration
+ * @param[in]   peak_dist Distance to the peak found by the amplitude detection
+ * @returns     Phase stability in the range 0.0 - 1.0
+ */
+float get_phase_stability(const radar_configuration_t *radar_config, float peak_dist);
+
+
+#endif
@@ -0,0 +1,102 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking-shm.h"
+
+
+static const uint32_t SHM_MAGIC = 0x5041524b;
+
+
+shm_results_t *shm_results_open(const char *name, bool create)
+{
+	int fd = shm_open(name, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+
+	if (fd < 0)
+	{
+		return NULL;
+	}
+
+	if (create && ftruncate(fd, sizeof(shm_results_t)) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	shm_results_t *results = mmap(NULL, sizeof(shm_results_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (results == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	if (create)
+	{
+		memset(results, 0, sizeof(*results));
+		results->slot_count = SHM_MAX_WORKERS;
+		__atomic_store_n(&results->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+	}
+	else if (__atomic_load_n(&results->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC)
+	{
+		munmap(results, sizeof(shm_results_t));
+		return NULL;
+	}
+
+	return results;
+}
+
+
+void shm_results_close(shm_results_t *results)
+{
+	munmap(results, sizeof(shm_results_t));
+}
+
+
+void shm_results_publish(shm_results_t *results, unsigned int slot, int result, float peak_amp, float peak_dist)
+{
+	shm_slot_t *s = &results->slots[slot];
+
+	__atomic_add_fetch(&s->sequence, 1, __ATOMIC_ACQ_REL);
+
+	s->pid            = getpid();
+	s->result         = result;
+	s->peak_amp       = peak_amp;
+	s->peak_dist      = peak_dist;
+	s->update_time_ms = shm_time_ms();
+	s->measurements++;
+
+	__atomic_add_fetch(&s->sequence, 1, __ATOMIC_RELEASE);
+}
+
+
+void shm_results_read(const shm_results_t *results, unsigned int slot, shm_slot_t *copy)
+{
+	const shm_slot_t *s = &results->slots[slot];
+	uint32_t         before;
+	uint32_t         after;
+
+	do
+	{
+		before = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE);
+		memcpy(copy, (const void *)s, sizeof(*copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&s->sequence, __ATOMIC_RELAXED);
+	} while ((before & 1) != 0 || before != after);
+
+	copy->sequence = before;
+}
+
+
+uint64_t shm_time_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
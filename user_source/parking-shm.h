@@ -0,0 +1,89 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_SHM_H_
+#define PARKING_SHM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+#define SHM_MAX_WORKERS (16)
+
+
+/*
+ * Results shared between worker processes and the supervisor.
+ *
+ * Every worker owns one slot and is the only writer to it. Readers use the sequence number
+ * as a sequence lock: it is odd while the slot is being written and changes with every
+ * update, so a reader retries until it gets a consistent copy.
+ */
+typedef struct
+{
+	uint32_t sequence;
+	int32_t  pid;
+	int32_t  result;
+	float    peak_amp;
+	float    peak_dist;
+	uint32_t measurements;
+	uint64_t update_time_ms;
+} shm_slot_t;
+
+typedef struct
+{
+	uint32_t   magic;
+	uint32_t   slot_count;
+	shm_slot_t slots[SHM_MAX_WORKERS];
+} shm_results_t;
+
+
+/**
+ * @brief Map the shared results region
+ *
+ * @param[in] name POSIX shared memory name, e.g. "/parking"
+ * @param[in] create true to create and clear the region (supervisor), false to attach to an existing one (worker)
+ * @return the mapped region, or NULL on failure
+ */
+shm_results_t *shm_results_open(const char *name, bool create);
+
+
+/**
+ * @brief Unmap the shared results region
+ *
+ * @param[in] results The mapped region
+ */
+void shm_results_close(shm_results_t *results);
+
+
+/**
+ * @brief Publish a new result in a slot
+ *
+ * @param[in] results The mapped region
+ * @param[in] slot Slot owned by the calling worker
+ * @param[in] result Detection result
+ * @param[in] peak_amp Amplitude of the detection peak
+ * @param[in] peak_dist Distance to the detection peak
+ */
+void shm_results_publish(shm_results_t *results, unsigned int slot, int result, float peak_amp, float peak_dist);
+
+
+/**
+ * @brief Read a consistent copy of a slot
+ *
+ * @param[in]  results The mapped region
+ * @param[in]  slot Slot to read
+ * @param[out] copy The slot contents
+ */
+void shm_results_read(const shm_results_t *results, unsigned int slot, shm_slot_t *copy);
+
+
+/**
+ * @brief Milliseconds on the monotonic clock, the time base of update_time_ms
+ *
+ * @return current time
+ */
+uint64_t shm_time_ms(void);
+
+
+#endif
@@ -0,0 +1,610 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "acc_driver_hal.h"
+#include "acc_rss.h"
+#include "acc_service.h"
+#include "acc_service_envelope.h"
+#include "acc_service_iq.h"
+#include "acc_service_power_bins.h"
+#include "acc_sweep_configuration.h"
+
+#include "parking-sim.h"
+
+
+#define SIM_MAX_DATA_LENGTH     (3000)
+#define SIM_MAX_AVERAGED_SWEEPS (200)
+
+static const float SIM_SAMPLE_STEP     = 0.0005;
+static const float SIM_NOISE_FLOOR     = 80;
+static const float SIM_NOISE_SPREAD    = 40;
+static const float SIM_LEAKAGE         = 60;
+static const float SIM_LEAKAGE_LENGTH  = 0.04;
+static const float SIM_PULSE_WIDTH     = 0.02;
+static const float SIM_PASSER_BY_RATE  = 0.005;
+
+typedef enum
+{
+	SIM_SERVICE_ENVELOPE,
+	SIM_SERVICE_POWER_BINS,
+	SIM_SERVICE_IQ
+} sim_service_type_t;
+
+typedef enum
+{
+	SIM_FAULT_SPIKES,
+	SIM_FAULT_DROPOUT,
+	SIM_FAULT_SATURATION,
+	SIM_FAULT_COUNT
+} sim_fault_t;
+
+struct sim_configuration
+{
+	sim_service_type_t type;
+	float              start;
+	float              length;
+	float              frequency;
+	acc_sensor_id_t    sensor;
+	uint16_t           bin_count;
+	float              running_average_factor;
+};
+
+struct sim_service
+{
+	struct sim_configuration configuration;
+	bool                     active;
+	uint32_t                 sequence_number;
+	uint32_t                 averaged_sweeps;
+	struct timespec          activated;
+	float                    average[SIM_MAX_DATA_LENGTH];
+};
+
+typedef struct
+{
+	float  mean_occupied;
+	float  mean_empty;
+} sim_pattern_t;
+
+/* commuter, short stay, resident and rarely used spots, in seconds */
+static const sim_pattern_t SIM_PATTERNS[] =
+{
+	{9 * 3600, 15 * 3600},
+	{45 * 60, 90 * 60},
+	{20 * 3600, 3 * 3600},
+	{2 * 3600, 72 * 3600},
+};
+
+typedef struct
+{
+	bool   occupied;
+	double next_transition;
+	float  car_distance;
+	float  car_amplitude;
+	float  car_phase;
+} sim_sensor_t;
+
+static sim_sensor_t  sensors[SIM_MAX_SENSORS + 1];
+static unsigned int  sensor_count;
+static uint32_t      random_state = 1;
+static float         fault_probability;
+static bool          forced_empty;
+static double        virtual_time;
+static unsigned int  live_objects;
+static unsigned long injected_faults;
+
+
+static uint32_t sim_random(void)
+{
+	//xorshift32, cheap enough to generate noise for every sample
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+
+static float sim_uniform(float low, float high)
+{
+	return low + (high - low) * (sim_random() >> 8) / (float)(1 << 24);
+}
+
+
+static float sim_exponential(float mean)
+{
+	return -mean * logf(1.0f - sim_uniform(0, 0.999f));
+}
+
+
+static void sim_park_car(sim_sensor_t *sensor)
+{
+	sensor->car_distance  = sim_uniform(0.20, 0.45);
+	sensor->car_amplitude = sim_uniform(1500, 5000);
+	sensor->car_phase     = sim_uniform(-M_PI, M_PI);
+}
+
+
+void sim_init(unsigned int count, uint32_t seed, float fault_rate)
+{
+	sensor_count      = (count < SIM_MAX_SENSORS) ? count : SIM_MAX_SENSORS;
+	random_state      = (seed != 0) ? seed : 1;
+	fault_probability = fault_rate;
+	forced_empty      = false;
+	virtual_time      = 0;
+	injected_faults   = 0;
+
+	memset(sensors, 0, sizeof(sensors));
+
+	for (unsigned int i = 1; i <= sensor_count; i++)
+	{
+		const sim_pattern_t *pattern = &SIM_PATTERNS[i % (sizeof(SIM_PATTERNS) / sizeof(SIM_PATTERNS[0]))];
+		float               share    = pattern->mean_occupied / (pattern->mean_occupied + pattern->mean_empty);
+
+		sensors[i].occupied = sim_uniform(0, 1) < share;
+		sensors[i].next_transition = sim_exponential(sensors[i].occupied ? pattern->mean_occupied : pattern->mean_empty);
+		sim_park_car(&sensors[i]);
+	}
+}
+
+
+void sim_advance(double now)
+{
+	virtual_time = now;
+
+	for (unsigned int i = 1; i <= sensor_count; i++)
+	{
+		const sim_pattern_t *pattern = &SIM_PATTERNS[i % (sizeof(SIM_PATTERNS) / sizeof(SIM_PATTERNS[0]))];
+		sim_sensor_t        *sensor  = &sensors[i];
+
+		while (sensor->next_transition <= virtual_time)
+		{
+			sensor->occupied = !sensor->occupied;
+			if (sensor->occupied)
+			{
+				sim_park_car(sensor);
+			}
+
+			sensor->next_transition += sim_exponential(sensor->occupied ? pattern->mean_occupied : pattern->mean_empty);
+		}
+	}
+}
+
+
+void sim_force_empty(bool empty)
+{
+	forced_empty = empty;
+}
+
+
+bool sim_is_occupied(acc_sensor_id_t sensor)
+{
+	return sensor >= 1 && sensor <= sensor_count && sensors[sensor].occupied && !forced_empty;
+}
+
+
+unsigned int sim_live_objects(void)
+{
+	return live_objects;
+}
+
+
+unsigned long sim_injected_faults(void)
+{
+	return injected_faults;
+}
+
+
+/**
+ * @brief Generate one envelope sweep for a sensor at the current virtual time
+ *
+ * The scene is a noise floor with direct leakage close to the sensor, a car underbody
+ * reflection when the spot is occupied and, rarely, a passer-by on an empty spot.
+ * Injected faults corrupt the whole sweep after it has been generated, except while
+ * calibrating.
+ *
+ * @param[in]  configuration Service configuration with range and sensor
+ * @param[out] data Envelope samples
+ * @param[out] phase Phase of the strongest reflection, may be NULL
+ * @param[in]  length Number of samples to generate
+ */
+static void sim_envelope(const struct sim_configuration *configuration, float *data, float *phase, uint16_t length)
+{
+	acc_sensor_id_t id        = configuration->sensor;
+	sim_sensor_t    *sensor   = (id >= 1 && id <= sensor_count) ? &sensors[id] : NULL;
+	bool            car       = sensor != NULL && sensor->occupied && !forced_empty;
+	bool            passer_by = sensor != NULL && !car && !forced_empty && sim_uniform(0, 1) < SIM_PASSER_BY_RATE;
+	float           target    = car ? sensor->car_distance : sim_uniform(0.2, 0.5);
+	float           amplitude = car ? sensor->car_amplitude : passer_by ? sim_uniform(1000, 3000) : 0;
+
+	for (uint16_t i = 0; i < length; i++)
+	{
+		float dist  = configuration->start + SIM_SAMPLE_STEP * i;
+		float pulse = (dist - target) / SIM_PULSE_WIDTH;
+
+		data[i] = SIM_NOISE_FLOOR + sim_uniform(-SIM_NOISE_SPREAD, SIM_NOISE_SPREAD) / 2 +
+		          SIM_LEAKAGE * expf(-(dist - configuration->start) / SIM_LEAKAGE_LENGTH) +
+		          amplitude * expf(-pulse * pulse);
+	}
+
+	if (phase != NULL)
+	{
+		//a parked car is rigid, everything else gives a random phase
+		*phase = car ? sensor->car_phase + sim_uniform(-0.1, 0.1) : sim_uniform(-M_PI, M_PI);
+	}
+
+	if (sensor == NULL || forced_empty || sim_uniform(0, 1) >= fault_probability)
+	{
+		return;
+	}
+
+	injected_faults++;
+
+	switch ((sim_fault_t)(sim_random() % SIM_FAULT_COUNT))
+	{
+		case SIM_FAULT_SPIKES:
+			for (int i = 0; i < 5 && length > 0; i++)
+			{
+				data[sim_random() % length] = sim_uniform(8000, 30000);
+			}
+
+			break;
+		case SIM_FAULT_DROPOUT:
+			memset(data, 0, length * sizeof(data[0]));
+			break;
+		case SIM_FAULT_SATURATION:
+			for (uint16_t i = 0; i < length; i++)
+			{
+				data[i] = UINT16_MAX;
+			}
+
+			break;
+		case SIM_FAULT_COUNT:
+			break;
+	}
+}
+
+
+static uint16_t sim_data_length(const struct sim_configuration *configuration)
+{
+	int length = configuration->length / SIM_SAMPLE_STEP;
+
+	return (length < SIM_MAX_DATA_LENGTH) ? length : SIM_MAX_DATA_LENGTH;
+}
+
+
+static acc_service_configuration_t sim_configuration_create(sim_service_type_t type)
+{
+	struct sim_configuration *configuration = calloc(1, sizeof(*configuration));
+
+	if (configuration != NULL)
+	{
+		configuration->type                   = type;
+		configuration->start                  = 0.2;
+		configuration->length                 = 0.5;
+		configuration->frequency              = 10;
+		configuration->sensor                 = 1;
+		configuration->bin_count              = 8;
+		configuration->running_average_factor = 0.7f;
+		live_objects++;
+	}
+
+	return (acc_service_configuration_t)configuration;
+}
+
+
+static void sim_configuration_destroy(acc_service_configuration_t *service_configuration)
+{
+	if (service_configuration != NULL && *service_configuration != NULL)
+	{
+		free(*service_configuration);
+		*service_configuration = NULL;
+		live_objects--;
+	}
+}
+
+
+bool acc_driver_hal_init(void)
+{
+	return true;
+}
+
+
+acc_hal_t acc_driver_hal_get_implementation(void)
+{
+	acc_hal_t hal;
+
+	memset(&hal, 0, sizeof(hal));
+	return hal;
+}
+
+
+bool acc_rss_activate_with_hal(acc_hal_t *hal)
+{
+	(void)hal;
+	return true;
+}
+
+
+void acc_rss_deactivate(void)
+{
+}
+
+
+acc_service_configuration_t acc_service_envelope_configuration_create(void)
+{
+	return sim_configuration_create(SIM_SERVICE_ENVELOPE);
+}
+
+
+void acc_service_envelope_configuration_destroy(acc_service_configuration_t *service_configuration)
+{
+	sim_configuration_destroy(service_configuration);
+}
+
+
+void acc_service_envelope_profile_set(acc_service_configuration_t service_configuration, acc_service_envelope_profile_t profile)
+{
+	(void)service_configuration;
+	(void)profile;
+}
+
+
+void acc_service_envelope_running_average_factor_set(acc_service_configuration_t service_configuration, float factor)
+{
+	((struct sim_configuration *)service_configuration)->running_average_factor = factor;
+}
+
+
+acc_service_configuration_t acc_service_power_bins_configuration_create(void)
+{
+	return sim_configuration_create(SIM_SERVICE_POWER_BINS);
+}
+
+
+void acc_service_power_bins_configuration_destroy(acc_service_configuration_t *service_configuration)
+{
+	sim_configuration_destroy(service_configuration);
+}
+
+
+void acc_service_power_bins_requested_bin_count_set(acc_service_configuration_t service_configuration, uint16_t requested_bin_count)
+{
+	((struct sim_configuration *)service_configuration)->bin_count = requested_bin_count;
+}
+
+
+acc_service_configuration_t acc_service_iq_configuration_create(void)
+{
+	return sim_configuration_create(SIM_SERVICE_IQ);
+}
+
+
+void acc_service_iq_configuration_destroy(acc_service_configuration_t *service_configuration)
+{
+	sim_configuration_destroy(service_configuration);
+}
+
+
+void acc_service_iq_output_format_set(acc_service_configuration_t service_configuration, acc_service_iq_output_format_t format)
+{
+	(void)service_configuration;
+	(void)format;
+}
+
+
+acc_sweep_configuration_t acc_service_get_sweep_configuration(acc_service_configuration_t service_configuration)
+{
+	//the sweep settings live in the same object as the service settings
+	return (acc_sweep_configuration_t)service_configuration;
+}
+
+
+void acc_sweep_configuration_requested_range_set(acc_sweep_configuration_t sweep_configuration, float start, float length)
+{
+	struct sim_configuration *configuration = (struct sim_configuration *)sweep_configuration;
+
+	configuration->start  = start;
+	configuration->length = length;
+}
+
+
+void acc_sweep_configuration_repetition_mode_streaming_set(acc_sweep_configuration_t sweep_configuration, float update_rate)
+{
+	((struct sim_configuration *)sweep_configuration)->frequency = update_rate;
+}
+
+
+void acc_sweep_configuration_sensor_set(acc_sweep_configuration_t sweep_configuration, acc_sensor_id_t sensor_id)
+{
+	((struct sim_configuration *)sweep_configuration)->sensor = sensor_id;
+}
+
+
+acc_service_handle_t acc_service_create(acc_service_configuration_t service_configuration)
+{
+	struct sim_service *service = calloc(1, sizeof(*service));
+
+	if (service != NULL)
+	{
+		service->configuration = *(struct sim_configuration *)service_configuration;
+		live_objects++;
+	}
+
+	return (acc_service_handle_t)service;
+}
+
+
+acc_service_status_t acc_service_activate(acc_service_handle_t service_handle)
+{
+	((struct sim_service *)service_handle)->active          = true;
+	((struct sim_service *)service_handle)->averaged_sweeps = 0;
+	clock_gettime(CLOCK_MONOTONIC, &((struct sim_service *)service_handle)->activated);
+	return ACC_SERVICE_STATUS_OK;
+}
+
+
+acc_service_status_t acc_service_deactivate(acc_service_handle_t service_handle)
+{
+	((struct sim_service *)service_handle)->active = false;
+	return ACC_SERVICE_STATUS_OK;
+}
+
+
+void acc_service_destroy(acc_service_handle_t *service_handle)
+{
+	if (service_handle != NULL && *service_handle != NULL)
+	{
+		free(*service_handle);
+		*service_handle = NULL;
+		live_objects--;
+	}
+}
+
+
+void acc_service_envelope_get_metadata(acc_service_handle_t service_handle, acc_service_envelope_metadata_t *metadata)
+{
+	struct sim_service *service = (struct sim_service *)service_handle;
+
+	metadata->actual_start_m  = service->configuration.start;
+	metadata->actual_length_m = service->configuration.length;
+	metadata->data_length     = sim_data_length(&service->configuration);
+}
+
+
+acc_service_status_t acc_service_envelope_get_next(acc_service_handle_t service_handle, uint16_t *envelope_data,
+                                                   uint16_t envelope_data_length, acc_service_envelope_result_info_t *result_info)
+{
+	struct sim_service *service = (struct sim_service *)service_handle;
+	uint16_t           length   = sim_data_length(&service->configuration);
+	float              data[SIM_MAX_DATA_LENGTH];
+
+	if (!service->active || envelope_data_length < length)
+	{
+		return ACC_SERVICE_STATUS_FAILURE;
+	}
+
+	//the sensor streams at its update rate whether the sweeps are read or not, a read waits
+	//for the next sweep if there is no new one
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double   elapsed  = (now.tv_sec - service->activated.tv_sec) + (now.tv_nsec - service->activated.tv_nsec) * 1e-9;
+	uint32_t measured = (uint32_t)(elapsed * service->configuration.frequency) + 1;
+	uint32_t sweeps   = (measured > service->averaged_sweeps) ? measured - service->averaged_sweeps : 1;
+
+	//the running average starts over with every activation, like on the sensor, and older
+	//sweeps have no visible weight in it
+	uint32_t kept = (service->configuration.running_average_factor > 0) ? SIM_MAX_AVERAGED_SWEEPS : 1;
+
+	for (uint32_t sweep = (sweeps > kept) ? sweeps - kept : 0; sweep < sweeps; sweep++)
+	{
+		float factor = (service->averaged_sweeps + sweep > 0) ? service->configuration.running_average_factor : 0;
+
+		sim_envelope(&service->configuration, data, NULL, length);
+
+		for (uint16_t i = 0; i < length; i++)
+		{
+			service->average[i] = factor * service->average[i] + (1 - factor) * data[i];
+		}
+	}
+
+	for (uint16_t i = 0; i < length; i++)
+	{
+		envelope_data[i] = (service->average[i] < UINT16_MAX) ? (uint16_t)service->average[i] : UINT16_MAX;
+	}
+
+	service->averaged_sweeps += sweeps;
+	service->sequence_number += sweeps;
+
+	result_info->sequence_number = service->sequence_number;
+	result_info->data_saturated  = false;
+	return ACC_SERVICE_STATUS_OK;
+}
+
+
+void acc_service_power_bins_get_metadata(acc_service_handle_t service_handle, acc_service_power_bins_metadata_t *metadata)
+{
+	struct sim_service *service = (struct sim_service *)service_handle;
+
+	metadata->actual_start_m   = service->configuration.start;
+	metadata->actual_length_m  = service->configuration.length;
+	metadata->actual_bin_count = service->configuration.bin_count;
+}
+
+
+acc_service_status_t acc_service_power_bins_get_next(acc_service_handle_t service_handle, uint16_t *bins, uint16_t bin_count,
+                                                     acc_service_power_bins_result_info_t *result_info)
+{
+	struct sim_service *service = (struct sim_service *)service_handle;
+	uint16_t           length   = sim_data_length(&service->configuration);
+	uint16_t           count    = service->configuration.bin_count;
+	float              data[SIM_MAX_DATA_LENGTH];
+
+	if (!service->active || bin_count < count || count == 0 || count > length)
+	{
+		return ACC_SERVICE_STATUS_FAILURE;
+	}
+
+	sim_envelope(&service->configuration, data, NULL, length);
+
+	//each bin is the mean power of its share of the envelope
+	for (uint16_t bin = 0; bin < count; bin++)
+	{
+		uint16_t first = (uint32_t)bin * length / count;
+		uint16_t last  = (uint32_t)(bin + 1) * length / count;
+		float    sum   = 0;
+
+		for (uint16_t i = first; i < last; i++)
+		{
+			sum += data[i];
+		}
+
+		float mean = sum / (last - first);
+		bins[bin] = (mean < UINT16_MAX) ? (uint16_t)mean : UINT16_MAX;
+	}
+
+	result_info->sequence_number = ++service->sequence_number;
+	return ACC_SERVICE_STATUS_OK;
+}
+
+
+void acc_service_iq_get_metadata(acc_service_handle_t service_handle, acc_service_iq_metadata_t *metadata)
+{
+	struct sim_service *service = (struct sim_service *)service_handle;
+
+	metadata->actual_start_m  = service->configuration.start;
+	metadata->actual_length_m = service->configuration.length;
+	metadata->data_length     = sim_data_length(&service->configuration);
+}
+
+
+acc_service_status_t acc_service_iq_get_next(acc_service_handle_t service_handle, void *iq_data, uint16_t iq_data_length,
+                                             acc_service_iq_result_info_t *result_info)
+{
+	struct sim_service *service = (struct sim_service *)service_handle;
+	uint16_t           length   = sim_data_length(&service->configuration);
+	float complex      *output  = iq_data;
+	float              data[SIM_MAX_DATA_LENGTH];
+	float              phase;
+
+	if (!service->active || iq_data_length < length)
+	{
+		return ACC_SERVICE_STATUS_FAILURE;
+	}
+
+	sim_envelope(&service->configuration, data, &phase, length);
+
+	for (uint16_t i = 0; i < length; i++)
+	{
+		output[i] = data[i] * cexpf(I * phase);
+	}
+
+	result_info->sequence_number = ++service->sequence_number;
+	return ACC_SERVICE_STATUS_OK;
+}
@@ -0,0 +1,76 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_SIM_H_
+#define PARKING_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "acc_sweep_configuration.h"
+
+/*
+ * Simulated sensors behind the acc_rss, acc_driver_hal and acc_service API.
+ *
+ * Linking parking-sim.o instead of the RSS libraries and a board file runs the parking
+ * code unmodified against synthetic envelope, power bins and IQ data. Every sensor follows
+ * its own occupancy pattern on a virtual clock that the caller advances, so days of
+ * operation can be compressed into minutes.
+ */
+
+
+#define SIM_MAX_SENSORS (256)
+
+
+/**
+ * @brief Initialize the simulated sensors
+ *
+ * @param[in] sensor_count Number of sensors, ids 1 - sensor_count
+ * @param[in] seed Seed for occupancy patterns, noise and faults
+ * @param[in] fault_rate Probability that a sweep is corrupted by an injected fault
+ */
+void sim_init(unsigned int sensor_count, uint32_t seed, float fault_rate);
+
+
+/**
+ * @brief Advance the virtual clock and update the occupancy of all sensors
+ *
+ * @param[in] now Virtual time in seconds since sim_init(), must not decrease
+ */
+void sim_advance(double now);
+
+
+/**
+ * @brief Force all sensors to report an empty spot, used while calibrating
+ *
+ * @param[in] empty true to hide cars, passers-by and injected faults
+ */
+void sim_force_empty(bool empty);
+
+
+/**
+ * @brief Ground truth for a sensor at the current virtual time
+ *
+ * @param[in] sensor Sensor id
+ * @return true if a car is parked over the sensor
+ */
+bool sim_is_occupied(acc_sensor_id_t sensor);
+
+
+/**
+ * @brief Number of service configurations and service instances currently alive
+ *
+ * @return created minus destroyed objects
+ */
+unsigned int sim_live_objects(void);
+
+
+/**
+ * @brief Number of sweeps corrupted by injected faults since sim_init()
+ *
+ * @return fault count
+ */
+unsigned long sim_injected_faults(void);
+
+
+#endif
@@ -0,0 +1,872 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking-record.h"
+#include "parking-sensor.h"
+#include "parking-sim.h"
+
+/*
+ * Soak harness for ref-app-parking.
+ *
+ * Runs ref-app-parking itself against simulated sensors (see parking-sim.h) on an accelerated
+ * clock covering several days. The application is linked into the soak with its main()
+ * renamed to parking_app_main(), and with its clock and sleeps taken from the soak, see
+ * makefile_build_parking_soak.inc: every sleep of the application advances the virtual clock
+ * instead of waiting, and moves the simulated cars along.
+ *
+ * A sensor list holds at most SOAK_LIST_SIZE sensors, so the sensors are split into lists
+ * measured by one worker process each, as sites with many sensors run the application. Every
+ * worker calibrates its sensors with -c on empty spots and then measures them with -l, the
+ * scheduled loop, exporting every measurement with -x and keeping the occupancy history with
+ * -H. The soak sees the measurements where the application reads sweeps and exports them,
+ * which gives the latency and, against the simulated cars, the accuracy of every decision.
+ *
+ * For every epoch the resident memory of the workers, decision latency percentiles, decision
+ * accuracy and the number of live service objects are recorded. A trend in any of these over
+ * the run fails the soak.
+ */
+
+
+/* default settings */
+
+static const int   DEFAULT_SENSOR_COUNT    = 64;
+static const float DEFAULT_DAYS            = 14;
+static const int   DEFAULT_PERIOD          = 300;
+static const float DEFAULT_EPOCH           = 6 * 3600;
+static const float DEFAULT_FAULT_RATE      = 0.001;
+static const float DEFAULT_RSS_SLOPE       = 64;
+static const float DEFAULT_LATENCY_SLOPE   = 0.5;
+static const float DEFAULT_ACCURACY_SLOPE  = 0.02;
+static const float SECONDS_PER_DAY         = 24 * 3600;
+
+#define SOAK_LIST_SIZE  (4)
+#define MAX_PATH_LENGTH (256)
+#define MAX_ARGUMENTS   (24)
+
+typedef struct
+{
+	int                   sensor_count;
+	float                 days;
+	int                   period;
+	float                 epoch;
+	float                 fault_rate;
+	uint32_t              seed;
+	acquisition_mode_t    mode;
+	bool                  phase_check;
+	bool                  interference_check;
+	float                 rss_slope;
+	float                 latency_slope;
+	float                 accuracy_slope;
+} soak_configuration_t;
+
+typedef struct
+{
+	double       day;
+	long         rss_kib;
+	double       latency_p50;
+	double       latency_p95;
+	double       latency_p99;
+	double       accuracy;
+	unsigned int live_objects;
+} soak_epoch_t;
+
+/* one epoch of one worker, stored in its epoch file followed by the latencies of its decisions */
+typedef struct
+{
+	double        day;
+	long          rss_kib;
+	unsigned int  decisions;
+	unsigned int  correct;
+	unsigned int  live_objects;
+	unsigned long injected_faults;
+} soak_part_t;
+
+/* state of a worker, used by the hooks called by ref-app-parking */
+typedef struct
+{
+	const soak_configuration_t *config;
+	double                     offset;
+	double                     start;
+	int                        epoch_count;
+	int                        epochs_done;
+	FILE                       *epochs;
+	double                     *latencies;
+	int                        latency_capacity;
+	soak_part_t                current;
+	bool                       measuring[SIM_MAX_SENSORS + 1];
+	double                     sweep_start[SIM_MAX_SENSORS + 1];
+} soak_worker_t;
+
+static soak_worker_t worker;
+
+
+/* ref-app-parking, linked with main() renamed */
+int parking_app_main(int argc, char *argv[]);
+
+/* the calls of ref-app-parking redirected to the soak */
+int soak_clock_gettime(clockid_t clock_id, struct timespec *time);
+int soak_nanosleep(const struct timespec *request, struct timespec *remaining);
+unsigned int soak_sleep(unsigned int seconds);
+time_t soak_time(time_t *now);
+uint16_t soak_get_one_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data,
+                            uint16_t data_length);
+bool soak_record_append(record_writer_t *writer, const record_t *record);
+
+
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-n, --sensors                 number of simulated sensors, measured %d per worker, default %d\n", SOAK_LIST_SIZE,
+	        DEFAULT_SENSOR_COUNT);
+	fprintf(stderr, "-D, --days                    simulated duration in days, default %.1f\n", (double)DEFAULT_DAYS);
+	fprintf(stderr, "-t, --period                  delay between detections of a sensor in simulated seconds, default %d\n", DEFAULT_PERIOD);
+	fprintf(stderr, "-e, --epoch                   simulated seconds per reported epoch, default %.0f\n", (double)DEFAULT_EPOCH);
+	fprintf(stderr, "-F, --fault-rate              probability of an injected fault per sweep, default %.4f\n", (double)DEFAULT_FAULT_RATE);
+	fprintf(stderr, "-S, --seed                    random seed, default 1\n");
+	fprintf(stderr, "-m, --mode                    acquisition mode, envelope or power-bins, default %s\n", ACQUISITION_MODE_NAMES[ACQUISITION_MODE_ENVELOPE]);
+	fprintf(stderr, "-p, --phase-check             confirm detections with the IQ phase stability check\n");
+	fprintf(stderr, "-i, --interference-check      reject sweeps corrupted by interference and measure again\n");
+	fprintf(stderr, "-R, --max-rss-slope           max resident memory growth of a worker over the run [KiB], default %.0f\n",
+	        (double)DEFAULT_RSS_SLOPE);
+	fprintf(stderr, "-L, --max-latency-slope       max relative p95 latency growth over the run, default %.2f\n", (double)DEFAULT_LATENCY_SLOPE);
+	fprintf(stderr, "-A, --max-accuracy-slope      max accuracy loss over the run, default %.2f\n", (double)DEFAULT_ACCURACY_SLOPE);
+}
+
+
+static void parse_options(int argc, char *argv[], soak_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"sensors",                 required_argument,    0,    'n'},
+		{"days",                    required_argument,    0,    'D'},
+		{"period",                  required_argument,    0,    't'},
+		{"epoch",                   required_argument,    0,    'e'},
+		{"fault-rate",              required_argument,    0,    'F'},
+		{"seed",                    required_argument,    0,    'S'},
+		{"mode",                    required_argument,    0,    'm'},
+		{"phase-check",             no_argument,          0,    'p'},
+		{"interference-check",      no_argument,          0,    'i'},
+		{"max-rss-slope",           required_argument,    0,    'R'},
+		{"max-latency-slope",       required_argument,    0,    'L'},
+		{"max-accuracy-slope",      required_argument,    0,    'A'},
+		{NULL,                      0,                    NULL,   0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	config->sensor_count   = DEFAULT_SENSOR_COUNT;
+	config->days           = DEFAULT_DAYS;
+	config->period         = DEFAULT_PERIOD;
+	config->epoch          = DEFAULT_EPOCH;
+	config->fault_rate     = DEFAULT_FAULT_RATE;
+	config->seed           = 1;
+	config->mode           = ACQUISITION_MODE_ENVELOPE;
+	config->phase_check    = false;
+	config->interference_check = false;
+	config->rss_slope      = DEFAULT_RSS_SLOPE;
+	config->latency_slope  = DEFAULT_LATENCY_SLOPE;
+	config->accuracy_slope = DEFAULT_ACCURACY_SLOPE;
+
+	while ((character_code = getopt_long(argc, argv, "n:D:t:e:F:S:m:R:L:A:pih?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'n':
+				config->sensor_count = atoi(optarg);
+				break;
+			case 'D':
+				config->days = strtof(optarg, NULL);
+				break;
+			case 't':
+				config->period = atoi(optarg);
+				break;
+			case 'e':
+				config->epoch = strtof(optarg, NULL);
+				break;
+			case 'F':
+				config->fault_rate = strtof(optarg, NULL);
+				break;
+			case 'S':
+				config->seed = strtoul(optarg, NULL, 0);
+				break;
+			case 'm':
+				if (!parse_acquisition_mode(optarg, &config->mode))
+				{
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+
+				break;
+			case 'p':
+				config->phase_check = true;
+				break;
+			case 'i':
+				config->interference_check = true;
+				break;
+			case 'R':
+				config->rss_slope = strtof(optarg, NULL);
+				break;
+			case 'L':
+				config->latency_slope = strtof(optarg, NULL);
+				break;
+			case 'A':
+				config->accuracy_slope = strtof(optarg, NULL);
+				break;
+			case 'h':
+			case '?':
+				print_usage(argv[0]);
+				exit(0);
+		}
+	}
+
+	if (config->sensor_count <= 0 || config->sensor_count > SIM_MAX_SENSORS || config->period <= 0 ||
+	    config->epoch < config->period || config->days * SECONDS_PER_DAY < 3 * config->epoch)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Read the resident set size of this process
+ *
+ * @return resident memory in KiB, or -1 if /proc is not available
+ */
+static long get_rss_kib(void)
+{
+	long  pages    = -1;
+	long  resident = -1;
+	FILE  *statm   = fopen("/proc/self/statm", "r");
+
+	if (statm == NULL)
+	{
+		return -1;
+	}
+
+	if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+	{
+		resident = -1;
+	}
+
+	fclose(statm);
+	return (resident < 0) ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+static double get_time_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+
+/**
+ * @brief Seconds on the virtual clock since the worker started measuring
+ */
+static double get_virtual_time(void)
+{
+	return get_time_us() / 1e6 + worker.offset - worker.start;
+}
+
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Least squares slope of y over x
+ */
+static double get_slope(const double *x, const double *y, int count)
+{
+	double mean_x = 0;
+	double mean_y = 0;
+	double sxx    = 0;
+	double sxy    = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		mean_x += x[i] / count;
+		mean_y += y[i] / count;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		sxx += (x[i] - mean_x) * (x[i] - mean_x);
+		sxy += (x[i] - mean_x) * (y[i] - mean_y);
+	}
+
+	return (sxx > 0) ? sxy / sxx : 0;
+}
+
+
+/**
+ * @brief Store the current epoch of the worker in its epoch file and start the next one
+ */
+static void finish_epoch(void)
+{
+	soak_part_t *epoch = &worker.current;
+
+	worker.epochs_done++;
+	epoch->day             = worker.epochs_done * worker.config->epoch / SECONDS_PER_DAY;
+	epoch->rss_kib         = get_rss_kib();
+	epoch->live_objects    = sim_live_objects();
+	epoch->injected_faults = sim_injected_faults();
+
+	if (fwrite(epoch, sizeof(*epoch), 1, worker.epochs) != 1 ||
+	    fwrite(worker.latencies, sizeof(*worker.latencies), epoch->decisions, worker.epochs) != epoch->decisions)
+	{
+		handle_fatal_error("Unable to write epoch file");
+	}
+
+	memset(epoch, 0, sizeof(*epoch));
+}
+
+
+/**
+ * @brief Advance the virtual clock instead of sleeping
+ *
+ * The simulated cars move to the new time, and the epochs passed are finished. Once the last
+ * epoch is finished ref-app-parking is stopped like by Ctrl-C, after its current measurement.
+ *
+ * @param[in] seconds Time the application wanted to sleep
+ */
+static void advance_clock(double seconds)
+{
+	if (seconds > 0)
+	{
+		worker.offset += seconds;
+	}
+
+	double now = get_virtual_time();
+
+	sim_advance(now);
+
+	while (worker.epochs_done < worker.epoch_count && now >= (worker.epochs_done + 1) * worker.config->epoch)
+	{
+		finish_epoch();
+	}
+
+	if (worker.epochs_done == worker.epoch_count)
+	{
+		raise(SIGINT);
+	}
+}
+
+
+int soak_clock_gettime(clockid_t clock_id, struct timespec *time)
+{
+	int status = clock_gettime(clock_id, time);
+
+	if (status == 0 && (clock_id == CLOCK_MONOTONIC || clock_id == CLOCK_REALTIME))
+	{
+		double seconds = time->tv_nsec * 1e-9 + worker.offset;
+
+		time->tv_sec  += (time_t)seconds;
+		time->tv_nsec  = (long)((seconds - (time_t)seconds) * 1e9);
+	}
+
+	return status;
+}
+
+
+int soak_nanosleep(const struct timespec *request, struct timespec *remaining)
+{
+	advance_clock(request->tv_sec + request->tv_nsec * 1e-9);
+
+	if (remaining != NULL)
+	{
+		remaining->tv_sec  = 0;
+		remaining->tv_nsec = 0;
+	}
+
+	return 0;
+}
+
+
+unsigned int soak_sleep(unsigned int seconds)
+{
+	advance_clock(seconds);
+	return 0;
+}
+
+
+time_t soak_time(time_t *now)
+{
+	struct timespec time;
+
+	soak_clock_gettime(CLOCK_REALTIME, &time);
+	if (now != NULL)
+	{
+		*now = time.tv_sec;
+	}
+
+	return time.tv_sec;
+}
+
+
+uint16_t soak_get_one_sweep(const radar_configuration_t *radar_config, acc_service_handle_t service_handle, uint16_t *data,
+                            uint16_t data_length)
+{
+	acc_sensor_id_t sensor = radar_config->sensor;
+
+	//a decision starts with its first sweep, rejected sweeps and confirmations count in its latency
+	if (sensor <= SIM_MAX_SENSORS && !worker.measuring[sensor])
+	{
+		worker.measuring[sensor]   = true;
+		worker.sweep_start[sensor] = get_time_us();
+	}
+
+	return get_one_sweep(radar_config, service_handle, data, data_length);
+}
+
+
+bool soak_record_append(record_writer_t *writer, const record_t *record)
+{
+	soak_part_t *epoch  = &worker.current;
+	uint16_t    sensor = record->sensor;
+
+	if (sensor <= SIM_MAX_SENSORS && worker.measuring[sensor] && worker.epochs_done < worker.epoch_count)
+	{
+		if ((int)epoch->decisions == worker.latency_capacity)
+		{
+			worker.latency_capacity *= 2;
+			worker.latencies         = realloc(worker.latencies, sizeof(*worker.latencies) * worker.latency_capacity);
+			if (worker.latencies == NULL)
+			{
+				handle_fatal_error("Out of memory");
+			}
+		}
+
+		worker.latencies[epoch->decisions++] = get_time_us() - worker.sweep_start[sensor];
+		epoch->correct                      += record->result == sim_is_occupied(sensor);
+	}
+
+	if (sensor <= SIM_MAX_SENSORS)
+	{
+		worker.measuring[sensor] = false;
+	}
+
+	return record_append(writer, record);
+}
+
+
+/**
+ * @brief Run ref-app-parking with the given arguments
+ *
+ * @param[in] arguments Arguments after the program name, NULL terminated
+ * @return the exit code of the application
+ */
+static int run_app(const char *const *arguments)
+{
+	char *argv[MAX_ARGUMENTS + 1] = {"ref-app-parking"};
+	int  argc                     = 1;
+
+	while (arguments[argc - 1] != NULL && argc < MAX_ARGUMENTS)
+	{
+		argv[argc] = (char *)arguments[argc - 1];
+		argc++;
+	}
+
+	argv[argc] = NULL;
+
+	//every run parses its options from the start
+	optind = 0;
+
+	return parking_app_main(argc, argv);
+}
+
+
+/**
+ * @brief Calibrate and measure a list of sensors with ref-app-parking until the last epoch
+ *
+ * @param[in] config The configuration
+ * @param[in] directory Directory of the calibration, history, export and epoch files
+ * @param[in] list Index of the list
+ * @return the exit code of the worker
+ */
+static int run_worker(const soak_configuration_t *config, const char *directory, int list)
+{
+	char calibration[MAX_PATH_LENGTH];
+	char history[MAX_PATH_LENGTH];
+	char export[MAX_PATH_LENGTH];
+	char epochs[MAX_PATH_LENGTH];
+	char sensors[SOAK_LIST_SIZE * 8];
+	char period[16];
+	int  first = list * SOAK_LIST_SIZE + 1;
+	int  last  = (first + SOAK_LIST_SIZE - 1 < config->sensor_count) ? first + SOAK_LIST_SIZE - 1 : config->sensor_count;
+
+	snprintf(calibration, sizeof(calibration), "%s/soak.cal", directory);
+	snprintf(history, sizeof(history), "%s/soak.hst", directory);
+	snprintf(export, sizeof(export), "%s/soak-%d.pkc", directory, list);
+	snprintf(epochs, sizeof(epochs), "%s/soak-%d.epochs", directory, list);
+
+	snprintf(period, sizeof(period), "%d", config->period);
+
+	sensors[0] = '\0';
+	for (int sensor = first; sensor <= last; sensor++)
+	{
+		snprintf(sensors + strlen(sensors), sizeof(sensors) - strlen(sensors), "%s%d", (sensor > first) ? "," : "", sensor);
+	}
+
+	worker.config           = config;
+	worker.epoch_count      = config->days * SECONDS_PER_DAY / config->epoch;
+	worker.latency_capacity = 1024;
+	worker.latencies        = malloc(sizeof(*worker.latencies) * worker.latency_capacity);
+	worker.epochs           = fopen(epochs, "wb");
+
+	if (worker.latencies == NULL || worker.epochs == NULL)
+	{
+		handle_fatal_error("Unable to create epoch file");
+	}
+
+	//only the report of the soak is printed
+	if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+		handle_fatal_error("Unable to redirect the output of ref-app-parking");
+	}
+
+	sim_init(config->sensor_count, config->seed, config->fault_rate);
+
+	const char *mode = ACQUISITION_MODE_NAMES[config->mode];
+
+	const char *calibrate[] = {"--board", "sim", "-c", "-s", sensors, "-f", calibration, "-m", mode, NULL};
+
+	sim_force_empty(true);
+	if (run_app(calibrate) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+
+	sim_force_empty(false);
+
+	const char *measure[MAX_ARGUMENTS] = {"--board", "sim", "-s", sensors, "-f", calibration, "-d", period, "-l", "-x", export, "-H",
+	                                      history};
+	int        count                   = 13;
+
+	if (config->phase_check)
+	{
+		measure[count++] = "-p";
+	}
+
+	if (config->interference_check)
+	{
+		measure[count++] = "-i";
+	}
+
+	measure[count] = NULL;
+
+	worker.start = get_time_us() / 1e6;
+	if (run_app(measure) != EXIT_SUCCESS || worker.epochs_done != worker.epoch_count)
+	{
+		return EXIT_FAILURE;
+	}
+
+	//ref-app-parking has returned, so every service object must be destroyed
+	worker.current.live_objects = sim_live_objects();
+	if (fwrite(&worker.current.live_objects, sizeof(worker.current.live_objects), 1, worker.epochs) != 1 ||
+	    fclose(worker.epochs) != 0)
+	{
+		handle_fatal_error("Unable to write epoch file");
+	}
+
+	free(worker.latencies);
+	return EXIT_SUCCESS;
+}
+
+
+/**
+ * @brief Remove the files of the workers and their directory
+ *
+ * @param[in] directory The directory
+ */
+static void remove_directory(const char *directory)
+{
+	DIR           *dir = opendir(directory);
+	struct dirent *entry;
+
+	if (dir == NULL)
+	{
+		return;
+	}
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+		{
+			unlinkat(dirfd(dir), entry->d_name, 0);
+		}
+	}
+
+	closedir(dir);
+	rmdir(directory);
+}
+
+
+/**
+ * @brief Read the next epoch of every worker and merge them
+ *
+ * The resident memory is the one of the largest worker, the latencies and the accuracy are
+ * the ones of the decisions of all workers.
+ *
+ * @param[in] files Epoch files of the workers
+ * @param[in] count Number of workers
+ * @param[out] epoch The merged epoch
+ * @param[out] injected_faults Faults injected into all workers so far
+ */
+static void merge_epoch(FILE **files, int count, soak_epoch_t *epoch, unsigned long *injected_faults)
+{
+	static double *latencies;
+	static size_t capacity;
+	size_t        decisions = 0;
+	unsigned int  correct   = 0;
+
+	memset(epoch, 0, sizeof(*epoch));
+	*injected_faults = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		soak_part_t part;
+
+		if (fread(&part, sizeof(part), 1, files[i]) != 1)
+		{
+			handle_fatal_error("Unable to read epoch file");
+		}
+
+		if (decisions + part.decisions > capacity)
+		{
+			capacity  = 2 * (decisions + part.decisions);
+			latencies = realloc(latencies, sizeof(*latencies) * capacity);
+			if (latencies == NULL)
+			{
+				handle_fatal_error("Out of memory");
+			}
+		}
+
+		if (fread(latencies + decisions, sizeof(*latencies), part.decisions, files[i]) != part.decisions)
+		{
+			handle_fatal_error("Unable to read epoch file");
+		}
+
+		decisions           += part.decisions;
+		correct             += part.correct;
+		epoch->day           = part.day;
+		epoch->rss_kib       = (part.rss_kib > epoch->rss_kib) ? part.rss_kib : epoch->rss_kib;
+		epoch->live_objects += part.live_objects;
+		*injected_faults    += part.injected_faults;
+	}
+
+	if (decisions == 0)
+	{
+		handle_fatal_error("No decisions in an epoch");
+	}
+
+	qsort(latencies, decisions, sizeof(latencies[0]), compare_double);
+
+	epoch->latency_p50 = latencies[decisions / 2];
+	epoch->latency_p95 = latencies[decisions * 95 / 100];
+	epoch->latency_p99 = latencies[decisions * 99 / 100];
+	epoch->accuracy    = (double)correct / decisions;
+}
+
+
+/**
+ * @brief Fit the trends of the epochs and check them against the limits
+ *
+ * @param[in] config The configuration
+ * @param[in] epochs The merged epochs
+ * @param[in] epoch_count Number of epochs
+ * @param[in] live_objects Service objects alive after every worker stopped
+ * @return true if no trend exceeds its limit and no service object leaks
+ */
+static bool check_trends(const soak_configuration_t *config, const soak_epoch_t *epochs, int epoch_count,
+                         unsigned int live_objects)
+{
+	//the first epoch is warm-up, trends are fitted over the rest
+	int fit_count = epoch_count - 1;
+	if (fit_count < 2)
+	{
+		handle_fatal_error("Too few epochs to fit a trend");
+		return false;
+	}
+
+	double day[fit_count];
+	double rss[fit_count];
+	double p95[fit_count];
+	double accuracy[fit_count];
+	double mean_p95 = 0;
+
+	for (int i = 0; i < fit_count; i++)
+	{
+		day[i]      = epochs[i + 1].day;
+		rss[i]      = epochs[i + 1].rss_kib;
+		p95[i]      = epochs[i + 1].latency_p95;
+		accuracy[i] = epochs[i + 1].accuracy;
+		mean_p95   += p95[i] / fit_count;
+	}
+
+	double span           = day[fit_count - 1] - day[0];
+	double rss_growth     = get_slope(day, rss, fit_count) * span;
+	double latency_growth = (mean_p95 > 0) ? get_slope(day, p95, fit_count) * span / mean_p95 : 0;
+	double accuracy_loss  = -get_slope(day, accuracy, fit_count) * span;
+	bool   passed         = true;
+
+	printf("\nRSS growth:      %.1f KiB (max %.1f)\n", rss_growth, (double)config->rss_slope);
+	printf("Latency growth:  %.1f %% (max %.1f %%)\n", latency_growth * 100, (double)config->latency_slope * 100);
+	printf("Accuracy loss:   %.2f %% (max %.2f %%)\n", accuracy_loss * 100, (double)config->accuracy_slope * 100);
+	printf("Live objects:    %u\n", live_objects);
+
+	if (epochs[0].rss_kib >= 0 && rss_growth > config->rss_slope)
+	{
+		printf("FAIL: resident memory grows over time\n");
+		passed = false;
+	}
+
+	if (latency_growth > config->latency_slope)
+	{
+		printf("FAIL: decision latency grows over time\n");
+		passed = false;
+	}
+
+	if (accuracy_loss > config->accuracy_slope)
+	{
+		printf("FAIL: decision accuracy drops over time\n");
+		passed = false;
+	}
+
+	if (live_objects != 0)
+	{
+		printf("FAIL: service objects leak\n");
+		passed = false;
+	}
+
+	return passed;
+}
+
+
+int main(int argc, char *argv[])
+{
+	soak_configuration_t config;
+	parse_options(argc, argv, &config);
+
+	char         directory[] = "/tmp/ref-app-parking-soak-XXXXXX";
+	int          list_count  = (config.sensor_count + SOAK_LIST_SIZE - 1) / SOAK_LIST_SIZE;
+	int          epoch_count = config.days * SECONDS_PER_DAY / config.epoch;
+	soak_epoch_t *epochs     = calloc(epoch_count, sizeof(*epochs));
+	FILE         *files[list_count];
+	unsigned int live_objects = 0;
+	bool         passed       = true;
+	int          status;
+
+	if (epochs == NULL)
+	{
+		handle_fatal_error("Out of memory");
+	}
+
+	if (mkdtemp(directory) == NULL)
+	{
+		handle_fatal_error("Unable to create a directory for the workers");
+	}
+
+	fflush(stdout);
+	for (int list = 0; list < list_count; list++)
+	{
+		pid_t pid = fork();
+
+		if (pid < 0)
+		{
+			handle_fatal_error("fork() failed");
+		}
+
+		if (pid == 0)
+		{
+			exit(run_worker(&config, directory, list));
+		}
+	}
+
+	while (wait(&status) > 0)
+	{
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		{
+			passed = false;
+		}
+	}
+
+	if (!passed)
+	{
+		remove_directory(directory);
+		handle_fatal_error("A worker failed");
+	}
+
+	for (int list = 0; list < list_count; list++)
+	{
+		char name[MAX_PATH_LENGTH];
+
+		snprintf(name, sizeof(name), "%s/soak-%d.epochs", directory, list);
+		files[list] = fopen(name, "rb");
+		if (files[list] == NULL)
+		{
+			handle_fatal_error("Unable to open epoch file");
+		}
+	}
+
+	printf("day,rss_kib,latency_p50_us,latency_p95_us,latency_p99_us,accuracy,live_objects,injected_faults\n");
+
+	for (int epoch = 0; epoch < epoch_count; epoch++)
+	{
+		soak_epoch_t  *e = &epochs[epoch];
+		unsigned long injected_faults;
+
+		merge_epoch(files, list_count, e, &injected_faults);
+
+		printf("%.3f,%ld,%.1f,%.1f,%.1f,%.4f,%u,%lu\n", e->day, e->rss_kib, e->latency_p50, e->latency_p95,
+		       e->latency_p99, e->accuracy, e->live_objects, injected_faults);
+	}
+
+	//every worker ends with the service objects still alive after ref-app-parking returned
+	for (int list = 0; list < list_count; list++)
+	{
+		unsigned int objects;
+
+		if (fread(&objects, sizeof(objects), 1, files[list]) != 1)
+		{
+			handle_fatal_error("Unable to read epoch file");
+		}
+
+		live_objects += objects;
+		fclose(files[list]);
+	}
+
+	remove_directory(directory);
+
+	passed = check_trends(&config, epochs, epoch_count, live_objects);
+
+	printf("%s\n", passed ? "PASS" : "FAIL");
+
+	free(epochs);
+
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,557 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parking-shm.h"
+
+/*
+ * Supervisor running one parking worker process per board.
+ *
+ * Each line of the worker file holds the options of one worker, e.g. the sensor and the
+ * calibration file of a board. Workers run ref-app-parking in loop mode and publish every
+ * result in their own slot of a shared memory region, so a crashing or hanging board only
+ * takes down its own process. The supervisor restarts a dead worker at once, backs off
+ * exponentially if it keeps failing, kills workers that stop publishing, and prints a
+ * unified view of all boards together with the time each restart took until the first
+ * new result.
+ */
+
+/* default settings */
+
+static const char     *DEFAULT_BINARY      = "./ref-app-parking";
+static const char     *DEFAULT_SHM_NAME    = "/parking";
+static const int      DEFAULT_INTERVAL     = 10;
+static const int      DEFAULT_STALE_TIME   = 120;
+static const uint64_t MIN_BACKOFF_MS       = 1000;
+static const uint64_t MAX_BACKOFF_MS       = 60000;
+static const uint64_t STABLE_RUN_MS        = 60000;
+static const uint64_t STOP_TIMEOUT_MS      = 5000;
+static const long     POLL_INTERVAL_NS     = 100000000;
+
+#define MAX_LINE_LENGTH  (400)
+#define MAX_WORKER_ARGS  (40)
+#define MAX_NAME_LENGTH  (200)
+
+typedef struct
+{
+	const char   *binary;
+	char         shm_name[MAX_NAME_LENGTH + 1];
+	const char   *worker_file_name;
+	int          interval;
+	int          stale_time;
+	bool         verbose;
+} supervisor_configuration_t;
+
+typedef struct
+{
+	char         line[MAX_LINE_LENGTH + 1];
+	char         slot[8];
+	char         *args[MAX_WORKER_ARGS + 1];
+	int          arg_count;
+	pid_t        pid;
+	uint64_t     start_time_ms;
+	uint64_t     exit_time_ms;
+	uint64_t     restart_at_ms;
+	uint64_t     backoff_ms;
+	bool         restarting;
+	unsigned int restarts;
+	uint64_t     restart_latency_ms;
+	uint64_t     max_restart_latency_ms;
+} worker_t;
+
+static volatile sig_atomic_t stop_requested = false;
+
+
+/**
+ * @brief Print usage information to stdout
+ *
+ * @param[in] program_name
+ */
+static void print_usage(const char *program_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] -w <worker file>\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "-h, --help                    this help\n");
+	fprintf(stderr, "-w, --workers                 file with the options of one worker per line, at most %u workers\n", SHM_MAX_WORKERS);
+	fprintf(stderr, "-b, --binary                  worker program, default %s\n", DEFAULT_BINARY);
+	fprintf(stderr, "-n, --shm-name                name of the shared memory region, default %s\n", DEFAULT_SHM_NAME);
+	fprintf(stderr, "-i, --interval                seconds between status views, default %d\n", DEFAULT_INTERVAL);
+	fprintf(stderr, "-t, --stale-time              restart a worker without results for this many seconds, default %d\n", DEFAULT_STALE_TIME);
+	fprintf(stderr, "-v, --verbose                 show the output of the workers\n");
+}
+
+
+/**
+ * @brief Parse command line options and update configuration struct
+ *
+ * @param[in]  argc Number of arguments passed to the main function
+ * @param[in]  argv Array with arguments passed to the main function
+ * @param[out] config configuration data to be updated
+ */
+static void parse_options(int argc, char *argv[], supervisor_configuration_t *config)
+{
+	static struct option long_options[] =
+	{
+		{"help",                    no_argument,          0,    'h'},
+		{"workers",                 required_argument,    0,    'w'},
+		{"binary",                  required_argument,    0,    'b'},
+		{"shm-name",                required_argument,    0,    'n'},
+		{"interval",                required_argument,    0,    'i'},
+		{"stale-time",              required_argument,    0,    't'},
+		{"verbose",                 no_argument,          0,    'v'},
+		{NULL,                      0,                    NULL, 0}
+	};
+
+	int character_code;
+	int option_index = 0;
+
+	config->binary           = DEFAULT_BINARY;
+	config->worker_file_name = NULL;
+	config->interval         = DEFAULT_INTERVAL;
+	config->stale_time       = DEFAULT_STALE_TIME;
+	config->verbose          = false;
+	strcpy(config->shm_name, DEFAULT_SHM_NAME);
+
+	while ((character_code = getopt_long(argc, argv, "w:b:n:i:t:vh?", long_options, &option_index)) != -1)
+	{
+		switch (character_code)
+		{
+			case 'w':
+			{
+				config->worker_file_name = optarg;
+				break;
+			}
+
+			case 'b':
+			{
+				config->binary = optarg;
+				break;
+			}
+
+			case 'n':
+			{
+				strncpy(config->shm_name, optarg, MAX_NAME_LENGTH);
+				config->shm_name[MAX_NAME_LENGTH] = '\0';
+				break;
+			}
+
+			case 'i':
+			{
+				config->interval = atoi(optarg);
+				break;
+			}
+
+			case 't':
+			{
+				config->stale_time = atoi(optarg);
+				break;
+			}
+
+			case 'v':
+			{
+				config->verbose = true;
+				break;
+			}
+
+			case 'h':
+			case '?':
+			default:
+			{
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	if (config->worker_file_name == NULL || config->interval <= 0 || config->stale_time <= 0)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+/**
+ * @brief Print an error message and exit
+ *
+ * @param[in] message Error message
+ */
+static void handle_fatal_error(const char *message)
+{
+	fprintf(stderr, "Fatal error: %s\n", message);
+	exit(EXIT_FAILURE);
+}
+
+
+/**
+ * @brief Signal handler shutting down the supervisor and its workers
+ *
+ * @param[in] signal_number Ignored
+ */
+static void request_stop(int signal_number)
+{
+	(void)signal_number;
+	stop_requested = true;
+}
+
+
+/**
+ * @brief Read the worker file, one worker per non-empty line, # starts a comment
+ *
+ * @param[in]  config Configuration data
+ * @param[out] workers Workers with their argument vectors set up
+ * @return number of workers
+ */
+static int read_workers(const supervisor_configuration_t *config, worker_t *workers)
+{
+	FILE *file = fopen(config->worker_file_name, "r");
+
+	if (file == NULL)
+	{
+		handle_fatal_error("Unable to open worker file");
+	}
+
+	char line[MAX_LINE_LENGTH + 1];
+	int  count = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		char *comment = strchr(line, '#');
+		if (comment != NULL)
+		{
+			*comment = '\0';
+		}
+
+		if (strspn(line, " \t\r\n") == strlen(line))
+		{
+			continue;
+		}
+
+		if (count == SHM_MAX_WORKERS)
+		{
+			handle_fatal_error("Too many workers");
+		}
+
+		worker_t *worker = &workers[count];
+		memset(worker, 0, sizeof(*worker));
+		strcpy(worker->line, line);
+
+		worker->args[worker->arg_count++] = (char *)config->binary;
+		for (char *token = strtok(worker->line, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n"))
+		{
+			if (worker->arg_count >= MAX_WORKER_ARGS - 5)
+			{
+				handle_fatal_error("Too many worker options");
+			}
+
+			worker->args[worker->arg_count++] = token;
+		}
+
+		snprintf(worker->slot, sizeof(worker->slot), "%d", count);
+
+		worker->args[worker->arg_count++] = "--loop";
+		worker->args[worker->arg_count++] = "--shm-name";
+		worker->args[worker->arg_count++] = (char *)config->shm_name;
+		worker->args[worker->arg_count++] = "--shm-slot";
+		worker->args[worker->arg_count++] = worker->slot;
+		worker->args[worker->arg_count]   = NULL;
+		worker->backoff_ms                = 0;
+		count++;
+	}
+
+	fclose(file);
+
+	if (count == 0)
+	{
+		handle_fatal_error("No workers in worker file");
+	}
+
+	return count;
+}
+
+
+/**
+ * @brief Start a worker process
+ *
+ * @param[in]     config Configuration data
+ * @param[in,out] worker The worker to start
+ */
+static void start_worker(const supervisor_configuration_t *config, worker_t *worker)
+{
+	pid_t pid = fork();
+
+	if (pid < 0)
+	{
+		handle_fatal_error("fork() failed");
+	}
+
+	if (pid == 0)
+	{
+		if (!config->verbose)
+		{
+			int null_fd = open("/dev/null", O_WRONLY);
+			if (null_fd >= 0)
+			{
+				dup2(null_fd, STDOUT_FILENO);
+				close(null_fd);
+			}
+		}
+
+		execv(config->binary, worker->args);
+		fprintf(stderr, "Unable to start %s: %s\n", config->binary, strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+
+	worker->pid           = pid;
+	worker->start_time_ms = shm_time_ms();
+}
+
+
+/**
+ * @brief Collect exited workers and schedule their restart
+ *
+ * @param[in,out] workers All workers
+ * @param[in]     count Number of workers
+ */
+static void reap_workers(worker_t *workers, int count)
+{
+	int   status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			worker_t *worker = &workers[i];
+
+			if (worker->pid != pid)
+			{
+				continue;
+			}
+
+			uint64_t now = shm_time_ms();
+
+			/* a worker that ran for a while failed for a new reason, restart it at once */
+			if (now - worker->start_time_ms >= STABLE_RUN_MS)
+			{
+				worker->backoff_ms = 0;
+			}
+
+			if (!worker->restarting)
+			{
+				worker->exit_time_ms = now;
+			}
+
+			worker->pid           = 0;
+			worker->restarting    = true;
+			worker->restart_at_ms = now + worker->backoff_ms;
+			worker->backoff_ms    = worker->backoff_ms == 0 ? MIN_BACKOFF_MS :
+			                        worker->backoff_ms * 2 > MAX_BACKOFF_MS ? MAX_BACKOFF_MS : worker->backoff_ms * 2;
+
+			if (WIFSIGNALED(status))
+			{
+				printf("worker %d (pid %d) killed by signal %d, restart in %.1f s\n", i, pid, WTERMSIG(status),
+				       (double)(worker->restart_at_ms - now) / 1000);
+			}
+			else
+			{
+				printf("worker %d (pid %d) exited with status %d, restart in %.1f s\n", i, pid, WEXITSTATUS(status),
+				       (double)(worker->restart_at_ms - now) / 1000);
+			}
+		}
+	}
+}
+
+
+/**
+ * @brief Restart workers whose backoff has passed, finish restarts that published, kill stale workers
+ *
+ * @param[in]     config Configuration data
+ * @param[in]     results The shared results
+ * @param[in,out] workers All workers
+ * @param[in]     count Number of workers
+ */
+static void check_workers(const supervisor_configuration_t *config, const shm_results_t *results, worker_t *workers, int count)
+{
+	uint64_t now = shm_time_ms();
+
+	for (int i = 0; i < count; i++)
+	{
+		worker_t   *worker = &workers[i];
+		shm_slot_t slot;
+
+		if (worker->pid == 0)
+		{
+			if (worker->restarting && now >= worker->restart_at_ms)
+			{
+				start_worker(config, worker);
+				worker->restarts++;
+			}
+
+			continue;
+		}
+
+		shm_results_read(results, i, &slot);
+		bool published = slot.pid == worker->pid && slot.update_time_ms >= worker->start_time_ms;
+
+		if (worker->restarting && published)
+		{
+			worker->restarting         = false;
+			worker->restart_latency_ms = slot.update_time_ms - worker->exit_time_ms;
+			if (worker->restart_latency_ms > worker->max_restart_latency_ms)
+			{
+				worker->max_restart_latency_ms = worker->restart_latency_ms;
+			}
+		}
+
+		uint64_t last_sign_of_life = published ? slot.update_time_ms : worker->start_time_ms;
+		if (now - last_sign_of_life > (uint64_t)config->stale_time * 1000)
+		{
+			printf("worker %d (pid %d) published nothing for %d s, killing it\n", i, worker->pid, config->stale_time);
+			kill(worker->pid, SIGKILL);
+
+			/* restart the stale timer, the kill is reported by reap_workers() */
+			worker->start_time_ms = now;
+		}
+	}
+}
+
+
+/**
+ * @brief Print the results of all boards and the state of their workers
+ *
+ * @param[in] results The shared results
+ * @param[in] workers All workers
+ * @param[in] count Number of workers
+ */
+static void print_view(const shm_results_t *results, const worker_t *workers, int count)
+{
+	uint64_t now = shm_time_ms();
+
+	printf("\nslot  pid     state       result  age_s  measurements  restarts  restart_ms  max_restart_ms\n");
+
+	for (int i = 0; i < count; i++)
+	{
+		const worker_t *worker = &workers[i];
+		shm_slot_t     slot;
+
+		shm_results_read(results, i, &slot);
+
+		const char *state  = worker->pid == 0 ? "backoff" : worker->restarting ? "restarting" : "running";
+		const char *result = slot.measurements == 0 ? "-" : slot.result == 1 ? "car" : "empty";
+		double     age     = slot.measurements == 0 ? -1 : (double)(now - slot.update_time_ms) / 1000;
+
+		printf("%4d  %-6d  %-10s  %-6s  %5.0f  %12u  %8u  %10llu  %14llu\n", i, (int)worker->pid, state, result, age,
+		       slot.measurements, worker->restarts, (unsigned long long)worker->restart_latency_ms,
+		       (unsigned long long)worker->max_restart_latency_ms);
+	}
+
+	fflush(stdout);
+}
+
+
+/**
+ * @brief Terminate all workers, waiting a while before killing them
+ *
+ * @param[in,out] workers All workers
+ * @param[in]     count Number of workers
+ */
+static void stop_workers(worker_t *workers, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (workers[i].pid != 0)
+		{
+			kill(workers[i].pid, SIGTERM);
+		}
+	}
+
+	uint64_t        deadline = shm_time_ms() + STOP_TIMEOUT_MS;
+	struct timespec poll     = {0, POLL_INTERVAL_NS};
+
+	while (waitpid(-1, NULL, WNOHANG) >= 0)
+	{
+		if (shm_time_ms() > deadline)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				if (workers[i].pid != 0)
+				{
+					kill(workers[i].pid, SIGKILL);
+				}
+			}
+
+			while (waitpid(-1, NULL, 0) > 0)
+			{
+			}
+
+			break;
+		}
+
+		nanosleep(&poll, NULL);
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	static worker_t workers[SHM_MAX_WORKERS];
+
+	supervisor_configuration_t config;
+	parse_options(argc, argv, &config);
+
+	int count = read_workers(&config, workers);
+
+	shm_results_t *results = shm_results_open(config.shm_name, true);
+	if (results == NULL)
+	{
+		handle_fatal_error("Unable to create shared memory results");
+	}
+
+	signal(SIGTERM, request_stop);
+	signal(SIGINT, request_stop);
+
+	for (int i = 0; i < count; i++)
+	{
+		start_worker(&config, &workers[i]);
+	}
+
+	printf("Started %d workers, results in %s\n", count, config.shm_name);
+
+	uint64_t        next_view = shm_time_ms() + (uint64_t)config.interval * 1000;
+	struct timespec poll      = {0, POLL_INTERVAL_NS};
+
+	while (!stop_requested)
+	{
+		nanosleep(&poll, NULL);
+
+		reap_workers(workers, count);
+		check_workers(&config, results, workers, count);
+
+		if (shm_time_ms() >= next_view)
+		{
+			print_view(results, workers, count);
+			next_view += (uint64_t)config.interval * 1000;
+		}
+	}
+
+	stop_workers(workers, count);
+	print_view(results, workers, count);
+
+	shm_results_close(results);
+	shm_unlink(config.shm_name);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,254 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "parking-threshold.h"
+
+
+static const float    BINS_PER_OCTAVE          = 16;
+static const float    LOWEST_OCTAVE            = -4;
+static const double   HALF_LIFE                = 7 * 24 * 3600;
+static const float    MIN_WEIGHT               = 100;
+static const float    MIN_MODE_SHARE           = 0.05;
+static const float    MIN_SEPARATION           = 0.75;
+static const uint32_t STABLE_UPDATES           = 50;
+static const float    MIN_REFERENCE_SHARE      = 0.5;
+static const float    MAX_REFERENCE_SHARE      = 2.0;
+static const float    SETTLED_MARGIN           = 2.0;
+static const float    REFERENCE_TOLERANCE      = 0.01;
+
+
+/**
+ * @brief Bin of a peak amplitude, amplitudes outside the histogram go to the first or last bin
+ *
+ * @param[in] histogram The histogram
+ * @param[in] amp Peak amplitude
+ * @return the bin
+ */
+static int threshold_bin(const threshold_histogram_t *histogram, float amp)
+{
+	float octave = (amp > 0) ? log2f(amp / histogram->reference) : LOWEST_OCTAVE;
+	int   bin    = floorf((octave - LOWEST_OCTAVE) * BINS_PER_OCTAVE);
+
+	return (bin < 0) ? 0 : (bin >= THRESHOLD_BIN_COUNT) ? THRESHOLD_BIN_COUNT - 1 : bin;
+}
+
+
+/**
+ * @brief Amplitude at the upper edge of a bin
+ *
+ * @param[in] histogram The histogram
+ * @param[in] bin The bin
+ * @return the amplitude
+ */
+static float threshold_bin_edge(const threshold_histogram_t *histogram, int bin)
+{
+	return histogram->reference * exp2f(LOWEST_OCTAVE + (bin + 1) / BINS_PER_OCTAVE);
+}
+
+
+/**
+ * @brief Find the bin separating the two modes with Otsu's method
+ *
+ * The split maximising the variance between the classes below and above it is searched in
+ * log amplitude. The separation is the share of the total variance explained by the split,
+ * 1.0 for two perfectly narrow modes.
+ *
+ * @param[in]  histogram The histogram
+ * @param[out] separation Share of the variance between the modes, 0.0 - 1.0
+ * @return last bin of the lower mode, or -1 if there is not enough data for two modes
+ */
+static int find_split(const threshold_histogram_t *histogram, float *separation)
+{
+	double total    = 0;
+	double sum      = 0;
+	double square   = 0;
+	double weight   = 0;
+	double partial  = 0;
+	double best     = 0;
+	int    split    = -1;
+
+	for (int i = 0; i < THRESHOLD_BIN_COUNT; i++)
+	{
+		total  += histogram->counts[i];
+		sum    += (double)i * histogram->counts[i];
+		square += (double)i * i * histogram->counts[i];
+	}
+
+	*separation = 0;
+	if (total < MIN_WEIGHT)
+	{
+		return -1;
+	}
+
+	for (int i = 0; i < THRESHOLD_BIN_COUNT - 1; i++)
+	{
+		weight  += histogram->counts[i];
+		partial += (double)i * histogram->counts[i];
+
+		if (weight < MIN_MODE_SHARE * total || total - weight < MIN_MODE_SHARE * total)
+		{
+			continue;
+		}
+
+		double mean_low  = partial / weight;
+		double mean_high = (sum - partial) / (total - weight);
+		double between   = weight * (total - weight) * (mean_low - mean_high) * (mean_low - mean_high) / (total * total);
+
+		if (between > best)
+		{
+			best  = between;
+			split = i;
+		}
+	}
+
+	double variance = square / total - (sum / total) * (sum / total);
+
+	*separation = (variance > 0) ? best / variance : 0;
+	return split;
+}
+
+
+void threshold_init(threshold_histogram_t *histogram, float reference)
+{
+	memset(histogram, 0, sizeof(*histogram));
+	histogram->reference = reference;
+	histogram->candidate = -1;
+}
+
+
+bool threshold_load(threshold_histogram_t *histogram, const char *file_name, float reference)
+{
+	FILE     *fin = fopen(file_name, "r");
+	unsigned n;
+	int      res;
+
+	threshold_init(histogram, reference);
+
+	if (fin == NULL)
+	{
+		return true;
+	}
+
+	res = fscanf(fin, "n %u\n", &n);
+	if (res != 1 || n != THRESHOLD_BIN_COUNT)
+	{
+		fclose(fin);
+		return false;
+	}
+
+	res = fscanf(fin, "reference %f threshold %f separation %f candidate %d stable %u time %lf", &histogram->reference,
+	             &histogram->threshold, &histogram->separation, &histogram->candidate, &histogram->stable,
+	             &histogram->update_time);
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		res += fscanf(fin, (i == 0) ? " counts %f" : "%f", &histogram->counts[i]);
+	}
+
+	fclose(fin);
+
+	if (res != (int)(6 + n))
+	{
+		threshold_init(histogram, reference);
+		return false;
+	}
+
+	//a new calibration starts over
+	if (fabsf(histogram->reference - reference) > REFERENCE_TOLERANCE * reference)
+	{
+		threshold_init(histogram, reference);
+	}
+
+	return true;
+}
+
+
+bool threshold_save(const threshold_histogram_t *histogram, const char *file_name)
+{
+	FILE *fout = fopen(file_name, "w");
+
+	if (fout == NULL)
+	{
+		return false;
+	}
+
+	fprintf(fout, "n %u\n", THRESHOLD_BIN_COUNT);
+	fprintf(fout, "reference %.9g threshold %.9g separation %.9g candidate %d stable %u time %.3f\n",
+	        (double)histogram->reference, (double)histogram->threshold, (double)histogram->separation, histogram->candidate,
+	        histogram->stable, histogram->update_time);
+
+	fprintf(fout, "counts");
+	for (int i = 0; i < THRESHOLD_BIN_COUNT; i++)
+	{
+		fprintf(fout, " %.6g", (double)histogram->counts[i]);
+	}
+
+	fprintf(fout, "\n");
+
+	return fclose(fout) == 0;
+}
+
+
+void threshold_add(threshold_histogram_t *histogram, float peak_amp, double time)
+{
+	if (histogram->update_time > 0 && time > histogram->update_time)
+	{
+		float decay = exp2(-(time - histogram->update_time) / HALF_LIFE);
+
+		for (int i = 0; i < THRESHOLD_BIN_COUNT; i++)
+		{
+			histogram->counts[i] *= decay;
+		}
+	}
+
+	histogram->update_time = time;
+	histogram->counts[threshold_bin(histogram, peak_amp)] += 1;
+
+	float separation;
+	int   split = find_split(histogram, &separation);
+
+	histogram->separation = separation;
+
+	//modes that are no longer well separated do not give a threshold to rely on
+	if (split < 0 || separation < MIN_SEPARATION)
+	{
+		histogram->stable    = 0;
+		histogram->threshold = 0;
+	}
+	else if (histogram->candidate >= 0 && split >= histogram->candidate - 1 && split <= histogram->candidate + 1)
+	{
+		histogram->stable++;
+	}
+	else
+	{
+		histogram->stable = 1;
+	}
+
+	histogram->candidate = split;
+
+	if (histogram->stable >= STABLE_UPDATES)
+	{
+		float threshold = threshold_bin_edge(histogram, split);
+		float low       = MIN_REFERENCE_SHARE * histogram->reference;
+		float high      = MAX_REFERENCE_SHARE * histogram->reference;
+
+		histogram->threshold = (threshold < low) ? low : (threshold > high) ? high : threshold;
+	}
+}
+
+
+float threshold_get(const threshold_histogram_t *histogram)
+{
+	return (histogram->threshold > 0) ? histogram->threshold : histogram->reference;
+}
+
+
+bool threshold_settled(const threshold_histogram_t *histogram, float peak_amp)
+{
+	return histogram->threshold > 0 && histogram->separation >= MIN_SEPARATION &&
+	       (peak_amp > histogram->threshold * SETTLED_MARGIN || peak_amp * SETTLED_MARGIN < histogram->threshold);
+}
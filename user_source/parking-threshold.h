@@ -0,0 +1,104 @@
+// Copyright (c) Acconeer AB, 2018-2019
+// All rights reserved
+
+#ifndef PARKING_THRESHOLD_H_
+#define PARKING_THRESHOLD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define THRESHOLD_BIN_COUNT (128)
+
+
+/*
+ * Histogram of peak amplitudes for tuning the detection threshold.
+ *
+ * The peak amplitudes of a spot form two modes, one for the empty spot and one for parked
+ * cars. Bins are spaced logarithmically relative to the calibrated threshold, 16 bins per
+ * octave from 1/16 to 16 times the calibrated threshold, and older measurements decay with a
+ * half-life of a week so the histogram follows slow changes of the spot. After every
+ * measurement the threshold separating the modes best is searched with Otsu's method. Once
+ * the two modes are well separated and the search gives the same threshold for a number of
+ * measurements in a row, that threshold replaces the calibrated one, limited to half to
+ * twice the calibrated threshold. As soon as the modes are no longer well separated, the
+ * calibrated threshold is used again until they have settled anew.
+ */
+typedef struct
+{
+	float    reference;
+	float    threshold;
+	float    separation;
+	int      candidate;
+	uint32_t stable;
+	double   update_time;
+	float    counts[THRESHOLD_BIN_COUNT];
+} threshold_histogram_t;
+
+
+/**
+ * @brief Clear the histogram
+ *
+ * @param[out] histogram The histogram
+ * @param[in]  reference Calibrated detection threshold, see get_detection_threshold()
+ */
+void threshold_init(threshold_histogram_t *histogram, float reference);
+
+
+/**
+ * @brief Load the histogram from file, an empty histogram is used if the file does not exist
+ *
+ * A histogram learned with another calibrated threshold is cleared, since the spot has been
+ * calibrated again.
+ *
+ * @param[out] histogram The histogram
+ * @param[in]  file_name Name of the histogram file
+ * @param[in]  reference Calibrated detection threshold, see get_detection_threshold()
+ * @return false if the file exists but could not be parsed
+ */
+bool threshold_load(threshold_histogram_t *histogram, const char *file_name, float reference);
+
+
+/**
+ * @brief Save the histogram to file
+ *
+ * @param[in] histogram The histogram
+ * @param[in] file_name Name of the histogram file
+ * @return false if the file could not be written
+ */
+bool threshold_save(const threshold_histogram_t *histogram, const char *file_name);
+
+
+/**
+ * @brief Add the peak amplitude of one measurement and tune the threshold
+ *
+ * @param[in,out] histogram The histogram
+ * @param[in]     peak_amp Peak amplitude of the measurement
+ * @param[in]     time Time of the measurement [s since the epoch]
+ */
+void threshold_add(threshold_histogram_t *histogram, float peak_amp, double time);
+
+
+/**
+ * @brief The detection threshold, tuned if the histogram has settled, otherwise calibrated
+ *
+ * @param[in] histogram The histogram
+ * @return the threshold
+ */
+float threshold_get(const threshold_histogram_t *histogram);
+
+
+/**
+ * @brief Check if a peak amplitude is decided beyond doubt by the tuned threshold
+ *
+ * True if the threshold is tuned, the modes are still well separated and the amplitude is
+ * more than an octave away from the threshold, so no confirming measurement is needed.
+ *
+ * @param[in] histogram The histogram
+ * @param[in] peak_amp Peak amplitude of the measurement
+ * @return true if the decision needs no confirmation
+ */
+bool threshold_settled(const threshold_histogram_t *histogram, float peak_amp);
+
+
+#endif